@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+// Подсчет выделений заменяет глобальный operator new и поэтому включается
+// только макросом SEARCH_SERVER_COUNT_ALLOCATIONS (его задает сборка
+// тестов). Без него используется стандартный распределитель, а счетчик
+// всегда равен нулю.
+#ifdef SEARCH_SERVER_COUNT_ALLOCATIONS
+constexpr const bool ALLOCATION_COUNTING_ENABLED = true;
+#else
+constexpr const bool ALLOCATION_COUNTING_ENABLED = false;
+#endif
+
+// Число выделений динамической памяти в текущем потоке с его запуска.
+// Учитываются все выделения через new, включая выделения контейнеров
+// стандартной библиотеки. Разность значений до и после участка кода
+// показывает, выделял ли он память.
+size_t GetThreadAllocationCount();
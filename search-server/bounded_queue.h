@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+// Очередь ограниченной емкости: Push ждет, пока очередь заполнена. После
+// Close Push возвращает false, а Pop отдает оставшиеся элементы.
+template <typename T>
+class BoundedQueue {
+   public:
+    explicit BoundedQueue(size_t capacity);
+
+    bool Push(T item);
+
+    // Ждет элемент; nullopt, если очередь закрыта и пуста
+    std::optional<T> Pop();
+
+    void Close();
+
+   private:
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_ = false;
+};
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(size_t capacity) : capacity_(capacity) {
+    using namespace std::string_literals;
+    if (capacity == 0) {
+        throw std::invalid_argument("Queue capacity must be positive"s);
+    }
+}
+
+template <typename T>
+bool BoundedQueue<T>::Push(T item) {
+    std::unique_lock lock(mutex_);
+    not_full_.wait(lock,
+                   [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_) {
+        return false;
+    }
+    items_.push_back(std::move(item));
+    not_empty_.notify_one();
+    return true;
+}
+
+template <typename T>
+std::optional<T> BoundedQueue<T>::Pop() {
+    std::unique_lock lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+        return std::nullopt;
+    }
+    std::optional<T> item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return item;
+}
+
+template <typename T>
+void BoundedQueue<T>::Close() {
+    std::lock_guard lock(mutex_);
+    closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+}
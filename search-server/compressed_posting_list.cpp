@@ -0,0 +1,376 @@
+#include "compressed_posting_list.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+constexpr const double TERM_FREQ_SCALE = numeric_limits<uint16_t>::max();
+constexpr const size_t PACK_LANE_COUNT = 4;
+
+uint8_t ComputeBitWidth(uint32_t max_value) {
+    uint8_t bit_width = 0;
+    while (max_value != 0) {
+        ++bit_width;
+        max_value >>= 1;
+    }
+
+    return bit_width;
+}
+
+// Значение i хранится в полосе i % PACK_LANE_COUNT под номером
+// i / PACK_LANE_COUNT; слово m полосы записано в
+// out[PACK_LANE_COUNT * m + полоса]. Значения с одним номером во всех
+// полосах имеют одинаковое смещение, поэтому распаковываются вместе
+// одними сдвигами SSE2.
+void PackValues(const uint32_t* values, size_t count, uint8_t bit_width,
+                vector<uint32_t>& out) {
+    if (bit_width == 0) {
+        return;
+    }
+
+    const size_t lane_size = (count + PACK_LANE_COUNT - 1) / PACK_LANE_COUNT;
+    const size_t lane_word_count = (lane_size * bit_width + 31) / 32;
+    const size_t first_word = out.size();
+    out.resize(first_word + lane_word_count * PACK_LANE_COUNT, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t bit = i / PACK_LANE_COUNT * bit_width;
+        const size_t word =
+            first_word + bit / 32 * PACK_LANE_COUNT + i % PACK_LANE_COUNT;
+        const uint64_t value = static_cast<uint64_t>(values[i]) << (bit % 32);
+        out[word] |= static_cast<uint32_t>(value);
+        if (bit % 32 + bit_width > 32) {
+            out[word + PACK_LANE_COUNT] |= static_cast<uint32_t>(value >> 32);
+        }
+    }
+}
+
+// Разности id хранятся уменьшенными на единицу, так как id в списке различны
+void UnpackDeltas(const uint32_t* packed, size_t count, uint8_t bit_width,
+                  int* out) {
+    if (bit_width == 0) {
+        fill(out, out + count, 1);
+        return;
+    }
+
+    const uint32_t mask =
+        bit_width == 32 ? ~uint32_t{0} : (uint32_t{1} << bit_width) - 1;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i lane_mask = _mm_set1_epi32(static_cast<int>(mask));
+    const __m128i one = _mm_set1_epi32(1);
+    for (size_t bit = 0; i + PACK_LANE_COUNT <= count;
+         i += PACK_LANE_COUNT, bit += bit_width) {
+        const __m128i* words =
+            reinterpret_cast<const __m128i*>(packed) + bit / 32;
+        const int shift = static_cast<int>(bit % 32);
+        __m128i x =
+            _mm_srl_epi32(_mm_loadu_si128(words), _mm_cvtsi32_si128(shift));
+        if (shift + bit_width > 32) {
+            x = _mm_or_si128(x, _mm_sll_epi32(_mm_loadu_si128(words + 1),
+                                              _mm_cvtsi32_si128(32 - shift)));
+        }
+        x = _mm_add_epi32(_mm_and_si128(x, lane_mask), one);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), x);
+    }
+#endif
+    for (; i < count; ++i) {
+        const size_t bit = i / PACK_LANE_COUNT * bit_width;
+        const size_t word = bit / 32 * PACK_LANE_COUNT + i % PACK_LANE_COUNT;
+        uint64_t window = packed[word];
+        if (bit % 32 + bit_width > 32) {
+            window |= static_cast<uint64_t>(packed[word + PACK_LANE_COUNT])
+                      << 32;
+        }
+        out[i] = static_cast<int>((window >> (bit % 32)) & mask) + 1;
+    }
+}
+
+// Превращает разности в id: values[i] = base + values[0] + ... + values[i]
+void PrefixSum(int* values, size_t count, int base) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128i carry = _mm_set1_epi32(base);
+    for (; i + 4 <= count; i += 4) {
+        __m128i x =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), x);
+        carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    base = _mm_cvtsi128_si32(carry);
+#endif
+    for (; i < count; ++i) {
+        base += values[i];
+        values[i] = base;
+    }
+}
+
+}  // namespace
+
+void CompressedPostingList::Add(int document_id, double term_freq) {
+    if (blocks_.empty() || blocks_.back().last_document_id < document_id) {
+        auto it = lower_bound(tail_document_ids_.begin(),
+                              tail_document_ids_.end(), document_id);
+        const size_t position = it - tail_document_ids_.begin();
+        if (it != tail_document_ids_.end() && *it == document_id) {
+            tail_term_freqs_[position] = QuantizeTermFreq(
+                DequantizeTermFreq(tail_term_freqs_[position]) + term_freq);
+            tail_max_term_freq_ =
+                max(tail_max_term_freq_, tail_term_freqs_[position]);
+            return;
+        }
+
+        tail_document_ids_.insert(it, document_id);
+        tail_term_freqs_.insert(tail_term_freqs_.begin() + position,
+                                QuantizeTermFreq(term_freq));
+        tail_max_term_freq_ =
+            max(tail_max_term_freq_, tail_term_freqs_[position]);
+        ++size_;
+        if (tail_document_ids_.size() == BLOCK_SIZE) {
+            FlushTail();
+        }
+        return;
+    }
+
+    const size_t block_index =
+        lower_bound(blocks_.begin(), blocks_.end(), document_id,
+                    [](const BlockHeader& block, int id) {
+                        return block.last_document_id < id;
+                    }) -
+        blocks_.begin();
+    const BlockHeader& block = blocks_[block_index];
+
+    int document_ids[BLOCK_SIZE + 1];
+    uint16_t term_freqs[BLOCK_SIZE + 1];
+    size_t count = block.count;
+    DecodeDocumentIds(block, document_ids);
+    copy(term_freqs_.begin() + block.term_freqs_offset,
+         term_freqs_.begin() + block.term_freqs_offset + count, term_freqs);
+
+    const size_t position =
+        lower_bound(document_ids, document_ids + count, document_id) -
+        document_ids;
+    if (position < count && document_ids[position] == document_id) {
+        term_freqs[position] = QuantizeTermFreq(
+            DequantizeTermFreq(term_freqs[position]) + term_freq);
+    } else {
+        copy_backward(document_ids + position, document_ids + count,
+                      document_ids + count + 1);
+        copy_backward(term_freqs + position, term_freqs + count,
+                      term_freqs + count + 1);
+        document_ids[position] = document_id;
+        term_freqs[position] = QuantizeTermFreq(term_freq);
+        ++count;
+        ++size_;
+    }
+
+    ReplaceBlock(block_index, document_ids, term_freqs, count);
+}
+
+void CompressedPostingList::Erase(int document_id) {
+    auto tail_it = lower_bound(tail_document_ids_.begin(),
+                               tail_document_ids_.end(), document_id);
+    if (tail_it != tail_document_ids_.end() && *tail_it == document_id) {
+        tail_term_freqs_.erase(tail_term_freqs_.begin() +
+                               (tail_it - tail_document_ids_.begin()));
+        tail_document_ids_.erase(tail_it);
+        tail_max_term_freq_ = tail_term_freqs_.empty()
+                                  ? 0
+                                  : *max_element(tail_term_freqs_.begin(),
+                                                 tail_term_freqs_.end());
+        --size_;
+        return;
+    }
+
+    const size_t block_index =
+        lower_bound(blocks_.begin(), blocks_.end(), document_id,
+                    [](const BlockHeader& block, int id) {
+                        return block.last_document_id < id;
+                    }) -
+        blocks_.begin();
+    if (block_index == blocks_.size() ||
+        blocks_[block_index].first_document_id > document_id) {
+        return;
+    }
+    const BlockHeader& block = blocks_[block_index];
+
+    int document_ids[BLOCK_SIZE];
+    uint16_t term_freqs[BLOCK_SIZE];
+    const size_t count = block.count;
+    DecodeDocumentIds(block, document_ids);
+    copy(term_freqs_.begin() + block.term_freqs_offset,
+         term_freqs_.begin() + block.term_freqs_offset + count, term_freqs);
+
+    const size_t position =
+        lower_bound(document_ids, document_ids + count, document_id) -
+        document_ids;
+    if (position == count || document_ids[position] != document_id) {
+        return;
+    }
+    copy(document_ids + position + 1, document_ids + count,
+         document_ids + position);
+    copy(term_freqs + position + 1, term_freqs + count, term_freqs + position);
+    --size_;
+
+    ReplaceBlock(block_index, document_ids, term_freqs, count - 1);
+}
+
+size_t CompressedPostingList::size() const { return size_; }
+
+bool CompressedPostingList::empty() const { return size_ == 0; }
+
+size_t CompressedPostingList::GetMemoryUsage() const {
+    return sizeof(*this) + blocks_.capacity() * sizeof(BlockHeader) +
+           packed_deltas_.capacity() * sizeof(uint32_t) +
+           term_freqs_.capacity() * sizeof(uint16_t) +
+           tail_document_ids_.capacity() * sizeof(int) +
+           tail_term_freqs_.capacity() * sizeof(uint16_t);
+}
+
+size_t CompressedPostingList::GetBlockCount() const {
+    return blocks_.size() + (tail_document_ids_.empty() ? 0 : 1);
+}
+
+int CompressedPostingList::GetBlockLastDocumentId(size_t block_index) const {
+    if (block_index == blocks_.size()) {
+        return tail_document_ids_.back();
+    }
+
+    return blocks_[block_index].last_document_id;
+}
+
+double CompressedPostingList::GetBlockMaxTermFreq(size_t block_index) const {
+    if (block_index == blocks_.size()) {
+        return DequantizeTermFreq(tail_max_term_freq_);
+    }
+
+    return DequantizeTermFreq(blocks_[block_index].max_term_freq);
+}
+
+size_t CompressedPostingList::DecodeBlock(size_t block_index,
+                                          Posting* postings) const {
+    if (block_index == blocks_.size()) {
+        for (size_t i = 0; i < tail_document_ids_.size(); ++i) {
+            postings[i] = {tail_document_ids_[i],
+                           DequantizeTermFreq(tail_term_freqs_[i])};
+        }
+        return tail_document_ids_.size();
+    }
+
+    const BlockHeader& block = blocks_[block_index];
+    int document_ids[BLOCK_SIZE];
+    DecodeDocumentIds(block, document_ids);
+    const uint16_t* term_freqs = term_freqs_.data() + block.term_freqs_offset;
+    for (size_t i = 0; i < block.count; ++i) {
+        postings[i] = {document_ids[i], DequantizeTermFreq(term_freqs[i])};
+    }
+
+    return block.count;
+}
+
+void CompressedPostingList::DecodeDocumentIds(const BlockHeader& block,
+                                              int* document_ids) const {
+    document_ids[0] = block.first_document_id;
+    UnpackDeltas(packed_deltas_.data() + block.data_offset, block.count - 1,
+                 block.bit_width, document_ids + 1);
+    PrefixSum(document_ids + 1, block.count - 1, block.first_document_id);
+}
+
+void CompressedPostingList::ReplaceBlock(size_t block_index,
+                                         const int* document_ids,
+                                         const uint16_t* term_freqs,
+                                         size_t count) {
+    // Кодируем новое содержимое (0, 1 или 2 блока) во временные буферы и
+    // подставляем их на место старого блока, сдвигая смещения следующих
+    vector<BlockHeader> new_blocks;
+    vector<uint32_t> new_deltas;
+    vector<uint16_t> new_term_freqs(term_freqs, term_freqs + count);
+
+    const BlockHeader& old_block = blocks_[block_index];
+    const uint32_t data_offset = old_block.data_offset;
+    const uint32_t term_freqs_offset = old_block.term_freqs_offset;
+    const uint32_t old_data_end = block_index + 1 < blocks_.size()
+                                      ? blocks_[block_index + 1].data_offset
+                                      : packed_deltas_.size();
+    const uint32_t old_term_freqs_count = old_block.count;
+
+    const size_t block_count = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    for (size_t i = 0; i < block_count; ++i) {
+        const size_t begin = count * i / block_count;
+        const size_t end = count * (i + 1) / block_count;
+
+        uint32_t deltas[BLOCK_SIZE];
+        uint32_t max_delta = 0;
+        for (size_t j = begin + 1; j < end; ++j) {
+            deltas[j - begin - 1] = static_cast<uint32_t>(
+                document_ids[j] - document_ids[j - 1] - 1);
+            max_delta = max(max_delta, deltas[j - begin - 1]);
+        }
+
+        BlockHeader block;
+        block.first_document_id = document_ids[begin];
+        block.last_document_id = document_ids[end - 1];
+        block.data_offset = data_offset + new_deltas.size();
+        block.term_freqs_offset = term_freqs_offset + begin;
+        block.count = static_cast<uint16_t>(end - begin);
+        block.max_term_freq =
+            *max_element(term_freqs + begin, term_freqs + end);
+        block.bit_width = ComputeBitWidth(max_delta);
+        PackValues(deltas, end - begin - 1, block.bit_width, new_deltas);
+        new_blocks.push_back(block);
+    }
+
+    const int64_t data_shift = static_cast<int64_t>(new_deltas.size()) -
+                               (old_data_end - data_offset);
+    const int64_t term_freqs_shift =
+        static_cast<int64_t>(count) - old_term_freqs_count;
+    for (size_t i = block_index + 1; i < blocks_.size(); ++i) {
+        blocks_[i].data_offset += data_shift;
+        blocks_[i].term_freqs_offset += term_freqs_shift;
+    }
+
+    packed_deltas_.erase(packed_deltas_.begin() + data_offset,
+                         packed_deltas_.begin() + old_data_end);
+    packed_deltas_.insert(packed_deltas_.begin() + data_offset,
+                          new_deltas.begin(), new_deltas.end());
+    term_freqs_.erase(
+        term_freqs_.begin() + term_freqs_offset,
+        term_freqs_.begin() + term_freqs_offset + old_term_freqs_count);
+    term_freqs_.insert(term_freqs_.begin() + term_freqs_offset,
+                       new_term_freqs.begin(), new_term_freqs.end());
+    blocks_.erase(blocks_.begin() + block_index);
+    blocks_.insert(blocks_.begin() + block_index, new_blocks.begin(),
+                   new_blocks.end());
+}
+
+void CompressedPostingList::FlushTail() {
+    BlockHeader block{};
+    block.data_offset = packed_deltas_.size();
+    block.term_freqs_offset = term_freqs_.size();
+    blocks_.push_back(block);
+    ReplaceBlock(blocks_.size() - 1, tail_document_ids_.data(),
+                 tail_term_freqs_.data(), tail_document_ids_.size());
+    tail_document_ids_.clear();
+    tail_term_freqs_.clear();
+    tail_max_term_freq_ = 0;
+}
+
+uint16_t CompressedPostingList::QuantizeTermFreq(double term_freq) {
+    const double scaled = round(term_freq * TERM_FREQ_SCALE);
+    return static_cast<uint16_t>(clamp(scaled, 1.0, TERM_FREQ_SCALE));
+}
+
+double CompressedPostingList::DequantizeTermFreq(
+    uint16_t quantized_term_freq) {
+    return quantized_term_freq / TERM_FREQ_SCALE;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "posting.h"
+
+// Сжатый список вхождений: разности id в блоках по BLOCK_SIZE упакованы
+// минимальным числом бит в четыре полосы, частота квантуется до 16 бит.
+// Неполный последний блок хранится несжатым.
+class CompressedPostingList {
+   public:
+    static constexpr const size_t BLOCK_SIZE = POSTING_BLOCK_SIZE;
+
+    void Add(int document_id, double term_freq);
+
+    void Erase(int document_id);
+
+    size_t size() const;
+
+    bool empty() const;
+
+    size_t GetMemoryUsage() const;
+
+    // Вызывает function(document_id, term_freq) для каждого вхождения
+    // в порядке возрастания id
+    template <typename Function>
+    void ForEach(Function function) const;
+
+    // Поблочный доступ для курсоров. Несжатый хвост считается последним
+    // блоком списка.
+    size_t GetBlockCount() const;
+
+    int GetBlockLastDocumentId(size_t block_index) const;
+
+    double GetBlockMaxTermFreq(size_t block_index) const;
+
+    // Распаковывает блок в postings и возвращает число вхождений в нем
+    size_t DecodeBlock(size_t block_index, Posting* postings) const;
+
+   private:
+    struct BlockHeader {
+        int first_document_id;
+        int last_document_id;
+        uint32_t data_offset;
+        uint32_t term_freqs_offset;
+        uint16_t count;
+        uint16_t max_term_freq;
+        uint8_t bit_width;
+    };
+
+    std::vector<BlockHeader> blocks_;
+    std::vector<uint32_t> packed_deltas_;
+    std::vector<uint16_t> term_freqs_;
+    std::vector<int> tail_document_ids_;
+    std::vector<uint16_t> tail_term_freqs_;
+    uint16_t tail_max_term_freq_ = 0;
+    size_t size_ = 0;
+
+    void DecodeDocumentIds(const BlockHeader& block, int* document_ids) const;
+
+    void ReplaceBlock(size_t block_index, const int* document_ids,
+                      const uint16_t* term_freqs, size_t count);
+
+    void FlushTail();
+
+    static uint16_t QuantizeTermFreq(double term_freq);
+
+    static double DequantizeTermFreq(uint16_t quantized_term_freq);
+};
+
+template <typename Function>
+void CompressedPostingList::ForEach(Function function) const {
+    int document_ids[BLOCK_SIZE];
+    for (const BlockHeader& block : blocks_) {
+        DecodeDocumentIds(block, document_ids);
+        const uint16_t* term_freqs =
+            term_freqs_.data() + block.term_freqs_offset;
+        for (size_t i = 0; i < block.count; ++i) {
+            function(document_ids[i], DequantizeTermFreq(term_freqs[i]));
+        }
+    }
+
+    for (size_t i = 0; i < tail_document_ids_.size(); ++i) {
+        function(tail_document_ids_[i],
+                 DequantizeTermFreq(tail_term_freqs_[i]));
+    }
+}
@@ -0,0 +1,155 @@
+#include "concurrent_search_server.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+// Число снимков каждого сервера, взятых текущим потоком. Записи с нулевым
+// счетчиком удаляются, поэтому список не растет со временем.
+vector<pair<const ConcurrentSearchServer*, size_t>>& GetHeldSnapshotCounts() {
+    thread_local vector<pair<const ConcurrentSearchServer*, size_t>>
+        held_snapshot_counts;
+    return held_snapshot_counts;
+}
+
+auto FindHeldSnapshotCount(const ConcurrentSearchServer* server) {
+    auto& counts = GetHeldSnapshotCounts();
+    return find_if(counts.begin(), counts.end(), [server](const auto& count) {
+        return count.first == server;
+    });
+}
+
+}  // namespace
+
+ConcurrentSearchServer::Snapshot::Snapshot(
+    const ConcurrentSearchServer* owner, int instance)
+    : owner_(owner), instance_(instance) {
+    const auto count = FindHeldSnapshotCount(owner);
+    if (count != GetHeldSnapshotCounts().end()) {
+        ++count->second;
+    } else {
+        GetHeldSnapshotCounts().emplace_back(owner, 1);
+    }
+}
+
+ConcurrentSearchServer::Snapshot::Snapshot(Snapshot&& other) noexcept
+    : owner_(exchange(other.owner_, nullptr)), instance_(other.instance_) {}
+
+ConcurrentSearchServer::Snapshot& ConcurrentSearchServer::Snapshot::operator=(
+    Snapshot&& other) noexcept {
+    if (this != &other) {
+        Reset();
+        owner_ = exchange(other.owner_, nullptr);
+        instance_ = other.instance_;
+    }
+    return *this;
+}
+
+ConcurrentSearchServer::Snapshot::~Snapshot() { Reset(); }
+
+const SearchServer& ConcurrentSearchServer::Snapshot::operator*() const {
+    return *owner_->instances_[instance_];
+}
+
+const SearchServer* ConcurrentSearchServer::Snapshot::operator->() const {
+    return owner_->instances_[instance_].get();
+}
+
+void ConcurrentSearchServer::Snapshot::Reset() {
+    if (owner_ == nullptr) {
+        return;
+    }
+
+    auto& counts = GetHeldSnapshotCounts();
+    const auto count = FindHeldSnapshotCount(owner_);
+    if (count != counts.end() && --count->second == 0) {
+        *count = counts.back();
+        counts.pop_back();
+    }
+    exchange(owner_, nullptr)->ReleaseInstance(instance_);
+}
+
+ConcurrentSearchServer::Snapshot ConcurrentSearchServer::GetSnapshot() const {
+    while (true) {
+        const int instance = current_.load();
+        ++reader_counts_[instance];
+        // экземпляр мог смениться до увеличения счетчика, тогда запись
+        // в него уже могла начаться
+        if (current_.load() == instance) {
+            return Snapshot(this, instance);
+        }
+        ReleaseInstance(instance);
+    }
+}
+
+uint64_t ConcurrentSearchServer::GetGeneration() const {
+    return generation_.load();
+}
+
+size_t ConcurrentSearchServer::GetDocumentCount() const {
+    return GetSnapshot()->GetDocumentCount();
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id,
+                                         const string_view document_text,
+                                         DocumentStatus status,
+                                         const vector<int>& ratings) {
+    Modify([&](SearchServer& server) {
+        server.AddDocument(document_id, document_text, status, ratings);
+    });
+}
+
+IngestionStatistics ConcurrentSearchServer::AddDocuments(
+    const vector<NewDocument>& documents) {
+    return Modify([&](SearchServer& server) {
+        return server.AddDocuments(execution::par, documents);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Modify([&](SearchServer& server) { server.RemoveDocument(document_id); });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    Modify([&](SearchServer& server) {
+        server.RemoveDocuments(execution::par, document_ids);
+    });
+}
+
+CompactionStatistics ConcurrentSearchServer::Compact() {
+    return Modify([](SearchServer& server) { return server.Compact(); });
+}
+
+void ConcurrentSearchServer::CheckNoSnapshotHeld() const {
+    using namespace std::string_literals;
+    if (FindHeldSnapshotCount(this) != GetHeldSnapshotCounts().end()) {
+        throw logic_error(
+            "Cannot modify the server while holding its snapshot"s);
+    }
+}
+
+void ConcurrentSearchServer::ReleaseInstance(int instance) const {
+    if (--reader_counts_[instance] == 0 && current_.load() != instance) {
+        lock_guard lock(release_mutex_);
+        released_.notify_all();
+    }
+}
+
+SearchServer& ConcurrentSearchServer::GetStandby() {
+    return *instances_[1 - current_.load()];
+}
+
+void ConcurrentSearchServer::Publish() {
+    const int previous = current_.load();
+    current_.store(1 - previous);
+    ++generation_;
+    // новые запросы уже получают опубликованный экземпляр, остается
+    // дождаться завершения запросов к прежнему
+    unique_lock lock(release_mutex_);
+    released_.wait(lock,
+                   [&] { return reader_counts_[previous].load() == 0; });
+}
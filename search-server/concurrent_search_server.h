@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "search_server.h"
+
+// Поиск одновременно с изменением: запросы читают опубликованный
+// экземпляр SearchServer, изменение применяется к резервному, который
+// публикуется, а затем повторяется на прежнем. Изменение должно быть
+// детерминированным. Снимок освобождается в потоке, который его взял.
+class ConcurrentSearchServer {
+   public:
+    // Закрепленный экземпляр SearchServer. Строки, возвращаемые
+    // MatchDocument, действительны, пока снимок не освобожден.
+    class Snapshot {
+       public:
+        Snapshot(Snapshot&& other) noexcept;
+        Snapshot& operator=(Snapshot&& other) noexcept;
+        ~Snapshot();
+
+        const SearchServer& operator*() const;
+        const SearchServer* operator->() const;
+
+        void Reset();
+
+       private:
+        friend class ConcurrentSearchServer;
+
+        Snapshot(const ConcurrentSearchServer* owner, int instance);
+
+        const ConcurrentSearchServer* owner_;
+        int instance_;
+    };
+
+    template <typename... Args>
+    explicit ConcurrentSearchServer(const Args&... args);
+
+    // Текущее поколение индекса; не меняется, пока снимок не освобожден
+    Snapshot GetSnapshot() const;
+
+    // Номер текущего поколения, увеличивается при каждой публикации
+    uint64_t GetGeneration() const;
+
+    size_t GetDocumentCount() const;
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(const Args&... args) const;
+
+    void AddDocument(int document_id, const std::string_view document_text,
+                     DocumentStatus status, const std::vector<int>& ratings);
+
+    IngestionStatistics AddDocuments(const std::vector<NewDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    CompactionStatistics Compact();
+
+    // Применяет modification(SearchServer&) к обоим экземплярам и возвращает
+    // результат первого применения. Выбрасывает std::logic_error, если
+    // текущий поток удерживает снимок этого сервера.
+    template <typename Modification>
+    auto Modify(Modification modification);
+
+   private:
+    std::mutex modification_mutex_;
+    std::unique_ptr<SearchServer> instances_[2];
+    // номер опубликованного экземпляра
+    std::atomic<int> current_ = 0;
+    // число снимков каждого экземпляра
+    mutable std::atomic<size_t> reader_counts_[2] = {0, 0};
+    mutable std::mutex release_mutex_;
+    mutable std::condition_variable released_;
+    std::atomic<uint64_t> generation_ = 0;
+
+    // Выбрасывает std::logic_error, если текущий поток удерживает снимок
+    void CheckNoSnapshotHeld() const;
+
+    void ReleaseInstance(int instance) const;
+
+    SearchServer& GetStandby();
+
+    // Публикует резервный экземпляр и дожидается, пока прежний перестанут
+    // использовать. Вызывается под modification_mutex_.
+    void Publish();
+};
+
+template <typename... Args>
+ConcurrentSearchServer::ConcurrentSearchServer(const Args&... args)
+    : instances_{std::make_unique<SearchServer>(args...),
+                 std::make_unique<SearchServer>(args...)} {}
+
+template <typename... Args>
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(
+    const Args&... args) const {
+    return GetSnapshot()->FindTopDocuments(args...);
+}
+
+template <typename Modification>
+auto ConcurrentSearchServer::Modify(Modification modification) {
+    CheckNoSnapshotHeld();
+    std::lock_guard lock(modification_mutex_);
+    if constexpr (std::is_void_v<decltype(modification(GetStandby()))>) {
+        modification(GetStandby());
+        Publish();
+        modification(GetStandby());
+    } else {
+        auto result = modification(GetStandby());
+        Publish();
+        modification(GetStandby());
+        return result;
+    }
+}
@@ -0,0 +1,271 @@
+#include "directory_indexer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <exception>
+#include <execution>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+
+#include "bounded_queue.h"
+
+using namespace std;
+
+namespace {
+
+struct FileTask {
+    string path;
+    filesystem::file_time_type modification_time;
+    uintmax_t size = 0;
+    optional<int> previous_document_id;
+};
+
+struct FileText {
+    FileTask task;
+    // nullopt, если файл не удалось прочитать
+    optional<string> text;
+};
+
+char NormalizeChar(char c) { return c >= '\0' && c < ' ' ? ' ' : c; }
+
+// Файл читается вызовами read прямо в строку текста: отображение в память
+// все равно потребовало бы копирования, так как управляющие символы
+// заменяются пробелами
+string ReadFileText(const string& path, uintmax_t size) {
+    using namespace std::string_literals;
+    const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        throw system_error(errno, generic_category(), "Cannot open "s + path);
+    }
+    // файл мог вырасти после обхода; читается не больше size байт
+    string text(static_cast<size_t>(size), '\0');
+    size_t read_size = 0;
+    while (read_size < text.size()) {
+        const ssize_t result =
+            read(file, text.data() + read_size, text.size() - read_size);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            const int error = errno;
+            close(file);
+            throw system_error(error, generic_category(),
+                               "Cannot read "s + path);
+        }
+        if (result == 0) {
+            break;
+        }
+        read_size += static_cast<size_t>(result);
+    }
+    close(file);
+    text.resize(read_size);
+    transform(text.begin(), text.end(), text.begin(), NormalizeChar);
+    return text;
+}
+
+}  // namespace
+
+DirectoryIndexer::DirectoryIndexer(SearchServer& server, int first_document_id,
+                                   size_t reader_count)
+    : server_(server),
+      reader_count_(reader_count),
+      next_document_id_(first_document_id) {
+    using namespace std::string_literals;
+    if (reader_count == 0) {
+        throw invalid_argument("Reader count must be positive"s);
+    }
+}
+
+DirectoryIndexingStatistics DirectoryIndexer::Index(
+    const vector<string>& roots) {
+    using namespace std::string_literals;
+    const auto start_time = chrono::steady_clock::now();
+    for (const string& root : roots) {
+        if (!filesystem::is_directory(root)) {
+            throw invalid_argument("Directory "s + root + " does not exist"s);
+        }
+    }
+
+    DirectoryIndexingStatistics statistics;
+    BoundedQueue<FileTask> tasks(INDEXER_QUEUE_CAPACITY);
+    BoundedQueue<FileText> texts(INDEXER_QUEUE_CAPACITY);
+
+    // обход пишет только в эти переменные, которые читаются после его
+    // завершения
+    unordered_set<string> found_paths;
+    size_t unchanged_file_count = 0;
+    bool scan_complete = true;
+    thread crawler([&]() {
+        for (const string& root : roots) {
+            error_code error;
+            filesystem::recursive_directory_iterator entry(
+                root, filesystem::directory_options::skip_permission_denied,
+                error);
+            for (; !error &&
+                   entry != filesystem::recursive_directory_iterator();
+                 entry.increment(error)) {
+                error_code entry_error;
+                if (!entry->is_regular_file(entry_error)) {
+                    continue;
+                }
+                const uintmax_t size = entry->file_size(entry_error);
+                const filesystem::file_time_type modification_time =
+                    entry->last_write_time(entry_error);
+                string path = entry->path().string();
+                if (entry_error) {
+                    // файл мог исчезнуть во время обхода
+                    continue;
+                }
+                if (!found_paths.insert(path).second) {
+                    continue;
+                }
+
+                const auto file = files_.find(path);
+                if (file != files_.end() && file->second.size == size &&
+                    file->second.modification_time == modification_time) {
+                    ++unchanged_file_count;
+                    continue;
+                }
+                optional<int> previous_document_id;
+                if (file != files_.end()) {
+                    previous_document_id = file->second.document_id;
+                }
+                if (!tasks.Push({move(path), modification_time, size,
+                                 previous_document_id})) {
+                    return;
+                }
+            }
+            if (error) {
+                scan_complete = false;
+            }
+        }
+        tasks.Close();
+    });
+
+    atomic<size_t> active_reader_count = reader_count_;
+    vector<thread> readers;
+    for (size_t i = 0; i < reader_count_; ++i) {
+        readers.emplace_back([&]() {
+            while (optional<FileTask> task = tasks.Pop()) {
+                FileText file{move(*task), nullopt};
+                try {
+                    file.text = ReadFileText(file.task.path, file.task.size);
+                } catch (const system_error&) {
+                } catch (const invalid_argument&) {
+                    // файл опустел после обхода
+                }
+                if (!texts.Push(move(file))) {
+                    break;
+                }
+            }
+            if (--active_reader_count == 0) {
+                texts.Close();
+            }
+        });
+    }
+
+    // состояния проиндексированных файлов переносятся в files_ после
+    // остановки обхода, который читает files_
+    vector<pair<string, FileState>> indexed_files;
+    vector<FileText> batch;
+    const auto add_batch = [&]() {
+        vector<int> previous_document_ids;
+        vector<NewDocument> documents;
+        for (const FileText& file : batch) {
+            if (file.task.previous_document_id) {
+                previous_document_ids.push_back(
+                    *file.task.previous_document_id);
+            }
+            documents.push_back({next_document_id_ +
+                                     static_cast<int>(documents.size()),
+                                 *file.text,
+                                 DocumentStatus::ACTUAL,
+                                 {}});
+        }
+        // прежние версии удаляются, только когда новые уже добавлены:
+        // если пакет отклонен, в индексе остаются прежние
+        statistics.byte_count +=
+            server_.AddDocuments(execution::par, documents).byte_count;
+        server_.RemoveDocuments(previous_document_ids);
+        for (FileText& file : batch) {
+            indexed_files.push_back(
+                {move(file.task.path),
+                 {next_document_id_++, file.task.modification_time,
+                  file.task.size}});
+        }
+        statistics.indexed_file_count += batch.size();
+        batch.clear();
+    };
+
+    exception_ptr error;
+    try {
+        while (optional<FileText> file = texts.Pop()) {
+            if (!file->text) {
+                ++statistics.failed_file_count;
+                continue;
+            }
+            batch.push_back(move(*file));
+            if (batch.size() == INDEXER_BATCH_SIZE) {
+                add_batch();
+            }
+        }
+        add_batch();
+    } catch (...) {
+        error = current_exception();
+        tasks.Close();
+        texts.Close();
+    }
+    crawler.join();
+    for (thread& reader : readers) {
+        reader.join();
+    }
+
+    for (auto& [path, state] : indexed_files) {
+        const auto [file, inserted] = files_.emplace(path, state);
+        if (!inserted) {
+            document_paths_.erase(file->second.document_id);
+            file->second = state;
+        }
+        document_paths_[state.document_id] = path;
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+
+    // при ошибке обхода часть файлов могла быть не найдена
+    if (scan_complete) {
+        vector<int> removed_document_ids;
+        for (auto file = files_.begin(); file != files_.end();) {
+            if (found_paths.count(file->first) != 0) {
+                ++file;
+                continue;
+            }
+            removed_document_ids.push_back(file->second.document_id);
+            document_paths_.erase(file->second.document_id);
+            file = files_.erase(file);
+        }
+        server_.RemoveDocuments(removed_document_ids);
+        statistics.removed_file_count = removed_document_ids.size();
+    }
+
+    statistics.scanned_file_count = found_paths.size();
+    statistics.unchanged_file_count = unchanged_file_count;
+    statistics.seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - start_time)
+            .count();
+    return statistics;
+}
+
+const string& DirectoryIndexer::GetDocumentPath(int document_id) const {
+    return document_paths_.at(document_id);
+}
+
+size_t DirectoryIndexer::GetFileCount() const { return files_.size(); }
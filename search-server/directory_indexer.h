@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "search_server.h"
+
+// Емкость очередей между стадиями индексатора
+constexpr const size_t INDEXER_QUEUE_CAPACITY = 1024;
+
+// Число документов в пакете SearchServer::AddDocuments
+constexpr const size_t INDEXER_BATCH_SIZE = 512;
+
+// Результат DirectoryIndexer::Index
+struct DirectoryIndexingStatistics {
+    size_t scanned_file_count = 0;
+    // новые и измененные файлы
+    size_t indexed_file_count = 0;
+    size_t unchanged_file_count = 0;
+    // файлы, исчезнувшие с прошлой индексации
+    size_t removed_file_count = 0;
+    // файлы, которые не удалось прочитать
+    size_t failed_file_count = 0;
+    size_t byte_count = 0;
+    double seconds = 0.0;
+};
+
+// Индексирует файлы каталогов конвейером: обход, чтение и добавление
+// пакетами связаны очередями ограниченной емкости. Неизменившиеся файлы
+// пропускаются, измененный файл получает новый id.
+class DirectoryIndexer {
+   public:
+    // Документы получают id начиная с first_document_id; сервер не должен
+    // изменяться в обход индексатора
+    explicit DirectoryIndexer(SearchServer& server, int first_document_id = 0,
+                              size_t reader_count = 4);
+
+    // Индексирует все файлы каталогов roots. Документы файлов, которые
+    // были проиндексированы раньше, но не найдены в roots, удаляются.
+    // Выбрасывает std::invalid_argument, если каталог не существует.
+    DirectoryIndexingStatistics Index(const std::vector<std::string>& roots);
+
+    // Путь файла документа; выбрасывает std::out_of_range для чужого id
+    const std::string& GetDocumentPath(int document_id) const;
+
+    size_t GetFileCount() const;
+
+   private:
+    struct FileState {
+        int document_id = 0;
+        std::filesystem::file_time_type modification_time;
+        uintmax_t size = 0;
+    };
+
+    SearchServer& server_;
+    size_t reader_count_;
+    int next_document_id_;
+    std::map<std::string, FileState> files_;
+    std::unordered_map<int, std::string> document_paths_;
+};
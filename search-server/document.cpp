@@ -1,8 +1,21 @@
 #include "document.h"
 
+#include <cmath>
+
 Document::Document(int id_val, double relevance_val, int rating_val)
     : id(id_val), relevance(relevance_val), rating(rating_val) {}
 
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) >= RELEVANCE_EPSILON) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+
+    return lhs.id < rhs.id;
+}
+
 std::ostream& operator<<(std::ostream& out, const Document& document) {
     out << "{ "
         << "document_id = " << document.id << ", "
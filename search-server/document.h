@@ -19,4 +19,12 @@ struct Document {
     int rating = 0;
 };
 
-std::ostream& operator<<(std::ostream& out, const Document& document);
\ No newline at end of file
+// Документы, релевантность которых отличается меньше, чем на
+// RELEVANCE_EPSILON, считаются одинаково релевантными
+constexpr const double RELEVANCE_EPSILON = 10e-6;
+
+// Порядок выдачи: по убыванию релевантности, при равной релевантности -
+// по убыванию рейтинга, затем по возрастанию id
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+std::ostream& operator<<(std::ostream& out, const Document& document);
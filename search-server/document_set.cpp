@@ -0,0 +1,19 @@
+#include "document_set.h"
+
+using namespace std;
+
+DocumentSet::DocumentSet(int first_ordinal, int last_ordinal)
+    : first_ordinal_(first_ordinal),
+      size_(static_cast<uint32_t>(last_ordinal - first_ordinal)),
+      bits_((size_ + 63) / 64) {}
+
+void DocumentSet::Insert(int ordinal) {
+    const uint32_t offset = static_cast<uint32_t>(ordinal - first_ordinal_);
+    bits_[offset / 64] |= uint64_t{1} << (offset % 64);
+}
+
+bool DocumentSet::Contains(int ordinal) const {
+    // номера меньше first_ordinal_ дают большое беззнаковое смещение
+    const uint32_t offset = static_cast<uint32_t>(ordinal - first_ordinal_);
+    return offset < size_ && (bits_[offset / 64] >> (offset % 64)) & 1;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Множество порядковых номеров документов из диапазона
+ * [first_ordinal, last_ordinal) в виде битового массива.
+ * Номера вне диапазона в множество не входят.
+ */
+class DocumentSet {
+   public:
+    DocumentSet(int first_ordinal, int last_ordinal);
+
+    void Insert(int ordinal);
+
+    bool Contains(int ordinal) const;
+
+   private:
+    int first_ordinal_;
+    uint32_t size_;
+    std::vector<uint64_t> bits_;
+};
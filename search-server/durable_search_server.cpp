@@ -0,0 +1,179 @@
+#include "durable_search_server.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+
+namespace {
+
+bool FileExists(const string& path) { return access(path.c_str(), F_OK) == 0; }
+
+}  // namespace
+
+const SearchServer& DurableSearchServer::GetServer() const { return server_; }
+
+const RecoveryStatistics& DurableSearchServer::GetRecoveryStatistics() const {
+    return recovery_statistics_;
+}
+
+const WriteAheadLog& DurableSearchServer::GetLog() const { return log_; }
+
+void DurableSearchServer::AddDocument(int document_id,
+                                      const string_view document_text,
+                                      DocumentStatus status,
+                                      const vector<int>& ratings) {
+    uint64_t sequence = 0;
+    {
+        unique_lock lock(write_mutex_);
+        log_.CheckHealthy();
+        WaitPendingChanges(lock, {document_id});
+        server_.ValidateNewDocuments(
+            {{document_id, document_text, status, ratings}});
+        sequence = log_.Append({WalOperation::ADD_DOCUMENT, document_id,
+                                document_text, status, ratings});
+        ++pending_changes_[document_id];
+    }
+    ApplyDurable(sequence, sequence, {document_id}, [&] {
+        server_.AddDocument(document_id, document_text, status, ratings);
+    });
+}
+
+IngestionStatistics DurableSearchServer::AddDocuments(
+    const vector<NewDocument>& documents) {
+    if (documents.empty()) {
+        return {};
+    }
+    vector<int> document_ids;
+    document_ids.reserve(documents.size());
+    for (const NewDocument& document : documents) {
+        document_ids.push_back(document.id);
+    }
+
+    uint64_t first_sequence = 0;
+    uint64_t last_sequence = 0;
+    {
+        unique_lock lock(write_mutex_);
+        log_.CheckHealthy();
+        WaitPendingChanges(lock, document_ids);
+        server_.ValidateNewDocuments(documents);
+        for (const NewDocument& document : documents) {
+            last_sequence = log_.Append({WalOperation::ADD_DOCUMENT,
+                                         document.id, document.text,
+                                         document.status, document.ratings});
+            ++pending_changes_[document.id];
+        }
+        first_sequence = last_sequence - documents.size() + 1;
+    }
+    IngestionStatistics statistics;
+    ApplyDurable(first_sequence, last_sequence, document_ids,
+                 [&] { statistics = server_.AddDocuments(documents); });
+    return statistics;
+}
+
+void DurableSearchServer::RemoveDocument(int document_id) {
+    uint64_t sequence = 0;
+    {
+        lock_guard lock(write_mutex_);
+        log_.CheckHealthy();
+        sequence = log_.Append({WalOperation::REMOVE_DOCUMENT, document_id,
+                                {}, DocumentStatus::ACTUAL, {}});
+        ++pending_changes_[document_id];
+    }
+    ApplyDurable(sequence, sequence, {document_id},
+                 [&] { server_.RemoveDocument(document_id); });
+}
+
+SnapshotStatistics DurableSearchServer::Checkpoint() {
+    unique_lock lock(write_mutex_);
+    // записанные изменения должны попасть в снимок до очистки журнала
+    applied_.wait(lock, [this] {
+        return applied_sequence_ == log_.GetRecordCount();
+    });
+    const SnapshotStatistics statistics = server_.SaveSnapshot(snapshot_path_);
+    // все записи журнала уже в снимке
+    log_.Clear();
+    return statistics;
+}
+
+void DurableSearchServer::Recover() {
+    const auto start_time = chrono::steady_clock::now();
+    if (FileExists(snapshot_path_)) {
+        recovery_statistics_.snapshot_document_count =
+            server_.LoadSnapshot(snapshot_path_).document_count;
+    }
+
+    recovery_statistics_.replayed_record_count =
+        log_.Replay([this](const WalRecord& record) {
+            if (record.operation == WalOperation::REMOVE_DOCUMENT) {
+                server_.RemoveDocument(record.document_id);
+                return;
+            }
+            try {
+                server_.AddDocument(record.document_id, record.text,
+                                    record.status, record.ratings);
+            } catch (const invalid_argument&) {
+                // документ уже есть в снимке
+            }
+        });
+    recovery_statistics_.tail_truncated = log_.IsTailTruncated();
+    recovery_statistics_.seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - start_time)
+            .count();
+}
+
+void DurableSearchServer::WaitPendingChanges(
+    unique_lock<mutex>& lock, const vector<int>& document_ids) {
+    // проверка документа по серверу верна, только когда его изменения
+    // уже применены
+    applied_.wait(lock, [&] {
+        return none_of(document_ids.begin(), document_ids.end(),
+                       [this](int document_id) {
+                           return pending_changes_.count(document_id) != 0;
+                       });
+    });
+}
+
+void DurableSearchServer::ApplyDurable(uint64_t first_sequence,
+                                       uint64_t last_sequence,
+                                       const vector<int>& document_ids,
+                                       const function<void()>& apply) {
+    // ожидание вне блокировки: пока ведущий поток фиксирует журнал,
+    // другие потоки добавляют записи в следующую группу
+    exception_ptr error;
+    try {
+        log_.WaitDurable(last_sequence);
+    } catch (const system_error&) {
+        error = current_exception();
+    }
+
+    unique_lock lock(write_mutex_);
+    applied_.wait(lock, [this, first_sequence] {
+        return applied_sequence_ + 1 == first_sequence;
+    });
+    if (error) {
+        // после ошибки журнал не фиксирует и все следующие записи
+        pending_changes_.clear();
+    } else {
+        for (const int document_id : document_ids) {
+            if (--pending_changes_[document_id] == 0) {
+                pending_changes_.erase(document_id);
+            }
+        }
+        try {
+            apply();
+        } catch (...) {
+            error = current_exception();
+        }
+    }
+    applied_sequence_ = last_sequence;
+    applied_.notify_all();
+    if (error) {
+        rethrow_exception(error);
+    }
+}
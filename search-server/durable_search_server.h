@@ -0,0 +1,87 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "index_snapshot.h"
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+// Результат восстановления DurableSearchServer при создании
+struct RecoveryStatistics {
+    size_t snapshot_document_count = 0;
+    size_t replayed_record_count = 0;
+    // была ли отброшена оборванная или поврежденная часть журнала
+    bool tail_truncated = false;
+    double seconds = 0.0;
+};
+
+// Поисковый сервер с журналом упреждающей записи: изменение
+// применяется только после фиксации записи на диске. При создании
+// загружается снимок и поверх него повторяется журнал; повтор
+// идемпотентен.
+class DurableSearchServer {
+   public:
+    // Аргументы args передаются конструктору SearchServer
+    template <typename... Args>
+    DurableSearchServer(const std::string& snapshot_path,
+                        const std::string& log_path, WalSync sync,
+                        const Args&... args);
+
+    // Поиск не должен выполняться одновременно с изменениями
+    const SearchServer& GetServer() const;
+
+    const RecoveryStatistics& GetRecoveryStatistics() const;
+
+    const WriteAheadLog& GetLog() const;
+
+    void AddDocument(int document_id, const std::string_view document_text,
+                     DocumentStatus status, const std::vector<int>& ratings);
+
+    // Документы добавляются пакетом и фиксируются одной группой
+    IngestionStatistics AddDocuments(const std::vector<NewDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    // Атомарно заменяет снимок (см. SearchServer::SaveSnapshot) и очищает
+    // журнал
+    SnapshotStatistics Checkpoint();
+
+   private:
+    std::string snapshot_path_;
+    SearchServer server_;
+    WriteAheadLog log_;
+    RecoveryStatistics recovery_statistics_;
+    // упорядочивает изменения сервера и записи журнала
+    std::mutex write_mutex_;
+    std::condition_variable applied_;
+    // последняя запись журнала, изменение которой применено или отменено
+    uint64_t applied_sequence_ = 0;
+    // число записанных, но еще не примененных изменений документа
+    std::unordered_map<int, size_t> pending_changes_;
+
+    void Recover();
+
+    // Ждет применения записанных ранее изменений документов document_ids
+    void WaitPendingChanges(std::unique_lock<std::mutex>& lock,
+                            const std::vector<int>& document_ids);
+
+    // Дожидается фиксации записей [first_sequence, last_sequence] и
+    // в очереди журнала применяет их изменение apply к серверу
+    void ApplyDurable(uint64_t first_sequence, uint64_t last_sequence,
+                      const std::vector<int>& document_ids,
+                      const std::function<void()>& apply);
+};
+
+template <typename... Args>
+DurableSearchServer::DurableSearchServer(const std::string& snapshot_path,
+                                         const std::string& log_path,
+                                         WalSync sync, const Args&... args)
+    : snapshot_path_(snapshot_path), server_(args...), log_(log_path, sync) {
+    Recover();
+}
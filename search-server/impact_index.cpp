@@ -0,0 +1,84 @@
+#include "impact_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+using namespace std;
+
+void ImpactIndex::Build(const InvertedIndex& index,
+                        double log_document_count) {
+    const vector<TermId> term_ids = index.GetTermIds();
+
+    double max_impact = 0.0;
+    for (const TermId term_id : term_ids) {
+        const double idf =
+            log_document_count - index.GetLogDocumentFreq(term_id);
+        index.ForEachPosting(term_id, [&](int, double term_freq) {
+            max_impact = max(max_impact, idf * term_freq);
+        });
+    }
+    impact_unit_ = max_impact / MAX_QUANTIZED_IMPACT;
+
+    term_segments_.assign(term_ids.empty() ? 0 : term_ids.back() + 1, {});
+    documents_.clear();
+    vector<pair<uint8_t, int>> impacts;
+    for (const TermId term_id : term_ids) {
+        const double idf =
+            log_document_count - index.GetLogDocumentFreq(term_id);
+        impacts.clear();
+        index.ForEachPosting(term_id, [&](int document_id, double term_freq) {
+            const double impact = idf * term_freq;
+            uint8_t quantized_impact = 0;
+            if (impact > 0.0) {
+                quantized_impact = static_cast<uint8_t>(
+                    clamp<long>(lround(impact / impact_unit_), 1,
+                                MAX_QUANTIZED_IMPACT));
+            }
+            impacts.emplace_back(quantized_impact, document_id);
+        });
+        // по убыванию вклада, внутри сегмента по возрастанию номера
+        sort(impacts.begin(), impacts.end(),
+             [](const pair<uint8_t, int>& lhs, const pair<uint8_t, int>& rhs) {
+                 return lhs.first != rhs.first ? lhs.first > rhs.first
+                                               : lhs.second < rhs.second;
+             });
+
+        vector<Segment>& segments = term_segments_[term_id];
+        for (const auto& [quantized_impact, document_id] : impacts) {
+            const uint32_t position = static_cast<uint32_t>(documents_.size());
+            if (segments.empty() ||
+                segments.back().impact != quantized_impact) {
+                segments.push_back({quantized_impact, position, position});
+            }
+            documents_.push_back(document_id);
+            ++segments.back().end;
+        }
+    }
+}
+
+const vector<ImpactIndex::Segment>& ImpactIndex::GetSegments(
+    TermId term_id) const {
+    if (term_id >= term_segments_.size()) {
+        static const vector<Segment> empty_segments;
+        return empty_segments;
+    }
+
+    return term_segments_[term_id];
+}
+
+const int* ImpactIndex::GetDocuments(const Segment& segment) const {
+    return documents_.data() + segment.begin;
+}
+
+double ImpactIndex::GetImpactUnit() const { return impact_unit_; }
+
+size_t ImpactIndex::GetMemoryUsage() const {
+    size_t memory_usage = documents_.capacity() * sizeof(int);
+    for (const vector<Segment>& segments : term_segments_) {
+        memory_usage +=
+            sizeof(segments) + segments.capacity() * sizeof(Segment);
+    }
+
+    return memory_usage;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "inverted_index.h"
+
+// Число уровней квантования вклада слова в релевантность
+constexpr const int MAX_QUANTIZED_IMPACT = 255;
+
+// Вхождения каждого слова сгруппированы по квантованному вкладу tf * idf
+// в сегменты по убыванию вклада, поэтому запрос может остановиться, не
+// дочитав списки. После изменения документов индекс строится заново.
+class ImpactIndex {
+   public:
+    struct Segment {
+        uint8_t impact;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    // log_document_count - натуральный логарифм числа документов
+    void Build(const InvertedIndex& index, double log_document_count);
+
+    // Сегменты слова по убыванию вклада
+    const std::vector<Segment>& GetSegments(TermId term_id) const;
+
+    // Порядковые номера документов сегмента, по возрастанию
+    const int* GetDocuments(const Segment& segment) const;
+
+    // Вклад, соответствующий единице квантованного вклада
+    double GetImpactUnit() const;
+
+    size_t GetMemoryUsage() const;
+
+   private:
+    std::vector<std::vector<Segment>> term_segments_;
+    std::vector<int> documents_;
+    double impact_unit_ = 0.0;
+};
@@ -0,0 +1,213 @@
+#include "index_segment.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+constexpr const uint32_t UNCHECKED_SIZE = numeric_limits<uint32_t>::max();
+
+}  // namespace
+
+IndexSegment::IndexSegment(IndexLayout layout, int level)
+    : layout_(layout), level_(level) {}
+
+void IndexSegment::AddPostingList(TermId term_id,
+                                  const vector<Posting>& postings) {
+    if (postings.empty()) {
+        return;
+    }
+
+    term_ids_.push_back(term_id);
+    document_id_end_ = max(document_id_end_, postings.back().document_id + 1);
+    postings_.insert(postings_.end(), postings.begin(), postings.end());
+    posting_offsets_.push_back(static_cast<uint32_t>(postings_.size()));
+    for (size_t begin = 0; begin < postings.size();
+         begin += POSTING_BLOCK_SIZE) {
+        const auto block_begin = postings.begin() + begin;
+        const auto block_end =
+            postings.begin() + min(postings.size(), begin + POSTING_BLOCK_SIZE);
+        block_max_term_freqs_.push_back(
+            max_element(block_begin, block_end,
+                        [](const Posting& lhs, const Posting& rhs) {
+                            return lhs.term_freq < rhs.term_freq;
+                        })
+                ->term_freq);
+    }
+    block_offsets_.push_back(
+        static_cast<uint32_t>(block_max_term_freqs_.size()));
+    posting_count_ += postings.size();
+}
+
+void IndexSegment::AddPostingList(TermId term_id,
+                                  CompressedPostingList postings) {
+    if (postings.empty()) {
+        return;
+    }
+
+    term_ids_.push_back(term_id);
+    document_id_end_ = max(
+        document_id_end_,
+        postings.GetBlockLastDocumentId(postings.GetBlockCount() - 1) + 1);
+    posting_count_ += postings.size();
+    compressed_postings_.push_back(move(postings));
+}
+
+IndexSegment IndexSegment::MapPlain(shared_ptr<const void> storage,
+                                    vector<TermId> term_ids,
+                                    vector<uint32_t> posting_offsets,
+                                    vector<uint32_t> block_offsets,
+                                    const Posting* postings,
+                                    const double* block_max_term_freqs,
+                                    int document_id_end) {
+    IndexSegment segment(IndexLayout::PLAIN, 0);
+    segment.term_ids_ = move(term_ids);
+    segment.posting_offsets_ = move(posting_offsets);
+    segment.block_offsets_ = move(block_offsets);
+    segment.posting_count_ = segment.posting_offsets_.back();
+    segment.document_id_end_ = document_id_end;
+    segment.storage_ = move(storage);
+    segment.mapped_postings_ = postings;
+    segment.mapped_block_max_term_freqs_ = block_max_term_freqs;
+    segment.checked_sizes_ =
+        make_unique<atomic<uint32_t>[]>(segment.term_ids_.size());
+    for (size_t i = 0; i < segment.term_ids_.size(); ++i) {
+        segment.checked_sizes_[i].store(UNCHECKED_SIZE,
+                                        memory_order_relaxed);
+    }
+    return segment;
+}
+
+IndexSegment IndexSegment::Merge(
+    const vector<shared_ptr<const IndexSegment>>& segments) {
+    int level = 0;
+    for (const auto& segment : segments) {
+        level = max(level, segment->level_ + 1);
+    }
+    IndexSegment merged(segments.front()->layout_, level);
+
+    vector<TermId> term_ids;
+    for (const auto& segment : segments) {
+        term_ids.insert(term_ids.end(), segment->term_ids_.begin(),
+                        segment->term_ids_.end());
+    }
+    sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(unique(term_ids.begin(), term_ids.end()), term_ids.end());
+
+    // сегменты идут по возрастанию номеров, поэтому списки слова
+    // достаточно записать друг за другом
+    vector<Posting> postings;
+    for (const TermId term_id : term_ids) {
+        if (merged.layout_ == IndexLayout::COMPRESSED) {
+            CompressedPostingList compressed;
+            for (const auto& segment : segments) {
+                if (const auto part = segment->FindPostingList(term_id)) {
+                    part->compressed->ForEach([&](int document_id,
+                                                  double term_freq) {
+                        compressed.Add(document_id, term_freq);
+                    });
+                }
+            }
+            merged.AddPostingList(term_id, move(compressed));
+        } else {
+            postings.clear();
+            for (const auto& segment : segments) {
+                if (const auto part = segment->FindPostingList(term_id)) {
+                    postings.insert(postings.end(), part->postings,
+                                    part->postings + part->size);
+                }
+            }
+            merged.AddPostingList(term_id, postings);
+        }
+    }
+
+    return merged;
+}
+
+optional<PostingListPart> IndexSegment::FindPostingList(TermId term_id) const {
+    const auto it = lower_bound(term_ids_.begin(), term_ids_.end(), term_id);
+    if (it == term_ids_.end() || *it != term_id) {
+        return nullopt;
+    }
+
+    const size_t index = it - term_ids_.begin();
+    PostingListPart part;
+    if (layout_ == IndexLayout::COMPRESSED) {
+        part.compressed = &compressed_postings_[index];
+        part.size = part.compressed->size();
+    } else {
+        const Posting* postings =
+            storage_ ? mapped_postings_ : postings_.data();
+        const double* block_max_term_freqs =
+            storage_ ? mapped_block_max_term_freqs_
+                     : block_max_term_freqs_.data();
+        part.postings = postings + posting_offsets_[index];
+        part.size = storage_ ? GetCheckedSize(index)
+                             : posting_offsets_[index + 1] -
+                                   posting_offsets_[index];
+        if (part.size == 0) {
+            return nullopt;
+        }
+        part.block_max_term_freqs =
+            block_max_term_freqs + block_offsets_[index];
+    }
+
+    return part;
+}
+
+size_t IndexSegment::GetPostingListSize(TermId term_id) const {
+    const auto it = lower_bound(term_ids_.begin(), term_ids_.end(), term_id);
+    if (it == term_ids_.end() || *it != term_id) {
+        return 0;
+    }
+
+    const size_t index = it - term_ids_.begin();
+    return layout_ == IndexLayout::COMPRESSED
+               ? compressed_postings_[index].size()
+               : posting_offsets_[index + 1] - posting_offsets_[index];
+}
+
+const vector<TermId>& IndexSegment::GetTermIds() const { return term_ids_; }
+
+int IndexSegment::GetDocumentIdEnd() const { return document_id_end_; }
+
+int IndexSegment::GetLevel() const { return level_; }
+
+size_t IndexSegment::GetPostingCount() const { return posting_count_; }
+
+size_t IndexSegment::GetMemoryUsage() const {
+    size_t memory_usage = term_ids_.capacity() * sizeof(TermId) +
+                          posting_offsets_.capacity() * sizeof(uint32_t) +
+                          block_offsets_.capacity() * sizeof(uint32_t) +
+                          postings_.capacity() * sizeof(Posting) +
+                          block_max_term_freqs_.capacity() * sizeof(double);
+    for (const CompressedPostingList& postings : compressed_postings_) {
+        memory_usage += postings.GetMemoryUsage();
+    }
+
+    return memory_usage;
+}
+
+uint32_t IndexSegment::GetCheckedSize(size_t index) const {
+    // потоки, одновременно проверяющие список, получают одно значение
+    uint32_t size = checked_sizes_[index].load(memory_order_relaxed);
+    if (size != UNCHECKED_SIZE) {
+        return size;
+    }
+    const Posting* postings = mapped_postings_ + posting_offsets_[index];
+    const uint32_t stored_size =
+        posting_offsets_[index + 1] - posting_offsets_[index];
+    int previous_document_id = -1;
+    for (size = 0; size < stored_size; ++size) {
+        const int document_id = postings[size].document_id;
+        if (document_id <= previous_document_id ||
+            document_id >= document_id_end_) {
+            break;
+        }
+        previous_document_id = document_id;
+    }
+    checked_sizes_[index].store(size, memory_order_relaxed);
+    return size;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "compressed_posting_list.h"
+#include "posting.h"
+
+using TermId = uint32_t;
+
+enum class IndexLayout {
+    PLAIN,
+    COMPRESSED,
+};
+
+// Часть списка вхождений слова: сегмент или буфер записи. В режиме
+// IndexLayout::PLAIN вхождения и максимумы частоты по блокам из
+// POSTING_BLOCK_SIZE вхождений лежат в непрерывных массивах,
+// в режиме COMPRESSED часть задается сжатым списком.
+struct PostingListPart {
+    const Posting* postings = nullptr;
+    size_t size = 0;
+    const double* block_max_term_freqs = nullptr;
+    const CompressedPostingList* compressed = nullptr;
+};
+
+// Неизменяемый сегмент индекса: списки слов уложены подряд
+// по возрастанию TermId. Слияние сегментов уровня L дает уровень L + 1.
+class IndexSegment {
+   public:
+    IndexSegment(IndexLayout layout, int level);
+
+    // Вхождения читаются на месте из памяти storage и проверяются
+    // при первом обращении: список обрывается на первом неверном вхождении.
+    static IndexSegment MapPlain(std::shared_ptr<const void> storage,
+                                 std::vector<TermId> term_ids,
+                                 std::vector<uint32_t> posting_offsets,
+                                 std::vector<uint32_t> block_offsets,
+                                 const Posting* postings,
+                                 const double* block_max_term_freqs,
+                                 int document_id_end);
+
+    // Добавляют список вхождений слова при построении сегмента. Слова
+    // добавляются в порядке возрастания TermId.
+    void AddPostingList(TermId term_id, const std::vector<Posting>& postings);
+
+    void AddPostingList(TermId term_id, CompressedPostingList postings);
+
+    // Сливает сегменты соседних диапазонов, перечисленные по возрастанию
+    // номеров документов, в сегмент следующего уровня
+    static IndexSegment Merge(
+        const std::vector<std::shared_ptr<const IndexSegment>>& segments);
+
+    std::optional<PostingListPart> FindPostingList(TermId term_id) const;
+
+    // Число вхождений слова по смещениям списков, без проверки списка
+    // внешней памяти
+    size_t GetPostingListSize(TermId term_id) const;
+
+    // TermId слов сегмента по возрастанию
+    const std::vector<TermId>& GetTermIds() const;
+
+    // Номер, следующий за наибольшим номером документа сегмента
+    int GetDocumentIdEnd() const;
+
+    int GetLevel() const;
+
+    size_t GetPostingCount() const;
+
+    // Внешняя память MapPlain не учитывается
+    size_t GetMemoryUsage() const;
+
+   private:
+    IndexLayout layout_;
+    int level_;
+    std::vector<TermId> term_ids_;
+    // списки слов term_ids_[i] - postings_[posting_offsets_[i],
+    // posting_offsets_[i + 1]), максимумы по блокам - аналогично
+    std::vector<uint32_t> posting_offsets_ = {0};
+    std::vector<uint32_t> block_offsets_ = {0};
+    std::vector<Posting> postings_;
+    std::vector<double> block_max_term_freqs_;
+    std::vector<CompressedPostingList> compressed_postings_;
+    size_t posting_count_ = 0;
+    int document_id_end_ = 0;
+    // внешняя память MapPlain
+    std::shared_ptr<const void> storage_;
+    const Posting* mapped_postings_ = nullptr;
+    const double* mapped_block_max_term_freqs_ = nullptr;
+    // число проверенных вхождений каждого списка внешней памяти
+    std::unique_ptr<std::atomic<uint32_t>[]> checked_sizes_;
+
+    uint32_t GetCheckedSize(size_t index) const;
+};
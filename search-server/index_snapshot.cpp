@@ -0,0 +1,158 @@
+#include "index_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+#include "posting.h"
+
+using namespace std;
+
+SnapshotWriter::SnapshotWriter(const string& path)
+    : path_(path), temporary_path_(path + ".writing") {
+    using namespace std::string_literals;
+    output_.open(temporary_path_, ios::binary | ios::trunc);
+    if (!output_) {
+        throw system_error(errno, generic_category(),
+                           "Cannot create snapshot "s + temporary_path_);
+    }
+
+    // место под заголовок, который записывается последним
+    const SnapshotHeader header = {};
+    Write(&header, sizeof(header));
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (!finished_) {
+        output_.close();
+        unlink(temporary_path_.c_str());
+    }
+}
+
+size_t SnapshotWriter::Finish(const SnapshotHeader& header) {
+    using namespace std::string_literals;
+    output_.seekp(0);
+    output_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output_.close();
+    if (!output_) {
+        throw system_error(errno, generic_category(),
+                           "Cannot write snapshot"s);
+    }
+    // без fsync файла и каталога после сбоя питания path может указывать
+    // на пустой файл; прежний файл остается у своих отображений
+    SyncFile(temporary_path_);
+    if (rename(temporary_path_.c_str(), path_.c_str()) != 0) {
+        throw system_error(errno, generic_category(),
+                           "Cannot replace snapshot "s + path_);
+    }
+    finished_ = true;
+    const filesystem::path directory = filesystem::path(path_).parent_path();
+    SyncFile(directory.empty() ? "."s : directory.string());
+    return offset_;
+}
+
+void SnapshotWriter::Write(const void* data, size_t size) {
+    using namespace std::string_literals;
+    output_.write(static_cast<const char*>(data), size);
+    if (!output_) {
+        throw system_error(errno, generic_category(),
+                           "Cannot write snapshot"s);
+    }
+    offset_ += size;
+}
+
+void SyncFile(const string& path) {
+    using namespace std::string_literals;
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0 || fsync(file) != 0) {
+        const int error = errno;
+        if (file >= 0) {
+            close(file);
+        }
+        throw system_error(error, generic_category(), "Cannot sync "s + path);
+    }
+    close(file);
+}
+
+MappedFile::MappedFile(const string& path) {
+    using namespace std::string_literals;
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw system_error(errno, generic_category(), "Cannot open "s + path);
+    }
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0) {
+        const int error = errno;
+        close(file);
+        throw system_error(error, generic_category(), "Cannot stat "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ == 0) {
+        close(file);
+        throw invalid_argument("Snapshot "s + path + " is empty"s);
+    }
+
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+    const int error = errno;
+    close(file);
+    if (data == MAP_FAILED) {
+        throw system_error(error, generic_category(), "Cannot map "s + path);
+    }
+    data_ = static_cast<const char*>(data);
+}
+
+MappedFile::~MappedFile() { munmap(const_cast<char*>(data_), size_); }
+
+const char* MappedFile::GetData() const { return data_; }
+
+size_t MappedFile::GetSize() const { return size_; }
+
+const SnapshotHeader& MappedFile::GetSnapshotHeader() const {
+    using namespace std::string_literals;
+    if (size_ < sizeof(SnapshotHeader)) {
+        throw invalid_argument("File is not a snapshot"s);
+    }
+
+    const SnapshotHeader& header =
+        *reinterpret_cast<const SnapshotHeader*>(data_);
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw invalid_argument("File is not a snapshot"s);
+    }
+    if (header.version != SNAPSHOT_FORMAT_VERSION) {
+        throw invalid_argument("Unsupported snapshot version"s);
+    }
+    if (header.byte_order != SNAPSHOT_BYTE_ORDER ||
+        header.posting_size != sizeof(Posting)) {
+        throw invalid_argument("Snapshot was written on another platform"s);
+    }
+    return header;
+}
+
+string_view MappedFile::GetString(const SnapshotSection& strings,
+                                  const SnapshotString& string) const {
+    using namespace std::string_literals;
+    const char* data = GetSection<char>(strings);
+    if (string.offset > strings.count ||
+        string.size > strings.count - string.offset) {
+        throw invalid_argument("Corrupted snapshot"s);
+    }
+    return {data + string.offset, string.size};
+}
+
+void MappedFile::CheckSection(const SnapshotSection& section,
+                              size_t item_size, size_t alignment) const {
+    using namespace std::string_literals;
+    if (section.offset > size_ || section.offset % alignment != 0 ||
+        section.count > (size_ - section.offset) / item_size) {
+        throw invalid_argument("Corrupted snapshot"s);
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Версия формата снимка; снимок другой версии не загружается
+constexpr const uint32_t SNAPSHOT_FORMAT_VERSION = 1;
+
+// Результат SearchServer::SaveSnapshot и SearchServer::LoadSnapshot
+struct SnapshotStatistics {
+    size_t document_count = 0;
+    size_t byte_count = 0;
+    double seconds = 0.0;
+};
+
+// Снимок SearchServer - заголовок SnapshotHeader и разделы: массивы
+// структур, выровненные по 8 байт; строки хранятся в разделе strings.
+// Вхождения записаны как Posting в памяти и читаются прямо из файла.
+struct SnapshotSection {
+    uint64_t offset = 0;
+    // число элементов
+    uint64_t count = 0;
+};
+
+struct SnapshotString {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct SnapshotDocument {
+    int32_t id;
+    int32_t rating;
+    int32_t status;
+    // число слов документа в разделе word_freqs
+    uint32_t word_count;
+    SnapshotString text;
+};
+
+struct SnapshotWordFreq {
+    uint32_t term_id;
+    double term_freq;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t posting_size;
+    uint32_t reserved;
+    SnapshotSection strings;
+    SnapshotSection stop_words;
+    // слова словаря, индекс - TermId
+    SnapshotSection terms;
+    SnapshotSection documents;
+    // прямой индекс: слова документов подряд, в порядке документов
+    SnapshotSection word_freqs;
+    // инвертированный индекс в виде одного сегмента (см. IndexSegment)
+    SnapshotSection segment_term_ids;
+    SnapshotSection posting_offsets;
+    SnapshotSection block_offsets;
+    SnapshotSection postings;
+    SnapshotSection block_max_term_freqs;
+};
+
+constexpr const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H',
+                                         'S', 'N', 'A', 'P'};
+
+constexpr const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+// Последовательная запись разделов снимка во временный файл, который
+// заменяет path только в Finish
+class SnapshotWriter {
+   public:
+    // Ошибки ввода-вывода выбрасываются как std::system_error
+    explicit SnapshotWriter(const std::string& path);
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Удаляет временный файл, если Finish не был вызван
+    ~SnapshotWriter();
+
+    template <typename T>
+    SnapshotSection WriteSection(const std::vector<T>& items);
+
+    // Записывает заголовок, сбрасывает файл на диск, заменяет им path
+    // и возвращает размер файла
+    size_t Finish(const SnapshotHeader& header);
+
+   private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream output_;
+    uint64_t offset_ = 0;
+    bool finished_ = false;
+
+    void Write(const void* data, size_t size);
+};
+
+// Сбрасывает на диск данные файла или каталога path; ошибки выбрасываются
+// как std::system_error
+void SyncFile(const std::string& path);
+
+// Файл, отображенный в память только для чтения
+class MappedFile {
+   public:
+    // Ошибки открытия и отображения выбрасываются как std::system_error
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    const char* GetData() const;
+
+    size_t GetSize() const;
+
+    // Заголовок снимка; выбрасывает std::invalid_argument, если файл -
+    // не снимок поддерживаемой версии
+    const SnapshotHeader& GetSnapshotHeader() const;
+
+    // Элементы раздела; выбрасывает std::invalid_argument, если раздел
+    // выходит за пределы файла или не выровнен
+    template <typename T>
+    const T* GetSection(const SnapshotSection& section) const;
+
+    // Строка раздела strings
+    std::string_view GetString(const SnapshotSection& strings,
+                               const SnapshotString& string) const;
+
+   private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+
+    void CheckSection(const SnapshotSection& section, size_t item_size,
+                      size_t alignment) const;
+};
+
+template <typename T>
+SnapshotSection SnapshotWriter::WriteSection(const std::vector<T>& items) {
+    const SnapshotSection section{offset_, items.size()};
+    Write(items.data(), items.size() * sizeof(T));
+    const char padding[8] = {};
+    Write(padding, (8 - offset_ % 8) % 8);
+    return section;
+}
+
+template <typename T>
+const T* MappedFile::GetSection(const SnapshotSection& section) const {
+    CheckSection(section, sizeof(T), alignof(T));
+    return reinterpret_cast<const T*>(data_ + section.offset);
+}
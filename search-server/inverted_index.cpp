@@ -0,0 +1,401 @@
+#include "inverted_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+InvertedIndex::InvertedIndex(IndexLayout layout) : layout_(layout) {}
+
+IndexLayout InvertedIndex::GetLayout() const { return layout_; }
+
+optional<TermId> InvertedIndex::FindTerm(const string_view word) const {
+    const auto it = term_to_id_.find(word);
+    if (it == term_to_id_.end()) {
+        return nullopt;
+    }
+
+    return it->second;
+}
+
+TermId InvertedIndex::AddTerm(const string_view word) {
+    if (const auto it = term_to_id_.find(word); it != term_to_id_.end()) {
+        return it->second;
+    }
+
+    TermId term_id;
+    if (!free_term_ids_.empty()) {
+        term_id = free_term_ids_.back();
+        free_term_ids_.pop_back();
+        terms_[term_id] = term_arena_.Add(word);
+        tombstone_counts_[term_id] = 0;
+    } else {
+        term_id = static_cast<TermId>(terms_.size());
+        terms_.push_back(term_arena_.Add(word));
+        sealed_posting_counts_.push_back(0);
+        tombstone_counts_.push_back(0);
+        log_document_freqs_.push_back(0.0);
+        if (layout_ == IndexLayout::COMPRESSED) {
+            compressed_postings_.emplace_back();
+        } else {
+            postings_.emplace_back();
+            block_max_term_freqs_.emplace_back();
+        }
+    }
+    term_to_id_.emplace(terms_[term_id], term_id);
+
+    return term_id;
+}
+
+string_view InvertedIndex::GetTerm(TermId term_id) const {
+    return terms_[term_id];
+}
+
+size_t InvertedIndex::GetPostingCount(TermId term_id) const {
+    return sealed_posting_counts_[term_id] + GetBufferPostingCount(term_id);
+}
+
+size_t InvertedIndex::GetDocumentFreq(TermId term_id) const {
+    return GetPostingCount(term_id) - tombstone_counts_[term_id];
+}
+
+double InvertedIndex::GetLogDocumentFreq(TermId term_id) const {
+    return log_document_freqs_[term_id];
+}
+
+vector<TermId> InvertedIndex::GetTermIds() const {
+    vector<TermId> term_ids;
+    term_ids.reserve(term_to_id_.size());
+    for (const auto& [_, term_id] : term_to_id_) {
+        term_ids.push_back(term_id);
+    }
+    sort(term_ids.begin(), term_ids.end());
+
+    return term_ids;
+}
+
+vector<PostingListPart> InvertedIndex::GetPostingListParts(
+    TermId term_id) const {
+    vector<PostingListPart> parts;
+    GetPostingListParts(term_id, parts);
+    return parts;
+}
+
+void InvertedIndex::GetPostingListParts(TermId term_id,
+                                        vector<PostingListPart>& parts) const {
+    parts.clear();
+    if (sealed_posting_counts_[term_id] != 0) {
+        for (const auto& segment : segments_) {
+            if (const auto part = segment->FindPostingList(term_id)) {
+                parts.push_back(*part);
+            }
+        }
+    }
+
+    if (GetBufferPostingCount(term_id) != 0) {
+        PostingListPart part;
+        if (layout_ == IndexLayout::COMPRESSED) {
+            part.compressed = &compressed_postings_[term_id];
+            part.size = part.compressed->size();
+        } else {
+            part.postings = postings_[term_id].data();
+            part.size = postings_[term_id].size();
+            part.block_max_term_freqs = block_max_term_freqs_[term_id].data();
+        }
+        parts.push_back(part);
+    }
+}
+
+size_t InvertedIndex::GetTermCount() const { return term_to_id_.size(); }
+
+IndexStatistics InvertedIndex::GetStatistics() const {
+    IndexStatistics statistics;
+    statistics.term_count = GetTermCount();
+    statistics.terms_bytes = term_arena_.GetMemoryUsage() +
+                             terms_.capacity() * sizeof(string_view);
+    if (layout_ == IndexLayout::COMPRESSED) {
+        for (const CompressedPostingList& postings : compressed_postings_) {
+            statistics.posting_count += postings.size();
+            statistics.postings_bytes += postings.GetMemoryUsage();
+        }
+    } else {
+        for (const vector<Posting>& postings : postings_) {
+            statistics.posting_count += postings.size();
+            statistics.postings_bytes +=
+                sizeof(postings) + postings.capacity() * sizeof(Posting);
+        }
+        for (const vector<double>& block_maxes : block_max_term_freqs_) {
+            statistics.postings_bytes +=
+                sizeof(block_maxes) + block_maxes.capacity() * sizeof(double);
+        }
+    }
+    statistics.segment_count = segments_.size();
+    for (const auto& segment : segments_) {
+        statistics.posting_count += segment->GetPostingCount();
+        statistics.postings_bytes += segment->GetMemoryUsage();
+    }
+
+    return statistics;
+}
+
+void InvertedIndex::AddPosting(TermId term_id, int document_id,
+                               double term_freq) {
+    using namespace std::string_literals;
+    if (document_id < sealed_document_id_end_) {
+        throw invalid_argument("Document belongs to a sealed segment"s);
+    }
+
+    const size_t buffer_posting_count = GetBufferPostingCount(term_id);
+    if (layout_ == IndexLayout::COMPRESSED) {
+        compressed_postings_[term_id].Add(document_id, term_freq);
+    } else {
+        vector<Posting>& postings = postings_[term_id];
+        // документы обычно добавляются с возрастающими id
+        if (postings.empty() || postings.back().document_id < document_id) {
+            postings.push_back({document_id, term_freq});
+            UpdateBlockMaxTermFreqs(term_id, postings.size() - 1);
+        } else {
+            auto it = lower_bound(postings.begin(), postings.end(),
+                                  document_id,
+                                  [](const Posting& posting, int id) {
+                                      return posting.document_id < id;
+                                  });
+            const size_t position = it - postings.begin();
+            if (it != postings.end() && it->document_id == document_id) {
+                it->term_freq += term_freq;
+            } else {
+                postings.insert(it, {document_id, term_freq});
+            }
+            UpdateBlockMaxTermFreqs(term_id, position);
+        }
+    }
+    buffer_posting_count_ +=
+        GetBufferPostingCount(term_id) - buffer_posting_count;
+    UpdateLogDocumentFreq(term_id);
+}
+
+void InvertedIndex::AddSegment(IndexSegment segment) {
+    if (segment.GetTermIds().empty()) {
+        return;
+    }
+
+    SealBuffer();
+    for (const TermId term_id : segment.GetTermIds()) {
+        sealed_posting_counts_[term_id] +=
+            segment.GetPostingListSize(term_id);
+        UpdateLogDocumentFreq(term_id);
+    }
+    sealed_document_id_end_ =
+        max(sealed_document_id_end_, segment.GetDocumentIdEnd());
+    segments_.push_back(make_shared<const IndexSegment>(move(segment)));
+    ScheduleMerge();
+}
+
+void InvertedIndex::ErasePosting(TermId term_id, int document_id) {
+    DiscountBufferPostings(ErasePostings(term_id, &document_id, 1));
+}
+
+size_t InvertedIndex::ErasePostings(TermId term_id, const int* document_ids,
+                                    size_t count) {
+    const int* const last = document_ids + count;
+    const int* const buffer_first =
+        lower_bound(document_ids, last, sealed_document_id_end_);
+    tombstone_counts_[term_id] += buffer_first - document_ids;
+    document_ids = buffer_first;
+
+    const size_t buffer_posting_count = GetBufferPostingCount(term_id);
+    if (layout_ == IndexLayout::COMPRESSED) {
+        for (; document_ids != last; ++document_ids) {
+            compressed_postings_[term_id].Erase(*document_ids);
+        }
+    } else {
+        vector<Posting>& postings = postings_[term_id];
+        size_t first_position = postings.size();
+        size_t kept_count = 0;
+        for (size_t i = 0; i < postings.size(); ++i) {
+            while (document_ids != last &&
+                   *document_ids < postings[i].document_id) {
+                ++document_ids;
+            }
+            if (document_ids != last &&
+                *document_ids == postings[i].document_id) {
+                first_position = min(first_position, i);
+                continue;
+            }
+            postings[kept_count++] = postings[i];
+        }
+        postings.resize(kept_count);
+        UpdateBlockMaxTermFreqs(term_id, first_position);
+    }
+    UpdateLogDocumentFreq(term_id);
+    return buffer_posting_count - GetBufferPostingCount(term_id);
+}
+
+void InvertedIndex::DiscountBufferPostings(size_t erased_count) {
+    buffer_posting_count_ -= erased_count;
+}
+
+void InvertedIndex::TombstonePosting(TermId term_id) {
+    ++tombstone_counts_[term_id];
+    UpdateLogDocumentFreq(term_id);
+}
+
+void InvertedIndex::RemovePosting(TermId term_id, int document_id) {
+    ErasePosting(term_id, document_id);
+    RemoveTermIfEmpty(term_id);
+}
+
+void InvertedIndex::RemoveTermIfEmpty(TermId term_id) {
+    if (GetDocumentFreq(term_id) != 0) {
+        return;
+    }
+
+    const auto it = term_to_id_.find(terms_[term_id]);
+    if (it == term_to_id_.end() || it->second != term_id) {
+        return;
+    }
+    term_to_id_.erase(it);
+    if (GetPostingCount(term_id) != 0) {
+        return;
+    }
+    if (layout_ == IndexLayout::COMPRESSED) {
+        compressed_postings_[term_id] = CompressedPostingList();
+    } else {
+        postings_[term_id].shrink_to_fit();
+        block_max_term_freqs_[term_id].clear();
+        block_max_term_freqs_[term_id].shrink_to_fit();
+    }
+    free_term_ids_.push_back(term_id);
+}
+
+size_t InvertedIndex::GetSegmentBufferSize() const {
+    return segment_buffer_size_;
+}
+
+void InvertedIndex::SetSegmentBufferSize(size_t posting_count) {
+    segment_buffer_size_ = posting_count;
+}
+
+void InvertedIndex::SealBufferIfFull() {
+    if (buffer_posting_count_ >= segment_buffer_size_) {
+        SealBuffer();
+    }
+}
+
+void InvertedIndex::SealBuffer() {
+    InstallCompletedMerge();
+    if (buffer_posting_count_ == 0) {
+        return;
+    }
+
+    IndexSegment segment(layout_, 0);
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        const size_t posting_count = GetBufferPostingCount(term_id);
+        if (posting_count == 0) {
+            continue;
+        }
+
+        sealed_posting_counts_[term_id] += posting_count;
+        if (layout_ == IndexLayout::COMPRESSED) {
+            segment.AddPostingList(term_id,
+                                   move(compressed_postings_[term_id]));
+            compressed_postings_[term_id] = CompressedPostingList();
+        } else {
+            segment.AddPostingList(term_id, postings_[term_id]);
+            postings_[term_id] = {};
+            block_max_term_freqs_[term_id] = {};
+        }
+    }
+    buffer_posting_count_ = 0;
+    sealed_document_id_end_ =
+        max(sealed_document_id_end_, segment.GetDocumentIdEnd());
+    segments_.push_back(make_shared<const IndexSegment>(move(segment)));
+    ScheduleMerge();
+}
+
+void InvertedIndex::WaitForMerges() {
+    while (pending_merge_.valid()) {
+        pending_merge_.wait();
+        InstallCompletedMerge();
+    }
+}
+
+size_t InvertedIndex::GetBufferPostingCount(TermId term_id) const {
+    if (layout_ == IndexLayout::COMPRESSED) {
+        return compressed_postings_[term_id].size();
+    }
+
+    return postings_[term_id].size();
+}
+
+void InvertedIndex::ScheduleMerge() {
+    if (pending_merge_.valid()) {
+        return;
+    }
+
+    for (size_t first = 0; first + SEGMENT_MERGE_FACTOR <= segments_.size();
+         ++first) {
+        const auto level_differs = [&](const auto& segment) {
+            return segment->GetLevel() != segments_[first]->GetLevel();
+        };
+        if (any_of(segments_.begin() + first + 1,
+                   segments_.begin() + first + SEGMENT_MERGE_FACTOR,
+                   level_differs)) {
+            continue;
+        }
+
+        // сливаемые сегменты неизменяемы, поэтому поток читает их без
+        // синхронизации, пока индекс продолжает меняться
+        vector<shared_ptr<const IndexSegment>> merged_segments(
+            segments_.begin() + first,
+            segments_.begin() + first + SEGMENT_MERGE_FACTOR);
+        merge_first_segment_ = first;
+        pending_merge_ = async(launch::async, [merged_segments]() {
+            return IndexSegment::Merge(merged_segments);
+        });
+        return;
+    }
+}
+
+void InvertedIndex::InstallCompletedMerge() {
+    if (!pending_merge_.valid() ||
+        pending_merge_.wait_for(chrono::seconds(0)) != future_status::ready) {
+        return;
+    }
+
+    // пока шло слияние, сегменты только добавлялись в конец
+    const auto first = segments_.begin() + merge_first_segment_;
+    *first = make_shared<const IndexSegment>(pending_merge_.get());
+    segments_.erase(first + 1, first + SEGMENT_MERGE_FACTOR);
+    ScheduleMerge();
+}
+
+void InvertedIndex::UpdateBlockMaxTermFreqs(TermId term_id,
+                                            size_t first_position) {
+    const vector<Posting>& postings = postings_[term_id];
+    vector<double>& block_maxes = block_max_term_freqs_[term_id];
+    block_maxes.resize((postings.size() + POSTING_BLOCK_SIZE - 1) /
+                       POSTING_BLOCK_SIZE);
+    for (size_t block = first_position / POSTING_BLOCK_SIZE;
+         block < block_maxes.size(); ++block) {
+        const auto block_begin = postings.begin() + block * POSTING_BLOCK_SIZE;
+        const auto block_end =
+            postings.begin() +
+            min(postings.size(), (block + 1) * POSTING_BLOCK_SIZE);
+        block_maxes[block] = max_element(block_begin, block_end,
+                                         [](const Posting& lhs,
+                                            const Posting& rhs) {
+                                             return lhs.term_freq <
+                                                    rhs.term_freq;
+                                         })
+                                 ->term_freq;
+    }
+}
+
+void InvertedIndex::UpdateLogDocumentFreq(TermId term_id) {
+    const size_t document_freq = GetDocumentFreq(term_id);
+    log_document_freqs_[term_id] =
+        document_freq == 0 ? 0.0 : log(static_cast<double>(document_freq));
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "compressed_posting_list.h"
+#include "index_segment.h"
+#include "posting.h"
+#include "string_arena.h"
+
+// Число вхождений в буфере записи, при котором он запечатывается в сегмент
+constexpr const size_t SEGMENT_BUFFER_POSTING_COUNT = 1 << 16;
+
+// Число сегментов одного уровня, которые сливаются в один
+constexpr const size_t SEGMENT_MERGE_FACTOR = 4;
+
+struct IndexStatistics {
+    size_t term_count = 0;
+    size_t posting_count = 0;
+    size_t postings_bytes = 0;
+    size_t terms_bytes = 0;
+    size_t segment_count = 0;
+    // заполняется SearchServer
+    size_t texts_bytes = 0;
+};
+
+// Словарь термов и инвертированный индекс в виде LSM-дерева: буфер
+// записи запечатывается в неизменяемые сегменты, которые сливаются
+// в фоне. Части списка слова покрывают возрастающие диапазоны id.
+// Удаленные вхождения сегментов только помечаются.
+class InvertedIndex {
+   public:
+    explicit InvertedIndex(IndexLayout layout = IndexLayout::PLAIN);
+
+    IndexLayout GetLayout() const;
+
+    std::optional<TermId> FindTerm(const std::string_view word) const;
+
+    TermId AddTerm(const std::string_view word);
+
+    std::string_view GetTerm(TermId term_id) const;
+
+    size_t GetPostingCount(TermId term_id) const;
+
+    // Число вхождений слова, не помеченных удаленными
+    size_t GetDocumentFreq(TermId term_id) const;
+
+    // Логарифм числа документов со словом. Пересчитывается при изменении
+    // списка вхождений, чтобы при поиске не вычислять логарифм заново.
+    double GetLogDocumentFreq(TermId term_id) const;
+
+    std::vector<TermId> GetTermIds() const;
+
+    // Части списка вхождений слова в порядке возрастания id документа
+    std::vector<PostingListPart> GetPostingListParts(TermId term_id) const;
+
+    // То же, но части заменяют содержимое parts, и память parts
+    // переиспользуется
+    void GetPostingListParts(TermId term_id,
+                             std::vector<PostingListPart>& parts) const;
+
+    // Вызывает function(document_id, term_freq) для каждого вхождения слова
+    // в порядке возрастания id документа
+    template <typename Function>
+    void ForEachPosting(TermId term_id, Function function) const;
+
+    size_t GetTermCount() const;
+
+    IndexStatistics GetStatistics() const;
+
+    // Добавляет вхождение в буфер записи. id документа не может
+    // принадлежать уже запечатанному сегменту.
+    void AddPosting(TermId term_id, int document_id, double term_freq);
+
+    // Добавляет готовый сегмент с id больше уже имеющихся. Буфер
+    // записи предварительно запечатывается.
+    void AddSegment(IndexSegment segment);
+
+    void ErasePosting(TermId term_id, int document_id);
+
+    // Удаляет вхождения отсортированных документов document_ids[0..count).
+    // Возвращает число удаленных из буфера вхождений: их сумму по всем
+    // словам нужно передать в DiscountBufferPostings.
+    size_t ErasePostings(TermId term_id, const int* document_ids,
+                         size_t count);
+
+    void DiscountBufferPostings(size_t erased_count);
+
+    // Помечает одно вхождение слова как принадлежащее удаленному документу.
+    // Вхождение остается в списке, но не учитывается в GetDocumentFreq.
+    void TombstonePosting(TermId term_id);
+
+    void RemovePosting(TermId term_id, int document_id);
+
+    // Убирает слово без живых вхождений. Идентификатор переиспользуется,
+    // только когда в сегментах не осталось помеченных вхождений.
+    void RemoveTermIfEmpty(TermId term_id);
+
+    size_t GetSegmentBufferSize() const;
+
+    void SetSegmentBufferSize(size_t posting_count);
+
+    // Запечатывает заполненный буфер; вызывается между документами
+    void SealBufferIfFull();
+
+    void SealBuffer();
+
+    // Дожидается завершения фоновых слияний сегментов
+    void WaitForMerges();
+
+    // Заменяет сливаемые сегменты результатом, если слияние завершено.
+    // Поиск не вызывает этот метод: курсоры ссылаются на сегменты без
+    // владения, поэтому подмена допустима только при изменении индекса.
+    void InstallCompletedMerge();
+
+   private:
+    IndexLayout layout_;
+    std::unordered_map<std::string_view, TermId> term_to_id_;
+    StringArena term_arena_;
+    std::vector<std::string_view> terms_;
+    // буфер записи
+    std::vector<std::vector<Posting>> postings_;
+    // максимальная частота слова в каждом блоке из POSTING_BLOCK_SIZE
+    // вхождений postings_
+    std::vector<std::vector<double>> block_max_term_freqs_;
+    std::vector<CompressedPostingList> compressed_postings_;
+    size_t buffer_posting_count_ = 0;
+    size_t segment_buffer_size_ = SEGMENT_BUFFER_POSTING_COUNT;
+    // сегменты по возрастанию id документов; id меньше
+    // sealed_document_id_end_ принадлежат сегментам
+    std::vector<std::shared_ptr<const IndexSegment>> segments_;
+    int sealed_document_id_end_ = 0;
+    std::vector<uint32_t> sealed_posting_counts_;
+    // фоновое слияние сегментов segments_[merge_first_segment_,
+    // merge_first_segment_ + SEGMENT_MERGE_FACTOR)
+    std::future<IndexSegment> pending_merge_;
+    size_t merge_first_segment_ = 0;
+    std::vector<uint32_t> tombstone_counts_;
+    std::vector<double> log_document_freqs_;
+    std::vector<TermId> free_term_ids_;
+
+    size_t GetBufferPostingCount(TermId term_id) const;
+
+    // Запускает слияние, если есть SEGMENT_MERGE_FACTOR соседних сегментов
+    // одного уровня и другое слияние не выполняется
+    void ScheduleMerge();
+
+    void UpdateBlockMaxTermFreqs(TermId term_id, size_t first_position);
+
+    void UpdateLogDocumentFreq(TermId term_id);
+};
+
+template <typename Function>
+void InvertedIndex::ForEachPosting(TermId term_id, Function function) const {
+    for (const PostingListPart& part : GetPostingListParts(term_id)) {
+        if (part.compressed != nullptr) {
+            part.compressed->ForEach(function);
+            continue;
+        }
+
+        for (size_t i = 0; i < part.size; ++i) {
+            function(part.postings[i].document_id, part.postings[i].term_freq);
+        }
+    }
+}
@@ -1,12 +1,35 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
 #include <execution>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <random>
+#include <set>
+#include <thread>
 
+#include "directory_indexer.h"
+#include "durable_search_server.h"
 #include "log_duration.h"
+#include "process_queries.h"
+#include "query_executor.h"
+#include "read_input_functions.h"
 #include "search_server.h"
+#include "stop_word_set.h"
+#include "string_processing.h"
 
 using namespace std;
 
+// Путь во временном каталоге, уникальный для процесса и вызова
+string MakeTemporaryPath(string_view name) {
+    static int counter = 0;
+    return (filesystem::temp_directory_path() /
+            ("search_server_"s + to_string(getpid()) + "_"s +
+             to_string(counter++) + "_"s + string(name)))
+        .string();
+}
 string GenerateWord(mt19937& generator, int max_length) {
     const int length = uniform_int_distribution(1, max_length)(generator);
     string word;
@@ -51,12 +74,12 @@ vector<string> GenerateQueries(mt19937& generator,
     }
     return queries;
 }
-template <typename ExecutionPolicy>
+template <typename Query, typename ExecutionPolicy>
 void Test(string_view mark, const SearchServer& search_server,
-          const vector<string>& queries, ExecutionPolicy&& policy) {
+          const vector<Query>& queries, ExecutionPolicy&& policy) {
     LOG_DURATION(mark);
     double total_relevance = 0;
-    for (const string_view query : queries) {
+    for (const Query& query : queries) {
         for (const auto& document :
              search_server.FindTopDocuments(policy, query)) {
             total_relevance += document.relevance;
@@ -64,17 +87,382 @@ void Test(string_view mark, const SearchServer& search_server,
     }
     cout << total_relevance << endl;
 }
+void PrintIndexStatistics(string_view mark,
+                          const SearchServer& search_server) {
+    const IndexStatistics statistics = search_server.GetIndexStatistics();
+    cout << mark << ": "sv << statistics.posting_count << " postings, "sv
+         << statistics.postings_bytes << " bytes, "sv
+         << static_cast<double>(statistics.postings_bytes) /
+                statistics.posting_count
+         << " bytes per posting, "sv << statistics.terms_bytes
+         << " term bytes, "sv << statistics.texts_bytes << " text bytes, "sv
+         << statistics.segment_count << " segments"sv << endl;
+}
+void PrintIngestionStatistics(string_view mark,
+                              const IngestionStatistics& statistics) {
+    cout << mark << ": "sv << statistics.document_count << " documents, "sv
+         << statistics.GetDocumentsPerSecond() << " docs/sec, "sv
+         << statistics.GetMegabytesPerSecond() << " MB/sec"sv << endl;
+}
+void PrintSnapshotStatistics(string_view mark,
+                             const SnapshotStatistics& statistics) {
+    cout << mark << ": "sv << statistics.document_count << " documents, "sv
+         << statistics.byte_count << " bytes, "sv
+         << static_cast<int>(statistics.seconds * 1000) << " ms"sv << endl;
+}
+void TestDurableWrites(string_view mark, WalSync sync,
+                       const string& stop_words,
+                       const vector<string>& documents) {
+    const string snapshot_path = MakeTemporaryPath("durable.bin"sv);
+    const string log_path = MakeTemporaryPath("durable.wal"sv);
+    const int writer_count = 4;
+    {
+        DurableSearchServer search_server(snapshot_path, log_path, sync,
+                                          stop_words);
+        {
+            LOG_DURATION(mark);
+            vector<thread> writers;
+            for (int writer = 0; writer < writer_count; ++writer) {
+                writers.emplace_back([&, writer]() {
+                    for (size_t i = writer; i < documents.size();
+                         i += writer_count) {
+                        search_server.AddDocument(static_cast<int>(i),
+                                                  documents[i],
+                                                  DocumentStatus::ACTUAL,
+                                                  {1, 2, 3});
+                    }
+                });
+            }
+            for (thread& writer : writers) {
+                writer.join();
+            }
+        }
+        cout << search_server.GetLog().GetRecordCount() << " records, "sv
+             << search_server.GetLog().GetSyncCount() << " syncs"sv << endl;
+    }
+    DurableSearchServer recovered_server(snapshot_path, log_path, sync,
+                                         stop_words);
+    const RecoveryStatistics& statistics =
+        recovered_server.GetRecoveryStatistics();
+    cout << "recovery: "sv << statistics.replayed_record_count
+         << " records, "sv << static_cast<int>(statistics.seconds * 1000)
+         << " ms"sv << endl;
+    remove(log_path.c_str());
+    remove(snapshot_path.c_str());
+}
+void PrintDirectoryIndexingStatistics(
+    string_view mark, const DirectoryIndexingStatistics& statistics) {
+    cout << mark << ": "sv << statistics.indexed_file_count << " indexed, "sv
+         << statistics.unchanged_file_count << " unchanged, "sv
+         << statistics.byte_count << " bytes, "sv
+         << static_cast<int>(statistics.seconds * 1000) << " ms"sv << endl;
+}
+void TestDirectoryIndexing(const string& stop_words,
+                           const vector<string>& documents) {
+    const filesystem::path root = MakeTemporaryPath("corpus"sv);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const filesystem::path directory = root / to_string(i / 1000);
+        filesystem::create_directories(directory);
+        ofstream(directory / (to_string(i) + ".txt"s)) << documents[i];
+    }
+    SearchServer search_server(stop_words);
+    DirectoryIndexer indexer(search_server);
+    PrintDirectoryIndexingStatistics("index directory"sv,
+                                     indexer.Index({root.string()}));
+    PrintDirectoryIndexingStatistics("reindex directory"sv,
+                                     indexer.Index({root.string()}));
+    filesystem::remove_all(root);
+}
+void TestInputParsing(const vector<string>& documents) {
+    const string input_path = MakeTemporaryPath("input.txt"sv);
+    {
+        ofstream output(input_path);
+        output << documents.size() << '\n';
+        for (const string& document : documents) {
+            output << document << "\n3 1 2 3\n"sv;
+        }
+    }
+    {
+        LOG_DURATION("parse with iostream"sv);
+        ifstream input(input_path);
+        size_t document_count = 0;
+        input >> document_count;
+        string text;
+        getline(input, text);
+        size_t byte_count = 0;
+        for (size_t i = 0; i < document_count; ++i) {
+            getline(input, text);
+            byte_count += text.size();
+            size_t rating_count = 0;
+            input >> rating_count;
+            for (size_t j = 0; j < rating_count; ++j) {
+                int rating = 0;
+                input >> rating;
+            }
+            getline(input, text);
+        }
+        cout << byte_count << " bytes"sv << endl;
+    }
+    {
+        LOG_DURATION("parse with InputReader"sv);
+        InputReader input(input_path);
+        const int document_count = input.ReadNumber();
+        vector<int> ratings;
+        size_t byte_count = 0;
+        for (int i = 0; i < document_count; ++i) {
+            byte_count += input.ReadLine()->size();
+            input.ReadNumbers(ratings);
+        }
+        cout << byte_count << " bytes"sv << endl;
+    }
+    SearchServer search_server(""s);
+    InputReader input(input_path);
+    PrintIngestionStatistics("bulk load"sv,
+                             LoadDocuments(input, search_server));
+    remove(input_path.c_str());
+}
+// Пакетный режим: стоп-слова, документы в формате LoadDocuments и запросы
+// в формате ReadQueries читаются из файла или стандартного ввода, для
+// каждого запроса выводятся id найденных документов
+void RunBulkMode(InputReader& input) {
+    const optional<string_view> stop_words = input.ReadLine();
+    SearchServer search_server(stop_words.value_or(""sv));
+    LoadDocuments(input, search_server);
+    const vector<string> queries = ReadQueries(input);
+    for (const SearchResult& result :
+         ProcessQueriesBatch(search_server, queries)) {
+        bool first = true;
+        for (const Document& document : result) {
+            cout << (first ? ""sv : " "sv) << document.id;
+            first = false;
+        }
+        cout << '\n';
+    }
+}
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
-int main() {
+void TestQueryCache(SearchServer& search_server, const vector<string>& queries,
+                    mt19937& generator) {
+    // запрос с номером i выбирается тем чаще, чем меньше i, как
+    // в реальном потоке, где немногие запросы составляют большую часть
+    vector<string> traffic;
+    for (int i = 0; i < 1000; ++i) {
+        const double value = uniform_real_distribution<>(0, 1)(generator);
+        traffic.push_back(queries[static_cast<size_t>(value * value * value *
+                                                      queries.size())]);
+    }
+    Test("skewed queries without cache"sv, search_server, traffic,
+         execution::seq);
+    search_server.SetQueryCacheCapacity(32);
+    Test("skewed queries with cache"sv, search_server, traffic,
+         execution::seq);
+    const QueryCacheStatistics statistics =
+        search_server.GetQueryCacheStatistics();
+    cout << "query cache: "sv << statistics.GetHitRate() * 100
+         << "% hits, "sv << statistics.eviction_count << " evictions, "sv
+         << statistics.memory_bytes << " bytes"sv << endl;
+    search_server.SetQueryCacheCapacity(0);
+}
+void TestQueryBatch(const SearchServer& search_server,
+                    const vector<string>& dictionary, mt19937& generator) {
+    // слова запросов распределены по закону Ципфа: слово с номером i
+    // встречается с частотой, пропорциональной 1 / (i + 1)
+    vector<double> weights(dictionary.size());
+    for (size_t i = 0; i < weights.size(); ++i) {
+        weights[i] = 1.0 / (i + 1);
+    }
+    discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+    vector<string> queries(2000);
+    for (string& query : queries) {
+        for (int i = 0; i < 10; ++i) {
+            query += (i > 0 ? " "s : ""s) + dictionary[zipf(generator)];
+        }
+    }
+
+    for (const bool batch : {false, true}) {
+        const auto start_time = chrono::steady_clock::now();
+        const vector<SearchResult> results =
+            batch ? ProcessQueriesBatch(search_server, queries)
+                  : ProcessQueries(search_server, queries);
+        const double seconds = chrono::duration<double>(
+                                   chrono::steady_clock::now() - start_time)
+                                   .count();
+        double total_relevance = 0;
+        for (const SearchResult& result : results) {
+            for (const Document& document : result) {
+                total_relevance += document.relevance;
+            }
+        }
+        cout << (batch ? "zipf queries batch: "sv : "zipf queries: "sv)
+             << queries.size() / seconds << " queries/sec, "sv
+             << total_relevance << endl;
+    }
+}
+void TestQueryExecutor(const SearchServer& search_server,
+                       const vector<string>& queries) {
+    // повторяющиеся пакеты, как у сервера под постоянной нагрузкой
+    constexpr int BATCH_COUNT = 20;
+    QueryExecutor executor;
+    vector<vector<Document>> results;
+    executor.Process(search_server, queries, results);
+    for (const bool use_executor : {false, true}) {
+        const auto start_time = chrono::steady_clock::now();
+        for (int i = 0; i < BATCH_COUNT; ++i) {
+            if (use_executor) {
+                executor.Process(search_server, queries, results);
+            } else {
+                results = ProcessQueries(search_server, queries);
+            }
+        }
+        const double seconds = chrono::duration<double>(
+                                   chrono::steady_clock::now() - start_time)
+                                   .count();
+        cout << (use_executor ? "query executor: "sv : "process queries: "sv)
+             << BATCH_COUNT * queries.size() / seconds << " queries/sec"sv
+             << endl;
+    }
+    cout << "query executor: "sv << executor.GetThreadCount()
+         << " threads, "sv << executor.GetStatistics().steal_count
+         << " steals"sv << endl;
+}
+int main(int argc, char* argv[]) {
+    if (argc > 1 && argv[1] == "--bulk"sv) {
+        if (argc > 2) {
+            InputReader input{string(argv[2])};
+            RunBulkMode(input);
+        } else {
+            InputReader input;
+            RunBulkMode(input);
+        }
+        return 0;
+    }
+
     mt19937 generator;
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
     const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
-    SearchServer search_server(dictionary[0]);
-    for (size_t i = 0; i < documents.size(); ++i) {
-        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL,
-                                  {1, 2, 3});
-    }
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
-    TEST(seq);
-    TEST(par);
+    {
+        LOG_DURATION("tokenize"sv);
+        vector<string_view> words;
+        size_t word_count = 0;
+        for (const string& document : documents) {
+            SplitIntoWords(document, words);
+            word_count += words.size();
+        }
+        cout << word_count << " words"sv << endl;
+    }
+    {
+        const vector<string> stop_word_list(dictionary.begin(),
+                                            dictionary.begin() + 100);
+        const set<string, less<>> stop_word_tree(stop_word_list.begin(),
+                                                 stop_word_list.end());
+        const StopWordSet stop_word_table(stop_word_list);
+        vector<vector<string_view>> document_words(documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            SplitIntoWords(documents[i], document_words[i]);
+        }
+        {
+            LOG_DURATION("stop words std::set"sv);
+            size_t stop_word_count = 0;
+            for (const vector<string_view>& words : document_words) {
+                for (const string_view word : words) {
+                    stop_word_count += stop_word_tree.count(word);
+                }
+            }
+            cout << stop_word_count << " stop words"sv << endl;
+        }
+        {
+            LOG_DURATION("stop words perfect hash"sv);
+            size_t stop_word_count = 0;
+            for (const vector<string_view>& words : document_words) {
+                for (const string_view word : words) {
+                    stop_word_count += stop_word_table.Contains(word);
+                }
+            }
+            cout << stop_word_count << " stop words"sv << endl;
+        }
+    }
+    {
+        SearchServer search_server(dictionary[0]);
+        vector<NewDocument> new_documents;
+        new_documents.reserve(documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            new_documents.push_back({static_cast<int>(i), documents[i],
+                                     DocumentStatus::ACTUAL, {1, 2, 3}});
+        }
+        PrintIngestionStatistics(
+            "ingestion"sv,
+            search_server.AddDocuments(execution::par, new_documents));
+        PrintIndexStatistics("plain"sv, search_server);
+        TEST(seq);
+        TEST(par);
+        search_server.SetRetrievalEngine(RetrievalEngine::WAND);
+        Test("wand"sv, search_server, queries, execution::seq);
+        search_server.SetRetrievalEngine(RetrievalEngine::EXHAUSTIVE);
+        {
+            vector<SearchServer::PreparedQuery> prepared_queries;
+            for (const string& query : queries) {
+                prepared_queries.push_back(search_server.PrepareQuery(query));
+            }
+            Test("prepared seq"sv, search_server, prepared_queries,
+                 execution::seq);
+            Test("prepared par"sv, search_server, prepared_queries,
+                 execution::par);
+        }
+        search_server.BuildImpactIndex();
+        search_server.SetRetrievalEngine(RetrievalEngine::IMPACT);
+        Test("impact"sv, search_server, queries, execution::seq);
+        {
+            const string snapshot_path = MakeTemporaryPath("snapshot.bin"sv);
+            PrintSnapshotStatistics("save snapshot"sv,
+                                    search_server.SaveSnapshot(snapshot_path));
+            SearchServer loaded_server(""s);
+            PrintSnapshotStatistics("load snapshot"sv,
+                                    loaded_server.LoadSnapshot(snapshot_path));
+            Test("snapshot"sv, loaded_server, queries, execution::seq);
+            remove(snapshot_path.c_str());
+        }
+        {
+            const vector<string> durable_documents(documents.begin(),
+                                                   documents.begin() + 2000);
+            {
+                SearchServer volatile_server(dictionary[0]);
+                LOG_DURATION("wal off"sv);
+                for (size_t i = 0; i < durable_documents.size(); ++i) {
+                    volatile_server.AddDocument(i, durable_documents[i],
+                                                DocumentStatus::ACTUAL,
+                                                {1, 2, 3});
+                }
+            }
+            TestDurableWrites("wal without fdatasync"sv, WalSync::NONE,
+                              dictionary[0], durable_documents);
+            TestDurableWrites("wal with fdatasync"sv, WalSync::FDATASYNC,
+                              dictionary[0], durable_documents);
+        }
+        TestDirectoryIndexing(dictionary[0], documents);
+        TestInputParsing(documents);
+        search_server.SetRetrievalEngine(RetrievalEngine::EXHAUSTIVE);
+        TestQueryCache(search_server, queries, generator);
+        TestQueryBatch(search_server, dictionary, generator);
+        TestQueryExecutor(search_server, queries);
+        vector<int> expired_ids;
+        for (size_t i = 0; i < documents.size(); i += 2) {
+            expired_ids.push_back(static_cast<int>(i));
+        }
+        {
+            LOG_DURATION("remove documents"sv);
+            search_server.RemoveDocuments(execution::par, expired_ids);
+        }
+    }
+    {
+        SearchServer search_server(dictionary[0], IndexLayout::COMPRESSED);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL,
+                                      {1, 2, 3});
+        }
+        PrintIndexStatistics("compressed"sv, search_server);
+        TEST(seq);
+        TEST(par);
+        search_server.SetRetrievalEngine(RetrievalEngine::WAND);
+        Test("wand"sv, search_server, queries, execution::seq);
+    }
 }
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+// Списки вхождений делятся на блоки, для каждого из которых известна
+// максимальная частота слова (используется при отсечении в WAND)
+constexpr const size_t POSTING_BLOCK_SIZE = 128;
+
+struct Posting {
+    int document_id;
+    double term_freq;
+};
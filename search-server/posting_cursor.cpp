@@ -0,0 +1,143 @@
+#include "posting_cursor.h"
+
+#include <algorithm>
+
+using namespace std;
+
+PostingCursor::PostingCursor() { LoadBlock(0); }
+
+PostingCursor::PostingCursor(const InvertedIndex& index, TermId term_id) {
+    Reset(index, term_id);
+}
+
+void PostingCursor::Reset(const InvertedIndex& index, TermId term_id) {
+    index.GetPostingListParts(term_id, parts_);
+    part_block_begins_.clear();
+    part_block_begins_.reserve(parts_.size() + 1);
+    part_block_begins_.push_back(0);
+    for (const PostingListPart& part : parts_) {
+        const size_t part_block_count =
+            part.compressed != nullptr
+                ? part.compressed->GetBlockCount()
+                : (part.size + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE;
+        part_block_begins_.push_back(part_block_begins_.back() +
+                                     part_block_count);
+    }
+    block_count_ = part_block_begins_.back();
+    shallow_block_ = 0;
+    max_term_freq_ = -1.0;
+
+    LoadBlock(0);
+}
+
+int PostingCursor::DocumentId() const {
+    return current_ == block_end_ ? END : current_->document_id;
+}
+
+double PostingCursor::TermFreq() const { return current_->term_freq; }
+
+void PostingCursor::Next() {
+    if (current_ == block_end_) {
+        return;
+    }
+
+    ++current_;
+    if (current_ == block_end_ && block_ < block_count_) {
+        LoadBlock(block_ + 1);
+    }
+}
+
+void PostingCursor::NextGeq(int document_id) {
+    if (DocumentId() >= document_id) {
+        return;
+    }
+
+    size_t block = block_;
+    while (block < block_count_ && GetLastDocumentId(block) < document_id) {
+        ++block;
+    }
+    if (block != block_) {
+        LoadBlock(block);
+    }
+    current_ = lower_bound(current_, block_end_, document_id,
+                           [](const Posting& posting, int id) {
+                               return posting.document_id < id;
+                           });
+}
+
+double PostingCursor::GetMaxTermFreq() {
+    if (max_term_freq_ < 0.0) {
+        max_term_freq_ = 0.0;
+        for (size_t block = 0; block < block_count_; ++block) {
+            max_term_freq_ = max(max_term_freq_, GetMaxTermFreq(block));
+        }
+    }
+
+    return max_term_freq_;
+}
+
+void PostingCursor::ShallowNextGeq(int document_id) {
+    shallow_block_ = max(shallow_block_, block_);
+    while (shallow_block_ < block_count_ &&
+           GetLastDocumentId(shallow_block_) < document_id) {
+        ++shallow_block_;
+    }
+}
+
+double PostingCursor::GetBlockMaxTermFreq() const {
+    return shallow_block_ < block_count_ ? GetMaxTermFreq(shallow_block_)
+                                         : 0.0;
+}
+
+int PostingCursor::GetBlockLastDocumentId() const {
+    return shallow_block_ < block_count_ ? GetLastDocumentId(shallow_block_)
+                                         : END;
+}
+
+pair<const PostingListPart*, size_t> PostingCursor::LocateBlock(
+    size_t block) const {
+    const size_t part =
+        upper_bound(part_block_begins_.begin(), part_block_begins_.end(),
+                    block) -
+        part_block_begins_.begin() - 1;
+    return {&parts_[part], block - part_block_begins_[part]};
+}
+
+int PostingCursor::GetLastDocumentId(size_t block) const {
+    const auto [part, part_block] = LocateBlock(block);
+    if (part->compressed != nullptr) {
+        return part->compressed->GetBlockLastDocumentId(part_block);
+    }
+
+    return part
+        ->postings[min(part->size, (part_block + 1) * POSTING_BLOCK_SIZE) - 1]
+        .document_id;
+}
+
+double PostingCursor::GetMaxTermFreq(size_t block) const {
+    const auto [part, part_block] = LocateBlock(block);
+    if (part->compressed != nullptr) {
+        return part->compressed->GetBlockMaxTermFreq(part_block);
+    }
+
+    return part->block_max_term_freqs[part_block];
+}
+
+void PostingCursor::LoadBlock(size_t block) {
+    block_ = block;
+    if (block_ >= block_count_) {
+        current_ = block_end_ = buffer_;
+        return;
+    }
+
+    const auto [part, part_block] = LocateBlock(block_);
+    if (part->compressed != nullptr) {
+        const size_t count = part->compressed->DecodeBlock(part_block, buffer_);
+        current_ = buffer_;
+        block_end_ = buffer_ + count;
+    } else {
+        current_ = part->postings + part_block * POSTING_BLOCK_SIZE;
+        block_end_ = part->postings +
+                     min(part->size, (part_block + 1) * POSTING_BLOCK_SIZE);
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "inverted_index.h"
+#include "posting.h"
+
+/**
+ * Курсор по списку вхождений слова для обхода "документ за документом".
+ *
+ * Умеет перескакивать к первому документу с id не меньше заданного
+ * (NextGeq) и, не распаковывая блоки, сообщать верхнюю границу частоты
+ * слова в блоке, содержащем заданный id (ShallowNextGeq, GetBlockMaxTermFreq).
+ * Блоки всех частей списка (сегментов индекса и буфера записи) нумеруются
+ * подряд, поэтому для алгоритмов обхода список выглядит единым.
+ * Курсор действителен, пока индекс не изменяется.
+ */
+class PostingCursor {
+   public:
+    static constexpr const int END = std::numeric_limits<int>::max();
+
+    // Пустой курсор; DocumentId() == END
+    PostingCursor();
+
+    PostingCursor(const InvertedIndex& index, TermId term_id);
+
+    // Курсор может указывать на собственный буфер распакованного блока
+    PostingCursor(const PostingCursor&) = delete;
+    PostingCursor& operator=(const PostingCursor&) = delete;
+
+    int DocumentId() const;
+
+    double TermFreq() const;
+
+    void Next();
+
+    void NextGeq(int document_id);
+
+    // Граница частоты по всему списку; вычисляется при первом обращении
+    double GetMaxTermFreq();
+
+    void ShallowNextGeq(int document_id);
+
+    // Граница частоты и последний id блока, выбранного ShallowNextGeq
+    double GetBlockMaxTermFreq() const;
+
+    int GetBlockLastDocumentId() const;
+
+    // Переводит курсор на начало списка другого слова, переиспользуя
+    // память курсора
+    void Reset(const InvertedIndex& index, TermId term_id);
+
+   private:
+    std::vector<PostingListPart> parts_;
+    // номер первого блока каждой части; последний элемент - число блоков
+    std::vector<size_t> part_block_begins_;
+    size_t block_count_ = 0;
+    size_t block_ = 0;
+    size_t shallow_block_ = 0;
+    const Posting* current_ = nullptr;
+    const Posting* block_end_ = nullptr;
+    double max_term_freq_ = -1.0;
+    Posting buffer_[POSTING_BLOCK_SIZE];
+
+    // Часть, содержащая блок, и номер блока внутри нее
+    std::pair<const PostingListPart*, size_t> LocateBlock(size_t block) const;
+
+    int GetLastDocumentId(size_t block) const;
+
+    double GetMaxTermFreq(size_t block) const;
+
+    void LoadBlock(size_t block);
+};
@@ -19,6 +19,21 @@ std::vector<SearchResult> ProcessQueries(
     return search_results;
 }
 
+std::vector<SearchResult> ProcessQueries(
+    const SearchServer& search_server, const std::vector<std::string>& queries,
+    QueryExecutor& executor) {
+    std::vector<SearchResult> search_results;
+    executor.Process(search_server, queries, search_results);
+
+    return search_results;
+}
+
+std::vector<SearchResult> ProcessQueriesBatch(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries) {
+    return search_server.FindTopDocumentsBatch(std::execution::par, queries);
+}
+
 std::deque<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
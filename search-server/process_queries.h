@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "document.h"
+#include "query_executor.h"
 #include "search_server.h"
 
 typedef std::vector<Document> SearchResult;
@@ -12,5 +13,17 @@ typedef std::vector<Document> SearchResult;
 std::vector<SearchResult> ProcessQueries(
     const SearchServer& search_server, const std::vector<std::string>& queries);
 
+// Запросы выполняются пулом executor; каждый поток пула переиспользует
+// свои буферы поиска
+std::vector<SearchResult> ProcessQueries(
+    const SearchServer& search_server, const std::vector<std::string>& queries,
+    QueryExecutor& executor);
+
+// Результаты те же, что у ProcessQueries, но запросы выполняются одним
+// пакетом SearchServer::FindTopDocumentsBatch: выгодно, когда запросы
+// пакета часто содержат одни и те же слова
+std::vector<SearchResult> ProcessQueriesBatch(
+    const SearchServer& search_server, const std::vector<std::string>& queries);
+
 std::deque<Document> ProcessQueriesJoined(
     const SearchServer& search_server, const std::vector<std::string>& queries);
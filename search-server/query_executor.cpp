@@ -0,0 +1,201 @@
+#include "query_executor.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "allocation_counter.h"
+
+using namespace std;
+
+namespace {
+
+uint64_t PackRange(uint32_t begin, uint32_t end) {
+    return (static_cast<uint64_t>(begin) << 32) | end;
+}
+
+uint32_t GetRangeBegin(uint64_t range) {
+    return static_cast<uint32_t>(range >> 32);
+}
+
+uint32_t GetRangeEnd(uint64_t range) { return static_cast<uint32_t>(range); }
+
+}  // namespace
+
+QueryExecutor::QueryExecutor(size_t thread_count, bool pin_threads)
+    : pin_threads_(pin_threads) {
+    if (thread_count == 0) {
+        thread_count = max(1u, thread::hardware_concurrency());
+    }
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.push_back(make_unique<Worker>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_[i]->thread = thread([this, i] { RunWorker(i); });
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    batch_started_.notify_all();
+    for (const unique_ptr<Worker>& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+void QueryExecutor::Process(const SearchServer& search_server,
+                            const vector<string>& queries,
+                            vector<vector<Document>>& results) {
+    using namespace string_literals;
+    if (queries.size() > UINT32_MAX) {
+        throw invalid_argument("Too many queries in a batch"s);
+    }
+    results.resize(queries.size());
+    if (queries.empty()) {
+        return;
+    }
+
+    unique_lock lock(mutex_);
+    // поток, проснувшийся после конца прошлого пакета, еще может
+    // просматривать диапазоны
+    batch_finished_.wait(lock, [this] { return active_worker_count_ == 0; });
+    search_server_ = &search_server;
+    queries_ = &queries;
+    results_ = &results;
+    exception_ = nullptr;
+    remaining_query_count_.store(queries.size());
+    const size_t query_count = queries.size();
+    const size_t worker_count = workers_.size();
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers_[i]->range.store(
+            PackRange(static_cast<uint32_t>(query_count * i / worker_count),
+                      static_cast<uint32_t>(query_count * (i + 1) /
+                                            worker_count)));
+    }
+    ++batch_generation_;
+    batch_started_.notify_all();
+
+    batch_finished_.wait(lock, [this] {
+        return remaining_query_count_.load() == 0 && active_worker_count_ == 0;
+    });
+    search_server_ = nullptr;
+    queries_ = nullptr;
+    results_ = nullptr;
+    if (exception_) {
+        rethrow_exception(exception_);
+    }
+}
+
+size_t QueryExecutor::GetThreadCount() const { return workers_.size(); }
+
+QueryExecutorStatistics QueryExecutor::GetStatistics() const {
+    QueryExecutorStatistics statistics;
+    for (const unique_ptr<Worker>& worker : workers_) {
+        statistics.query_count += worker->statistics.query_count;
+        statistics.steal_count += worker->statistics.steal_count;
+        statistics.allocation_count += worker->statistics.allocation_count;
+    }
+    return statistics;
+}
+
+void QueryExecutor::RunWorker(size_t index) {
+    if (pin_threads_) {
+        // привязка только ускоряет работу, поэтому ее ошибка не мешает
+        // выполнять запросы
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % max(1u, thread::hardware_concurrency()), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+
+    uint64_t seen_generation = 0;
+    while (true) {
+        {
+            unique_lock lock(mutex_);
+            batch_started_.wait(lock, [&] {
+                return stopping_ || batch_generation_ != seen_generation;
+            });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = batch_generation_;
+            ++active_worker_count_;
+        }
+
+        ExecuteBatch(index);
+
+        {
+            lock_guard lock(mutex_);
+            --active_worker_count_;
+        }
+        batch_finished_.notify_all();
+    }
+}
+
+void QueryExecutor::ExecuteBatch(size_t index) {
+    Worker& worker = *workers_[index];
+    uint32_t query = 0;
+    while (true) {
+        if (!TakeQuery(worker, query)) {
+            if (!StealQueries(index)) {
+                return;
+            }
+            continue;
+        }
+        const size_t allocation_count = GetThreadAllocationCount();
+        try {
+            search_server_->FindTopDocuments(
+                worker.scratch, (*queries_)[query], DocumentStatus::ACTUAL, {},
+                (*results_)[query]);
+        } catch (...) {
+            lock_guard lock(mutex_);
+            if (!exception_) {
+                exception_ = current_exception();
+            }
+        }
+        worker.statistics.allocation_count +=
+            GetThreadAllocationCount() - allocation_count;
+        ++worker.statistics.query_count;
+        remaining_query_count_.fetch_sub(1);
+    }
+}
+
+bool QueryExecutor::TakeQuery(Worker& worker, uint32_t& query) {
+    uint64_t range = worker.range.load();
+    while (GetRangeBegin(range) < GetRangeEnd(range)) {
+        if (worker.range.compare_exchange_weak(
+                range,
+                PackRange(GetRangeBegin(range) + 1, GetRangeEnd(range)))) {
+            query = GetRangeBegin(range);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool QueryExecutor::StealQueries(size_t index) {
+    const size_t worker_count = workers_.size();
+    for (size_t i = 1; i < worker_count; ++i) {
+        Worker& victim = *workers_[(index + i) % worker_count];
+        uint64_t range = victim.range.load();
+        while (GetRangeBegin(range) < GetRangeEnd(range)) {
+            const uint32_t begin = GetRangeBegin(range);
+            const uint32_t end = GetRangeEnd(range);
+            const uint32_t middle = end - (end - begin + 1) / 2;
+            if (victim.range.compare_exchange_weak(range,
+                                                   PackRange(begin, middle))) {
+                // свой диапазон пуст, и другие потоки не могут его изменить
+                workers_[index]->range.store(PackRange(middle, end));
+                ++workers_[index]->statistics.steal_count;
+                return true;
+            }
+        }
+    }
+    return false;
+}
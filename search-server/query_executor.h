@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+struct QueryExecutorStatistics {
+    size_t query_count = 0;
+    // диапазоны запросов, взятые потоками друг у друга
+    size_t steal_count = 0;
+    // выделения памяти в рабочих потоках во время выполнения запросов;
+    // считаются, только если ALLOCATION_COUNTING_ENABLED
+    size_t allocation_count = 0;
+};
+
+// Пул потоков для пакетов запросов: поток выполняет свой диапазон
+// запросов, а затем забирает половину чужого. Буферы переиспользуются,
+// поэтому после первых пакетов запросы не выделяют память.
+class QueryExecutor {
+   public:
+    // thread_count = 0 - по числу ядер. Если pin_threads, поток i
+    // привязывается к ядру i по модулю числа ядер.
+    explicit QueryExecutor(size_t thread_count = 0, bool pin_threads = false);
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    ~QueryExecutor();
+
+    // Результаты как у SearchServer::FindTopDocuments(query); исключение
+    // некорректного запроса выбрасывается после выполнения остальных.
+    void Process(const SearchServer& search_server,
+                 const std::vector<std::string>& queries,
+                 std::vector<std::vector<Document>>& results);
+
+    size_t GetThreadCount() const;
+
+    // Нельзя вызывать одновременно с Process
+    QueryExecutorStatistics GetStatistics() const;
+
+   private:
+    struct Worker {
+        // начало (старшие 32 бита) и конец невыполненного диапазона
+        std::atomic<uint64_t> range{0};
+        SearchServer::QueryScratch scratch;
+        QueryExecutorStatistics statistics;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    bool pin_threads_;
+
+    std::mutex mutex_;
+    std::condition_variable batch_started_;
+    std::condition_variable batch_finished_;
+    uint64_t batch_generation_ = 0;
+    size_t active_worker_count_ = 0;
+    bool stopping_ = false;
+
+    // пакет, выполняемый сейчас
+    const SearchServer* search_server_ = nullptr;
+    const std::vector<std::string>* queries_ = nullptr;
+    std::vector<std::vector<Document>>* results_ = nullptr;
+    std::atomic<size_t> remaining_query_count_{0};
+    std::exception_ptr exception_;
+
+    void RunWorker(size_t index);
+
+    void ExecuteBatch(size_t index);
+
+    // Берет запрос из начала своего диапазона; false, если он пуст
+    bool TakeQuery(Worker& worker, uint32_t& query);
+
+    // Переносит в свой диапазон половину чужого; false, если работы нет
+    bool StealQueries(size_t index);
+};
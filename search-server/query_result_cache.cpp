@@ -0,0 +1,109 @@
+#include "query_result_cache.h"
+
+#include <functional>
+#include <stdexcept>
+
+using namespace std;
+
+double QueryCacheStatistics::GetHitRate() const {
+    const size_t lookup_count = hit_count + miss_count;
+    return lookup_count == 0 ? 0.0
+                             : static_cast<double>(hit_count) / lookup_count;
+}
+
+QueryResultCache::QueryResultCache(size_t capacity)
+    : shards_(make_unique<Shard[]>(QUERY_CACHE_SHARD_COUNT)),
+      capacity_(capacity),
+      shard_capacity_((capacity + QUERY_CACHE_SHARD_COUNT - 1) /
+                      QUERY_CACHE_SHARD_COUNT) {
+    using namespace string_literals;
+    if (capacity == 0) {
+        throw invalid_argument("Query cache capacity must be positive"s);
+    }
+}
+
+optional<vector<Document>> QueryResultCache::Find(const string& key,
+                                                  uint64_t generation) {
+    Shard& shard = GetShard(key);
+    lock_guard lock(shard.mutex);
+    const auto it = shard.positions.find(key);
+    if (it == shard.positions.end()) {
+        ++shard.miss_count;
+        return nullopt;
+    }
+    if (it->second->generation != generation) {
+        Erase(shard, it->second);
+        ++shard.invalidation_count;
+        ++shard.miss_count;
+        return nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    ++shard.hit_count;
+    return shard.entries.front().documents;
+}
+
+void QueryResultCache::Insert(string key, uint64_t generation,
+                              vector<Document> documents) {
+    Shard& shard = GetShard(key);
+    lock_guard lock(shard.mutex);
+    // запрос мог быть вычислен одновременно в нескольких потоках
+    if (const auto it = shard.positions.find(key);
+        it != shard.positions.end()) {
+        Erase(shard, it->second);
+    }
+
+    shard.entries.push_front({move(key), generation, move(documents)});
+    shard.positions.emplace(shard.entries.front().key, shard.entries.begin());
+    shard.memory_bytes += ComputeEntryMemory(shard.entries.front());
+    while (shard.entries.size() > shard_capacity_) {
+        Erase(shard, prev(shard.entries.end()));
+        ++shard.eviction_count;
+    }
+}
+
+void QueryResultCache::Clear() {
+    for (size_t i = 0; i < QUERY_CACHE_SHARD_COUNT; ++i) {
+        Shard& shard = shards_[i];
+        lock_guard lock(shard.mutex);
+        shard.invalidation_count += shard.entries.size();
+        shard.positions.clear();
+        shard.entries.clear();
+        shard.memory_bytes = 0;
+    }
+}
+
+size_t QueryResultCache::GetCapacity() const { return capacity_; }
+
+QueryCacheStatistics QueryResultCache::GetStatistics() const {
+    QueryCacheStatistics statistics;
+    for (size_t i = 0; i < QUERY_CACHE_SHARD_COUNT; ++i) {
+        const Shard& shard = shards_[i];
+        lock_guard lock(shard.mutex);
+        statistics.hit_count += shard.hit_count;
+        statistics.miss_count += shard.miss_count;
+        statistics.eviction_count += shard.eviction_count;
+        statistics.invalidation_count += shard.invalidation_count;
+        statistics.entry_count += shard.entries.size();
+        statistics.memory_bytes += shard.memory_bytes;
+    }
+    return statistics;
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(const string& key) const {
+    return shards_[hash<string>{}(key) % QUERY_CACHE_SHARD_COUNT];
+}
+
+void QueryResultCache::Erase(Shard& shard, list<Entry>::iterator position) {
+    shard.memory_bytes -= ComputeEntryMemory(*position);
+    shard.positions.erase(position->key);
+    shard.entries.erase(position);
+}
+
+size_t QueryResultCache::ComputeEntryMemory(const Entry& entry) {
+    // узел списка - два указателя, узел таблицы - ключ, итератор и
+    // указатель на следующий узел
+    return sizeof(Entry) + 2 * sizeof(void*) + entry.key.capacity() +
+           entry.documents.capacity() * sizeof(Document) +
+           sizeof(pair<const string_view, list<Entry>::iterator>) +
+           sizeof(void*);
+}
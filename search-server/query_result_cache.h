@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+
+// Число независимых частей QueryResultCache со своими блокировками
+constexpr const size_t QUERY_CACHE_SHARD_COUNT = 16;
+
+struct QueryCacheStatistics {
+    size_t hit_count = 0;
+    size_t miss_count = 0;
+    // записи, вытесненные при переполнении
+    size_t eviction_count = 0;
+    // записи, отброшенные из-за изменения индекса
+    size_t invalidation_count = 0;
+    size_t entry_count = 0;
+    // оценка памяти, занятой ключами, результатами и служебными данными
+    size_t memory_bytes = 0;
+
+    double GetHitRate() const;
+};
+
+/**
+ * Кэш результатов поиска с вытеснением давно не использованных (LRU).
+ *
+ * Ключ - нормализованный запрос (см. SearchServer), значение - найденные
+ * документы и поколение индекса, на котором они найдены. Запись
+ * с поколением, отличным от текущего, считается промахом и удаляется,
+ * поэтому изменение индекса не требует обхода кэша. Ключи распределены
+ * по QUERY_CACHE_SHARD_COUNT частям, у каждой своя блокировка и свой
+ * список LRU, так что параллельные запросы почти не ждут друг друга.
+ */
+class QueryResultCache {
+   public:
+    // Емкость - общее число записей во всех частях
+    explicit QueryResultCache(size_t capacity);
+
+    std::optional<std::vector<Document>> Find(const std::string& key,
+                                              uint64_t generation);
+
+    void Insert(std::string key, uint64_t generation,
+                std::vector<Document> documents);
+
+    void Clear();
+
+    size_t GetCapacity() const;
+
+    QueryCacheStatistics GetStatistics() const;
+
+   private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        // от недавно использованных к давно не использованным
+        std::list<Entry> entries;
+        // ключи ссылаются на строки в entries
+        std::unordered_map<std::string_view, std::list<Entry>::iterator>
+            positions;
+        size_t memory_bytes = 0;
+        size_t hit_count = 0;
+        size_t miss_count = 0;
+        size_t eviction_count = 0;
+        size_t invalidation_count = 0;
+    };
+
+    std::unique_ptr<Shard[]> shards_;
+    size_t capacity_;
+    size_t shard_capacity_;
+
+    Shard& GetShard(const std::string& key) const;
+
+    // Удаляет запись из части; блокировка части должна быть захвачена
+    static void Erase(Shard& shard, std::list<Entry>::iterator position);
+
+    static size_t ComputeEntryMemory(const Entry& entry);
+};
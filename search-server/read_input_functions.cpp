@@ -1,33 +1,252 @@
 #include "read_input_functions.h"
 
-std::string ReadLine() {
-    std::string s;
-    std::getline(std::cin, s);
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <execution>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+
+std::string_view ReadRequiredLine(InputReader& input) {
+    using namespace std::string_literals;
+    const std::optional<std::string_view> line = input.ReadLine();
+    if (!line) {
+        throw std::invalid_argument("Unexpected end of input"s);
+    }
+    return *line;
+}
+
+// Пробельные символы, которые пропускает operator>>; '\n' разделяет строки
+constexpr const std::string_view INPUT_WHITESPACE = " \t\v\f\r";
 
-    return s;
+// Читает число, пропуская перед ним пробельные символы и пустые строки,
+// как operator>>. line - непрочитанная часть текущей строки.
+int ParseNumber(InputReader& input, std::string_view& line) {
+    using namespace std::string_literals;
+    while (true) {
+        line.remove_prefix(
+            std::min(line.size(), line.find_first_not_of(INPUT_WHITESPACE)));
+        if (!line.empty()) {
+            break;
+        }
+        line = ReadRequiredLine(input);
+    }
+    // std::from_chars не принимает знак '+'
+    if (line.size() > 1 && line[0] == '+' && line[1] != '-') {
+        line.remove_prefix(1);
+    }
+    int value = 0;
+    const auto [number_end, error] =
+        std::from_chars(line.data(), line.data() + line.size(), value);
+    line.remove_prefix(number_end - line.data());
+    if (error != std::errc() ||
+        (!line.empty() &&
+         INPUT_WHITESPACE.find(line.front()) == std::string_view::npos)) {
+        throw std::invalid_argument("Invalid number"s);
+    }
+    return value;
+}
+
+}  // namespace
+
+InputReader::InputReader(int file, size_t buffer_size)
+    : file_(file), buffer_(std::max<size_t>(buffer_size, 1)) {
+    begin_ = end_ = scanned_ = buffer_.data();
+}
+
+InputReader::InputReader(const std::string& path) {
+    using namespace std::string_literals;
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) != 0) {
+        throw std::system_error(errno, std::generic_category(),
+                                "Cannot open "s + path);
+    }
+    // пустой файл нельзя отобразить в память
+    if (file_stat.st_size == 0) {
+        begin_ = end_ = scanned_ = "";
+        return;
+    }
+
+    mapped_file_ = std::make_unique<MappedFile>(path);
+    begin_ = scanned_ = mapped_file_->GetData();
+    end_ = begin_ + mapped_file_->GetSize();
+}
+
+std::optional<std::string_view> InputReader::ReadLine() {
+    const char* newline = nullptr;
+    while (true) {
+        newline = static_cast<const char*>(
+            std::memchr(scanned_, '\n', end_ - scanned_));
+        if (newline != nullptr) {
+            break;
+        }
+        scanned_ = end_;
+        if (!Fill()) {
+            break;
+        }
+    }
+    if (newline == nullptr && begin_ == end_) {
+        return std::nullopt;
+    }
+
+    // последняя строка может не заканчиваться '\n'
+    const char* line_end = newline != nullptr ? newline : end_;
+    std::string_view line(begin_, line_end - begin_);
+    begin_ = scanned_ = newline != nullptr ? newline + 1 : end_;
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+int InputReader::ReadNumber() {
+    using namespace std::string_literals;
+    std::string_view line;
+    const int number = ParseNumber(*this, line);
+    if (line.find_first_not_of(INPUT_WHITESPACE) != std::string_view::npos) {
+        throw std::invalid_argument("Invalid number"s);
+    }
+    return number;
+}
+
+void InputReader::ReadNumbers(std::vector<int>& numbers) {
+    using namespace std::string_literals;
+    std::string_view line;
+    const int count = ParseNumber(*this, line);
+    if (count < 0) {
+        throw std::invalid_argument("Invalid number count"s);
+    }
+    numbers.clear();
+    for (int i = 0; i < count; ++i) {
+        numbers.push_back(ParseNumber(*this, line));
+    }
+    if (line.find_first_not_of(INPUT_WHITESPACE) != std::string_view::npos) {
+        throw std::invalid_argument("Too many numbers"s);
+    }
+}
+
+bool InputReader::Fill() {
+    using namespace std::string_literals;
+    if (mapped_file_ || end_of_file_ || file_ < 0) {
+        return false;
+    }
+
+    // непрочитанные данные переносятся в начало буфера; буфер растет,
+    // только если строка длиннее него
+    const size_t offset = begin_ - buffer_.data();
+    const size_t size = end_ - begin_;
+    const size_t scanned_size = scanned_ - begin_;
+    if (size == buffer_.size()) {
+        buffer_.resize(buffer_.size() * 2);
+    }
+    std::memmove(buffer_.data(), buffer_.data() + offset, size);
+    begin_ = buffer_.data();
+    end_ = begin_ + size;
+    scanned_ = begin_ + scanned_size;
+
+    while (true) {
+        const ssize_t result =
+            read(file_, buffer_.data() + size, buffer_.size() - size);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            throw std::system_error(errno, std::generic_category(),
+                                    "Cannot read input"s);
+        }
+        if (result == 0) {
+            end_of_file_ = true;
+            return false;
+        }
+        end_ += result;
+        return true;
+    }
+}
+
+InputReader& GetStandardInput() {
+    static InputReader input;
+    return input;
+}
+
+std::string ReadLine() {
+    const std::optional<std::string_view> line = GetStandardInput().ReadLine();
+    return line ? std::string(*line) : std::string();
 }
 
 std::vector<int> ReadIntVector() {
     std::vector<int> vec;
-    int element_count;
+    GetStandardInput().ReadNumbers(vec);
+
+    return vec;
+}
 
-    std::cin >> element_count;
-    vec.reserve(element_count);
+int ReadLineWithNumber() { return GetStandardInput().ReadNumber(); }
 
-    int el;
-    for (int i = 0; i < element_count; ++i) {
-        std::cin >> el;
-        vec.push_back(el);
+IngestionStatistics LoadDocuments(InputReader& input, SearchServer& server,
+                                  int first_document_id) {
+    using namespace std::string_literals;
+    const auto start_time = std::chrono::steady_clock::now();
+    const int document_count = input.ReadNumber();
+    if (document_count < 0) {
+        throw std::invalid_argument("Invalid document count"s);
     }
-    ReadLine();
 
-    return vec;
+    // буферы пакета переиспользуются, поэтому после первого пакета
+    // чтение документов почти не выделяет память
+    IngestionStatistics statistics;
+    std::vector<NewDocument> documents;
+    std::string texts;
+    std::vector<size_t> text_ends;
+    for (int first = 0; first < document_count;
+         first += static_cast<int>(documents.size())) {
+        documents.resize(std::min(INPUT_DOCUMENT_BATCH_SIZE,
+                                  static_cast<size_t>(document_count - first)));
+        texts.clear();
+        text_ends.clear();
+        for (size_t i = 0; i < documents.size(); ++i) {
+            texts.append(ReadRequiredLine(input));
+            text_ends.push_back(texts.size());
+            input.ReadNumbers(documents[i].ratings);
+            documents[i].id = first_document_id + first + static_cast<int>(i);
+            documents[i].status = DocumentStatus::ACTUAL;
+        }
+        size_t text_begin = 0;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            documents[i].text = std::string_view(texts).substr(
+                text_begin, text_ends[i] - text_begin);
+            text_begin = text_ends[i];
+        }
+
+        const IngestionStatistics batch_statistics =
+            server.AddDocuments(std::execution::par, documents);
+        statistics.document_count += batch_statistics.document_count;
+        statistics.byte_count += batch_statistics.byte_count;
+    }
+
+    statistics.seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start_time)
+                             .count();
+    return statistics;
 }
 
-int ReadLineWithNumber() {
-    int result = 0;
-    std::cin >> result;
-    ReadLine();
+std::vector<std::string> ReadQueries(InputReader& input) {
+    using namespace std::string_literals;
+    const int query_count = input.ReadNumber();
+    if (query_count < 0) {
+        throw std::invalid_argument("Invalid query count"s);
+    }
 
-    return result;
+    std::vector<std::string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.emplace_back(ReadRequiredLine(input));
+    }
+    return queries;
 }
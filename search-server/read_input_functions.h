@@ -1,10 +1,73 @@
 #pragma once
 
-#include <iostream>
+#include <unistd.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "index_snapshot.h"
+#include "search_server.h"
+
+// Размер буфера InputReader при чтении потока
+constexpr const size_t INPUT_BUFFER_SIZE = 1024 * 1024;
+
+// Число документов в пакете SearchServer::AddDocuments при LoadDocuments
+constexpr const size_t INPUT_DOCUMENT_BATCH_SIZE = 4096;
+
+// Построчное чтение ввода без iostream. Строки выдаются как string_view
+// на буфер потока или отображенный файл и не выделяют память.
+class InputReader {
+   public:
+    // Дескриптор file не закрывается
+    explicit InputReader(int file = STDIN_FILENO,
+                         size_t buffer_size = INPUT_BUFFER_SIZE);
+
+    explicit InputReader(const std::string& path);
+
+    // Строка без завершающих '\n' и '\r'; nullopt в конце ввода
+    std::optional<std::string_view> ReadLine();
+
+    // Числа разделяются пробельными символами и переводами строк, как
+    // для operator>>, но остаток строки после последнего числа должен
+    // быть пустым, а число - отделено от следующих символов пробелом.
+    int ReadNumber();
+
+    // Число элементов и сами элементы; numbers заменяется ими
+    void ReadNumbers(std::vector<int>& numbers);
+
+   private:
+    int file_ = -1;
+    std::unique_ptr<MappedFile> mapped_file_;
+    std::vector<char> buffer_;
+    // непрочитанные данные
+    const char* begin_ = nullptr;
+    const char* end_ = nullptr;
+    // начало непросмотренной в поисках '\n' части
+    const char* scanned_ = nullptr;
+    bool end_of_file_ = false;
+
+    // Дочитывает поток в буфер; false, если данных больше нет
+    bool Fill();
+};
+
+// Стандартный ввод, общий для ReadLine, ReadIntVector и ReadLineWithNumber
+InputReader& GetStandardInput();
+
 std::string ReadLine();
 
 std::vector<int> ReadIntVector();
 
 int ReadLineWithNumber();
+
+// Читает число документов и для каждого строку текста и рейтинги
+// в формате ReadNumbers. Документы получают id подряд, начиная
+// с first_document_id, и добавляются пакетами через
+// AddDocuments(execution::par).
+IngestionStatistics LoadDocuments(InputReader& input, SearchServer& server,
+                                  int first_document_id = 0);
+
+// Читает число запросов и сами запросы, по одному в строке
+std::vector<std::string> ReadQueries(InputReader& input);
@@ -1,7 +1,10 @@
 #include "search_server.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstring>
 #include <execution>
 #include <numeric>
 #include <string_view>
@@ -10,17 +13,77 @@
 
 using namespace std;
 
-SearchServer::SearchServer(const string& stop_words_str)
-    : SearchServer(SplitIntoWords(stop_words_str)) {}
+namespace {
 
-SearchServer::SearchServer(const string_view stop_words_sv)
-    : SearchServer(SplitIntoWords(stop_words_sv)) {}
+// Поколения индексов всех серверов различны, поэтому по поколению
+// подготовленного запроса видно, к какому состоянию какого сервера
+// относятся его термины
+uint64_t NextIndexVersion() {
+    static atomic<uint64_t> index_version = 0;
+    return ++index_version;
+}
+
+}  // namespace
+
+double IngestionStatistics::GetDocumentsPerSecond() const {
+    return seconds > 0.0 ? document_count / seconds : 0.0;
+}
+
+double IngestionStatistics::GetMegabytesPerSecond() const {
+    return seconds > 0.0 ? byte_count / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+double CorpusStatistics::ComputeInverseDocumentFreq(
+    const string_view word) const {
+    const auto it = document_freqs.find(word);
+    const size_t document_freq = it == document_freqs.end() ? 0 : it->second;
+    const double log_document_count =
+        document_count == 0 ? 0.0 : log(static_cast<double>(document_count));
+    return document_freq == 0
+               ? log_document_count
+               : log_document_count - log(static_cast<double>(document_freq));
+}
+
+SearchServer::SearchServer(const string& stop_words_str, IndexLayout layout)
+    : SearchServer(SplitIntoWords(stop_words_str), layout) {}
+
+SearchServer::SearchServer(const string_view stop_words_sv, IndexLayout layout)
+    : SearchServer(SplitIntoWords(stop_words_sv), layout) {}
 
 set<int>::iterator SearchServer::begin() const { return document_ids_.begin(); }
 
 set<int>::iterator SearchServer::end() const { return document_ids_.end(); }
 
-size_t SearchServer::GetDocumentCount() const { return documents_data_.size(); }
+size_t SearchServer::GetDocumentCount() const {
+    return document_ordinals_.size();
+}
+
+IndexStatistics SearchServer::GetIndexStatistics() const {
+    IndexStatistics statistics = index_.GetStatistics();
+    statistics.texts_bytes = texts_.GetMemoryUsage();
+    return statistics;
+}
+
+void SearchServer::SetRetrievalEngine(RetrievalEngine engine) {
+    retrieval_engine_ = engine;
+}
+
+void SearchServer::BuildImpactIndex() {
+    impact_index_.Build(index_, log_document_count_);
+    impact_index_version_ = index_version_;
+}
+
+void SearchServer::SetQueryCacheCapacity(size_t capacity) {
+    query_cache_ =
+        capacity == 0 ? nullptr : make_unique<QueryResultCache>(capacity);
+}
+
+QueryCacheStatistics SearchServer::GetQueryCacheStatistics() const {
+    return query_cache_ ? query_cache_->GetStatistics()
+                        : QueryCacheStatistics{};
+}
+
+uint64_t SearchServer::GetIndexVersion() const { return index_version_; }
 
 const map<string_view, double>& SearchServer::GetWordFrequencies(
     int document_id) const {
@@ -28,8 +91,22 @@ const map<string_view, double>& SearchServer::GetWordFrequencies(
         static map<string_view, double> dummy_empty_map;
         return dummy_empty_map;
     }
+    if (const auto it = document_to_word_freqs_.find(document_id);
+        it != document_to_word_freqs_.end()) {
+        return it->second;
+    }
 
-    return document_to_word_freqs_.at(document_id);
+    // словарь документа снимка строится при первом обращении
+    lock_guard lock(*snapshot_word_freq_maps_mutex_);
+    if (const auto it = snapshot_word_freq_maps_.find(document_id);
+        it != snapshot_word_freq_maps_.end()) {
+        return it->second;
+    }
+    map<string_view, double> word_freqs;
+    ForEachWordFreq(document_id, [&](string_view word, double term_freq) {
+        word_freqs.emplace_hint(word_freqs.end(), word, term_freq);
+    });
+    return snapshot_word_freq_maps_[document_id] = move(word_freqs);
 }
 
 void SearchServer::AddDocument(int document_id, const string_view document_text,
@@ -38,41 +115,391 @@ void SearchServer::AddDocument(int document_id, const string_view document_text,
     if (document_id < 0) {
         throw invalid_argument("Id can take only none-negative values"s);
     }
-    if (documents_data_.count(document_id) != 0) {
+    if (document_ordinals_.count(document_id) != 0) {
         throw invalid_argument("Document with this id already exist"s);
     }
-    if (!IsValidChars(document_text)) {
+    index_.InstallCompletedMerge();
+    // проверка символов совмещена с разбиением на слова; слова ссылаются
+    // на document_text, но в индексы попадают строки словаря
+    thread_local vector<string_view> document_words;
+    if (!SplitIntoWordsNoStop(document_text, document_words)) {
         throw invalid_argument("Document contents contain invalid characters"s);
     }
 
+    const int ordinal = static_cast<int>(documents_.size());
     document_ids_.insert(document_id);
-    documents_data_[document_id] = {ComputeAverageRating(ratings), status};
-    auto text = all_texts_.insert(all_texts_.end(), string(document_text));
-    const vector<string_view> document_words = SplitIntoWordsNoStop(*text);
-    document_to_word_freqs_[document_id];
+    document_ordinals_[document_id] = ordinal;
+    const string_view text = texts_.Add(document_text);
+    documents_.push_back(
+        {document_id, ComputeAverageRating(ratings), status, text});
+    map<string_view, double>& word_freqs = document_to_word_freqs_[document_id];
 
+    // ключи прямого индекса ссылаются на строки словаря, а не на текст
+    // документа
     double inverse_words_count = 1.0 / document_words.size();
     for (const string_view word : document_words) {
-        word_to_document_freqs_[word][document_id] += inverse_words_count;
-        document_to_word_freqs_.at(document_id)[word] += inverse_words_count;
+        word_freqs[index_.GetTerm(index_.AddTerm(word))] += inverse_words_count;
     }
+    for (const auto& [word, term_freq] : word_freqs) {
+        index_.AddPosting(*index_.FindTerm(word), ordinal, term_freq);
+    }
+    index_.SealBufferIfFull();
+    UpdateDocumentCount();
+}
+
+IngestionStatistics SearchServer::AddDocuments(
+    const vector<NewDocument>& documents) {
+    return AddDocuments(execution::seq, documents);
+}
+
+void SearchServer::SetSegmentBufferSize(size_t posting_count) {
+    index_.SetSegmentBufferSize(posting_count);
 }
 
+void SearchServer::WaitForSegmentMerges() { index_.WaitForMerges(); }
+
 void SearchServer::RemoveDocument(int document_id) {
+    index_.InstallCompletedMerge();
     if (document_ids_.count(document_id) == 0) {
         return;
     }
 
-    for (const auto& [word, _] : document_to_word_freqs_.at(document_id)) {
-        word_to_document_freqs_.at(word).erase(document_id);
-        if (word_to_document_freqs_.at(word).empty()) {
-            word_to_document_freqs_.erase(word);
+    vector<TermId> term_ids;
+    ForEachWordFreq(document_id, [&](string_view word, double) {
+        term_ids.push_back(*index_.FindTerm(word));
+    });
+    for (const TermId term_id : term_ids) {
+        index_.TombstonePosting(term_id);
+        index_.RemoveTermIfEmpty(term_id);
+    }
+
+    MarkDocumentRemoved(document_id);
+    CompactIfNeeded();
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    RemoveDocuments(execution::seq, document_ids);
+}
+
+void SearchServer::SetCompactionThreshold(double removed_fraction) {
+    compaction_threshold_ = removed_fraction;
+}
+
+CompactionStatistics SearchServer::Compact() {
+    return *ApplyCompaction(BuildCompaction());
+}
+
+SearchServer::Compaction SearchServer::BuildCompaction() const {
+    Compaction compaction{index_version_, InvertedIndex(index_.GetLayout()),
+                          StringArena(), {}, {}, {}};
+    compaction.documents.reserve(document_ordinals_.size());
+    for (const DocumentData& document : documents_) {
+        if (document.removed) {
+            continue;
         }
+
+        const int ordinal = static_cast<int>(compaction.documents.size());
+        compaction.documents.push_back(document);
+        compaction.documents.back().text = compaction.texts.Add(document.text);
+        compaction.document_ordinals[document.id] = ordinal;
+        map<string_view, double>& word_freqs =
+            compaction.document_to_word_freqs[document.id];
+        ForEachWordFreq(document.id, [&](string_view word, double term_freq) {
+            const TermId term_id = compaction.index.AddTerm(word);
+            word_freqs.emplace_hint(word_freqs.end(),
+                                    compaction.index.GetTerm(term_id),
+                                    term_freq);
+            compaction.index.AddPosting(term_id, ordinal, term_freq);
+        });
     }
+    // перестроенный индекс состоит из одного сегмента
+    compaction.index.SealBuffer();
+    compaction.index.SetSegmentBufferSize(index_.GetSegmentBufferSize());
 
-    document_ids_.erase(document_id);
-    document_to_word_freqs_.erase(document_id);
-    documents_data_.erase(document_id);
+    return compaction;
+}
+
+optional<CompactionStatistics> SearchServer::ApplyCompaction(
+    Compaction compaction) {
+    if (compaction.index_version != index_version_) {
+        return nullopt;
+    }
+
+    CompactionStatistics statistics;
+    statistics.removed_document_count = removed_document_count_;
+    const size_t memory_usage = GetMemoryUsage();
+
+    index_ = move(compaction.index);
+    texts_ = move(compaction.texts);
+    documents_ = move(compaction.documents);
+    document_ordinals_ = move(compaction.document_ordinals);
+    document_to_word_freqs_ = move(compaction.document_to_word_freqs);
+    removed_document_count_ = 0;
+    // тексты и слова скопированы, снимок больше не нужен
+    snapshot_.reset();
+    snapshot_word_freqs_ = nullptr;
+    snapshot_word_freq_offsets_.clear();
+    snapshot_word_freq_maps_.clear();
+    // номера документов изменились, индекс вкладов устарел
+    index_version_ = NextIndexVersion();
+
+    const size_t compacted_memory_usage = GetMemoryUsage();
+    if (memory_usage > compacted_memory_usage) {
+        statistics.reclaimed_bytes = memory_usage - compacted_memory_usage;
+    }
+    return statistics;
+}
+
+SnapshotStatistics SearchServer::SaveSnapshot(const string& path) const {
+    const auto start_time = chrono::steady_clock::now();
+    vector<char> strings;
+    const auto add_string = [&strings](const string_view text) {
+        const SnapshotString snapshot_string{strings.size(), text.size()};
+        strings.insert(strings.end(), text.begin(), text.end());
+        return snapshot_string;
+    };
+
+    vector<SnapshotString> stop_words;
+    for (const string& word : stop_words_) {
+        stop_words.push_back(add_string(word));
+    }
+
+    // сохраняются только действующие документы, номера и TermId
+    // назначаются заново подряд
+    vector<int> ordinals(documents_.size(), -1);
+    int document_count = 0;
+    for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+        if (!documents_[ordinal].removed) {
+            ordinals[ordinal] = document_count++;
+        }
+    }
+
+    vector<TermId> term_ids = index_.GetTermIds();
+    sort(term_ids.begin(), term_ids.end());
+    vector<uint32_t> snapshot_term_ids(
+        term_ids.empty() ? 0 : term_ids.back() + 1);
+    vector<SnapshotString> terms;
+    vector<uint32_t> segment_term_ids;
+    vector<uint32_t> posting_offsets = {0};
+    vector<uint32_t> block_offsets = {0};
+    vector<Posting> postings;
+    vector<double> block_max_term_freqs;
+    for (const TermId term_id : term_ids) {
+        const size_t first = postings.size();
+        index_.ForEachPosting(term_id, [&](int ordinal, double term_freq) {
+            if (ordinals[ordinal] >= 0) {
+                postings.push_back({ordinals[ordinal], term_freq});
+            }
+        });
+        if (postings.size() == first) {
+            continue;
+        }
+
+        snapshot_term_ids[term_id] = static_cast<uint32_t>(terms.size());
+        segment_term_ids.push_back(static_cast<uint32_t>(terms.size()));
+        terms.push_back(add_string(index_.GetTerm(term_id)));
+        posting_offsets.push_back(static_cast<uint32_t>(postings.size()));
+        for (size_t begin = first; begin < postings.size();
+             begin += POSTING_BLOCK_SIZE) {
+            const size_t end = min(postings.size(), begin + POSTING_BLOCK_SIZE);
+            double max_term_freq = 0.0;
+            for (size_t i = begin; i < end; ++i) {
+                max_term_freq = max(max_term_freq, postings[i].term_freq);
+            }
+            block_max_term_freqs.push_back(max_term_freq);
+        }
+        block_offsets.push_back(
+            static_cast<uint32_t>(block_max_term_freqs.size()));
+    }
+
+    vector<SnapshotDocument> documents;
+    vector<SnapshotWordFreq> word_freqs;
+    documents.reserve(document_count);
+    for (const DocumentData& document : documents_) {
+        if (document.removed) {
+            continue;
+        }
+
+        const size_t first_word_freq = word_freqs.size();
+        ForEachWordFreq(document.id, [&](string_view word, double term_freq) {
+            word_freqs.push_back(
+                {snapshot_term_ids[*index_.FindTerm(word)], term_freq});
+        });
+        documents.push_back(
+            {document.id, document.rating,
+             static_cast<int32_t>(document.status),
+             static_cast<uint32_t>(word_freqs.size() - first_word_freq),
+             add_string(document.text)});
+    }
+
+    SnapshotWriter writer(path);
+    SnapshotHeader header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_FORMAT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.posting_size = sizeof(Posting);
+    header.strings = writer.WriteSection(strings);
+    header.stop_words = writer.WriteSection(stop_words);
+    header.terms = writer.WriteSection(terms);
+    header.documents = writer.WriteSection(documents);
+    header.word_freqs = writer.WriteSection(word_freqs);
+    header.segment_term_ids = writer.WriteSection(segment_term_ids);
+    header.posting_offsets = writer.WriteSection(posting_offsets);
+    header.block_offsets = writer.WriteSection(block_offsets);
+    header.postings = writer.WriteSection(postings);
+    header.block_max_term_freqs = writer.WriteSection(block_max_term_freqs);
+
+    SnapshotStatistics statistics;
+    statistics.document_count = documents.size();
+    statistics.byte_count = writer.Finish(header);
+    statistics.seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - start_time)
+            .count();
+    return statistics;
+}
+
+SnapshotStatistics SearchServer::LoadSnapshot(const string& path) {
+    const auto start_time = chrono::steady_clock::now();
+    const auto corrupted = []() {
+        return invalid_argument("Corrupted snapshot"s);
+    };
+    const auto snapshot = make_shared<const MappedFile>(path);
+    const SnapshotHeader& header = snapshot->GetSnapshotHeader();
+    const auto* stop_words =
+        snapshot->GetSection<SnapshotString>(header.stop_words);
+    const auto* terms = snapshot->GetSection<SnapshotString>(header.terms);
+    const auto* documents =
+        snapshot->GetSection<SnapshotDocument>(header.documents);
+    const auto* word_freqs =
+        snapshot->GetSection<SnapshotWordFreq>(header.word_freqs);
+    const auto* segment_term_ids =
+        snapshot->GetSection<uint32_t>(header.segment_term_ids);
+    const auto* posting_offsets =
+        snapshot->GetSection<uint32_t>(header.posting_offsets);
+    const auto* block_offsets =
+        snapshot->GetSection<uint32_t>(header.block_offsets);
+    const auto* postings = snapshot->GetSection<Posting>(header.postings);
+    const auto* block_max_term_freqs =
+        snapshot->GetSection<double>(header.block_max_term_freqs);
+
+    // При загрузке проверяются только заголовок, смещения и размеры
+    // списков. Вхождения и слова документов читаются из отображенного
+    // файла на месте и проверяются при первом обращении (см.
+    // IndexSegment::MapPlain и GetSnapshotWordFreqs), поэтому их страницы
+    // подгружаются по мере надобности.
+    const size_t term_count = header.terms.count;
+    const size_t document_count = header.documents.count;
+    if (header.segment_term_ids.count != term_count ||
+        header.posting_offsets.count != term_count + 1 ||
+        header.block_offsets.count != term_count + 1 ||
+        posting_offsets[0] != 0 || block_offsets[0] != 0 ||
+        posting_offsets[term_count] != header.postings.count ||
+        block_offsets[term_count] != header.block_max_term_freqs.count) {
+        throw corrupted();
+    }
+    for (size_t i = 0; i < term_count; ++i) {
+        const size_t size = posting_offsets[i + 1] - posting_offsets[i];
+        if (segment_term_ids[i] != i ||
+            posting_offsets[i + 1] <= posting_offsets[i] ||
+            block_offsets[i + 1] - block_offsets[i] !=
+                (size + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE) {
+            throw corrupted();
+        }
+    }
+
+    vector<string_view> stop_word_list;
+    for (size_t i = 0; i < header.stop_words.count; ++i) {
+        stop_word_list.push_back(
+            snapshot->GetString(header.strings, stop_words[i]));
+    }
+    StopWordSet new_stop_words(stop_word_list);
+
+    InvertedIndex index(index_.GetLayout());
+    index.SetSegmentBufferSize(index_.GetSegmentBufferSize());
+    for (size_t i = 0; i < term_count; ++i) {
+        if (index.AddTerm(snapshot->GetString(header.strings, terms[i])) != i) {
+            throw corrupted();
+        }
+    }
+    if (index_.GetLayout() == IndexLayout::PLAIN) {
+        index.AddSegment(IndexSegment::MapPlain(
+            snapshot,
+            vector<TermId>(segment_term_ids, segment_term_ids + term_count),
+            vector<uint32_t>(posting_offsets, posting_offsets + term_count + 1),
+            vector<uint32_t>(block_offsets, block_offsets + term_count + 1),
+            postings, block_max_term_freqs, static_cast<int>(document_count)));
+    } else {
+        // сжатый индекс строится из всех вхождений, поэтому они
+        // проверяются сразу
+        IndexSegment segment(IndexLayout::COMPRESSED, 0);
+        for (size_t i = 0; i < term_count; ++i) {
+            CompressedPostingList posting_list;
+            int previous_ordinal = -1;
+            for (uint32_t j = posting_offsets[i]; j < posting_offsets[i + 1];
+                 ++j) {
+                if (postings[j].document_id <= previous_ordinal ||
+                    static_cast<size_t>(postings[j].document_id) >=
+                        document_count) {
+                    throw corrupted();
+                }
+                previous_ordinal = postings[j].document_id;
+                posting_list.Add(postings[j].document_id,
+                                 postings[j].term_freq);
+            }
+            segment.AddPostingList(static_cast<TermId>(i),
+                                   move(posting_list));
+        }
+        index.AddSegment(move(segment));
+    }
+
+    vector<DocumentData> new_documents;
+    set<int> new_document_ids;
+    map<int, int> new_document_ordinals;
+    vector<uint64_t> word_freq_offsets = {0};
+    new_documents.reserve(document_count);
+    word_freq_offsets.reserve(document_count + 1);
+    for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        const SnapshotDocument& document = documents[ordinal];
+        if (document.status < 0 ||
+            document.status > static_cast<int32_t>(DocumentStatus::REMOVED) ||
+            document.word_count >
+                header.word_freqs.count - word_freq_offsets.back() ||
+            !new_document_ids.insert(document.id).second) {
+            throw corrupted();
+        }
+
+        new_documents.push_back(
+            {document.id, document.rating,
+             static_cast<DocumentStatus>(document.status),
+             snapshot->GetString(header.strings, document.text)});
+        new_document_ordinals[document.id] = static_cast<int>(ordinal);
+        word_freq_offsets.push_back(word_freq_offsets.back() +
+                                    document.word_count);
+    }
+
+    stop_words_ = move(new_stop_words);
+    index_ = move(index);
+    texts_ = StringArena();
+    documents_ = move(new_documents);
+    document_ids_ = move(new_document_ids);
+    document_ordinals_ = move(new_document_ordinals);
+    document_to_word_freqs_.clear();
+    snapshot_word_freqs_ = word_freqs;
+    snapshot_word_freq_offsets_ = move(word_freq_offsets);
+    snapshot_term_count_ = term_count;
+    snapshot_word_freq_maps_.clear();
+    removed_document_count_ = 0;
+    impact_index_version_.reset();
+    snapshot_ = snapshot;
+    UpdateDocumentCount();
+
+    SnapshotStatistics statistics;
+    statistics.document_count = document_count;
+    statistics.byte_count = snapshot->GetSize();
+    statistics.seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - start_time)
+            .count();
+    return statistics;
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(
@@ -82,23 +509,21 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(
     }
 
     const Query query = ParseQuery(raw_query);
-    for (const string_view word : query.minus_words) {
-        if (document_to_word_freqs_.at(document_id).count(word)) {
-            return {vector<string_view>(),
-                    documents_data_.at(document_id).status};
-        }
+    const int ordinal = document_ordinals_.at(document_id);
+    if (CollectExcludedDocuments(ResolveMinusWords(query), ordinal, ordinal + 1)
+            .Contains(ordinal)) {
+        return {vector<string_view>(), GetDocumentData(document_id).status};
     }
 
     vector<string_view> matched_words;
     for (const string_view word : query.plus_words) {
-        if (document_to_word_freqs_.at(document_id).count(word)) {
-            matched_words.push_back(
-                document_to_word_freqs_.at(document_id).find(word)->first);
+        if (const auto word_freq = FindWordFreq(document_id, word)) {
+            matched_words.push_back(word_freq->first);
         }
     }
     sort(matched_words.begin(), matched_words.end());
 
-    return {matched_words, documents_data_.at(document_id).status};
+    return {matched_words, GetDocumentData(document_id).status};
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(
@@ -115,39 +540,489 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(
     }
 
     const Query query = ParseQuery(raw_query, true);
-    const map<string_view, double>& word_to_freq =
-        document_to_word_freqs_.at(document_id);
-    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(),
-               [&](const string_view word) -> bool {
-                   return word_to_freq.count(word);
-               })) {
-        return {vector<string_view>(), documents_data_.at(document_id).status};
+    const int ordinal = document_ordinals_.at(document_id);
+    if (CollectExcludedDocuments(ResolveMinusWords(query), ordinal, ordinal + 1)
+            .Contains(ordinal)) {
+        return {vector<string_view>(), GetDocumentData(document_id).status};
     }
 
+    // слова документа снимка проверяются до параллельного поиска,
+    // исключение из которого завершило бы программу
+    GetDocumentWordCount(document_id);
     vector<string_view> matched_words;
     matched_words.resize(query.plus_words.size());
     auto matched_words_end = copy_if(
         policy, query.plus_words.begin(), query.plus_words.end(),
-        matched_words.begin(),
-        [&](const string_view word) { return word_to_freq.count(word); });
+        matched_words.begin(), [&](const string_view word) {
+            return FindWordFreq(document_id, word).has_value();
+        });
     matched_words.resize(matched_words_end - matched_words.begin());
+    // возвращаем строки словаря, а не части запроса, который может быть
+    // временным объектом
+    transform(policy, matched_words.begin(), matched_words.end(),
+              matched_words.begin(), [&](const string_view word) {
+                  return FindWordFreq(document_id, word)->first;
+              });
     sort(policy, matched_words.begin(), matched_words.end());
     matched_words.erase(
         unique(policy, matched_words.begin(), matched_words.end()),
         matched_words.end());
 
-    return {matched_words, documents_data_.at(document_id).status};
+    return {matched_words, GetDocumentData(document_id).status};
 }
 
-vector<Document> SearchServer::FindTopDocuments(
-    const string_view raw_query, DocumentStatus filter_status) const {
-    return FindTopDocuments(execution::seq, raw_query, filter_status);
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query,
+                                                DocumentStatus filter_status,
+                                                ResultPage page) const {
+    return FindTopDocuments(execution::seq, raw_query, filter_status, page);
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(
-    const string_view word) const {
-    return log(static_cast<double>(documents_data_.size()) /
-               word_to_document_freqs_.at(word).size());
+SearchServer::PreparedQuery SearchServer::PrepareQuery(
+    const string_view raw_query) const {
+    const Query query = ParseQuery(raw_query);
+    PreparedQuery prepared;
+    prepared.plus_words_.assign(query.plus_words.begin(),
+                                query.plus_words.end());
+    prepared.minus_words_.assign(query.minus_words.begin(),
+                                 query.minus_words.end());
+    prepared.terms_ = ResolveQuery(query);
+    prepared.index_version_ = index_version_;
+    return prepared;
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(
+    const PreparedQuery& query, int document_id) const {
+    if (document_ids_.count(document_id) == 0) {
+        return {};
+    }
+
+    ResolvedQuery resolved;
+    const ResolvedQuery& terms = ResolvePreparedQuery(query, resolved);
+    const int ordinal = document_ordinals_.at(document_id);
+    const DocumentStatus status = documents_[ordinal].status;
+    if (CollectExcludedDocuments(terms.minus_terms, ordinal, ordinal + 1)
+            .Contains(ordinal)) {
+        return {vector<string_view>(), status};
+    }
+
+    // слова ищутся не в словаре документа, а в списках вхождений
+    // терминов; термины идут в порядке слов, так что результат упорядочен
+    vector<string_view> matched_words;
+    for (const QueryTerm& term : terms.plus_terms) {
+        PostingCursor cursor(index_, term.term_id);
+        cursor.NextGeq(ordinal);
+        if (cursor.DocumentId() == ordinal) {
+            matched_words.push_back(index_.GetTerm(term.term_id));
+        }
+    }
+
+    return {matched_words, status};
+}
+
+vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query,
+                                                DocumentStatus filter_status,
+                                                ResultPage page) const {
+    return FindTopDocuments(execution::seq, query, filter_status, page);
+}
+
+void SearchServer::FindTopDocuments(QueryScratch& scratch,
+                                    const string_view raw_query,
+                                    DocumentStatus filter_status,
+                                    ResultPage page,
+                                    vector<Document>& documents) const {
+    const size_t top_count = page.size > SIZE_MAX - page.offset
+                                 ? SIZE_MAX
+                                 : page.offset + page.size;
+    ParseQuery(raw_query, false, scratch.query_);
+    ResolveQuery(scratch.query_, scratch.terms_);
+    if (top_count == 0) {
+        documents.clear();
+        return;
+    }
+
+    // массивы по номерам документов растут только вместе с индексом, а
+    // после каждого запроса сбрасываются лишь затронутые элементы
+    if (scratch.states_.size() < documents_.size()) {
+        scratch.relevances_.resize(documents_.size(), 0.0);
+        scratch.states_.resize(documents_.size(), QueryScratch::UNSEEN);
+    }
+    PostingCursor& cursor = scratch.cursor_;
+    for (const TermId term_id : scratch.terms_.minus_terms) {
+        cursor.Reset(index_, term_id);
+        for (; cursor.DocumentId() != PostingCursor::END; cursor.Next()) {
+            uint8_t& state = scratch.states_[cursor.DocumentId()];
+            if (state == QueryScratch::UNSEEN) {
+                scratch.touched_ordinals_.push_back(cursor.DocumentId());
+            }
+            state = QueryScratch::EXCLUDED;
+        }
+    }
+    for (const auto& [term_id, idf] : scratch.terms_.plus_terms) {
+        cursor.Reset(index_, term_id);
+        for (; cursor.DocumentId() != PostingCursor::END; cursor.Next()) {
+            const int ordinal = cursor.DocumentId();
+            uint8_t& state = scratch.states_[ordinal];
+            if (state == QueryScratch::EXCLUDED) {
+                continue;
+            }
+            if (state == QueryScratch::UNSEEN) {
+                scratch.touched_ordinals_.push_back(ordinal);
+                state = QueryScratch::MATCHED;
+            }
+            scratch.relevances_[ordinal] += idf * cursor.TermFreq();
+        }
+    }
+
+    TopDocuments& top_documents = scratch.top_documents_;
+    top_documents.Reset(top_count);
+    for (const int ordinal : scratch.touched_ordinals_) {
+        const DocumentData& document = documents_[ordinal];
+        if (scratch.states_[ordinal] == QueryScratch::MATCHED &&
+            !document.removed && document.status == filter_status) {
+            top_documents.Add(
+                Document(document.id, scratch.relevances_[ordinal],
+                         document.rating));
+        }
+        scratch.relevances_[ordinal] = 0.0;
+        scratch.states_[ordinal] = QueryScratch::UNSEEN;
+    }
+    scratch.touched_ordinals_.clear();
+    top_documents.Extract(page.offset, documents);
+}
+
+uint64_t SearchServer::PreparedQuery::GetIndexVersion() const {
+    return index_version_;
+}
+
+void SearchServer::AddQueryStatistics(const string_view raw_query,
+                                      CorpusStatistics& statistics) const {
+    AddQueryStatistics(ParseQuery(raw_query), statistics);
+}
+
+void SearchServer::AddQueryStatistics(const PreparedQuery& query,
+                                      CorpusStatistics& statistics) const {
+    AddQueryStatistics(GetPreparedQueryWords(query), statistics);
+}
+
+void SearchServer::AddQueryStatistics(const Query& query,
+                                      CorpusStatistics& statistics) const {
+    statistics.document_count += document_ordinals_.size();
+    for (const string_view word : query.plus_words) {
+        if (const optional<TermId> term_id = index_.FindTerm(word)) {
+            statistics.document_freqs[index_.GetTerm(*term_id)] +=
+                index_.GetDocumentFreq(*term_id);
+        }
+    }
+}
+
+void SearchServer::ValidateNewDocuments(
+    const vector<NewDocument>& documents) const {
+    set<int> new_ids;
+    for (const NewDocument& document : documents) {
+        if (document.id < 0) {
+            throw invalid_argument("Id can take only none-negative values"s);
+        }
+        if (document_ordinals_.count(document.id) != 0 ||
+            !new_ids.insert(document.id).second) {
+            throw invalid_argument("Document with this id already exist"s);
+        }
+        if (!IsValidChars(document.text)) {
+            throw invalid_argument(
+                "Document contents contain invalid characters"s);
+        }
+    }
+}
+
+SearchServer::PartialIndex SearchServer::BuildPartialIndex(
+    const vector<string_view>& texts, size_t first, size_t last,
+    int first_ordinal) const {
+    PartialIndex partial_index;
+    partial_index.word_freqs.resize(last - first);
+    vector<string_view> document_words;
+    for (size_t i = first; i < last; ++i) {
+        // символы проверены в ValidateNewDocuments
+        SplitIntoWordsNoStop(texts[i], document_words);
+        map<string_view, double>& word_freqs =
+            partial_index.word_freqs[i - first];
+        double inverse_words_count = 1.0 / document_words.size();
+        for (const string_view word : document_words) {
+            word_freqs[word] += inverse_words_count;
+        }
+
+        const int ordinal = first_ordinal + static_cast<int>(i);
+        for (const auto& [word, term_freq] : word_freqs) {
+            partial_index.postings[word].push_back({ordinal, term_freq});
+        }
+    }
+
+    return partial_index;
+}
+
+vector<TermId> SearchServer::ResolveMinusWords(const Query& query) const {
+    vector<TermId> terms;
+    for (const string_view word : query.minus_words) {
+        if (const optional<TermId> term_id = index_.FindTerm(word)) {
+            terms.push_back(*term_id);
+        }
+    }
+
+    return terms;
+}
+
+SearchServer::ResolvedQuery SearchServer::ResolveQuery(
+    const Query& query) const {
+    ResolvedQuery terms;
+    ResolveQuery(query, terms);
+    return terms;
+}
+
+void SearchServer::ResolveQuery(const Query& query,
+                                ResolvedQuery& terms) const {
+    terms.plus_terms.clear();
+    for (const string_view word : query.plus_words) {
+        if (const optional<TermId> term_id = index_.FindTerm(word)) {
+            terms.plus_terms.push_back(
+                {*term_id,
+                 query.statistics == nullptr
+                     ? ComputeWordInverseDocumentFreq(*term_id)
+                     : query.statistics->ComputeInverseDocumentFreq(word)});
+        }
+    }
+    terms.minus_terms.clear();
+    for (const string_view word : query.minus_words) {
+        if (const optional<TermId> term_id = index_.FindTerm(word)) {
+            terms.minus_terms.push_back(*term_id);
+        }
+    }
+    terms.corpus_idf = query.statistics != nullptr;
+}
+
+const SearchServer::ResolvedQuery& SearchServer::ResolvePreparedQuery(
+    const PreparedQuery& query, ResolvedQuery& resolved) const {
+    if (query.index_version_ == index_version_) {
+        return query.terms_;
+    }
+
+    resolved = ResolveQuery(GetPreparedQueryWords(query));
+    return resolved;
+}
+
+SearchServer::Query SearchServer::GetPreparedQueryWords(
+    const PreparedQuery& query) {
+    Query words;
+    words.plus_words.assign(query.plus_words_.begin(),
+                            query.plus_words_.end());
+    words.minus_words.assign(query.minus_words_.begin(),
+                             query.minus_words_.end());
+    return words;
+}
+
+SearchServer::QueryBatch SearchServer::BuildQueryBatch(
+    const vector<ResolvedQuery>& queries) const {
+    struct PlusEntry {
+        string_view word;
+        TermId term_id;
+        QueryBatch::Subscriber subscriber;
+    };
+
+    vector<PlusEntry> plus_entries;
+    vector<pair<TermId, size_t>> minus_entries;
+    for (size_t query = 0; query < queries.size(); ++query) {
+        for (const auto& [term_id, idf] : queries[query].plus_terms) {
+            plus_entries.push_back(
+                {index_.GetTerm(term_id), term_id, {query, idf}});
+        }
+        for (const TermId term_id : queries[query].minus_terms) {
+            minus_entries.push_back({term_id, query});
+        }
+    }
+    sort(plus_entries.begin(), plus_entries.end(),
+         [](const PlusEntry& lhs, const PlusEntry& rhs) {
+             return tie(lhs.word, lhs.subscriber.query) <
+                    tie(rhs.word, rhs.subscriber.query);
+         });
+    sort(minus_entries.begin(), minus_entries.end());
+
+    QueryBatch batch;
+    batch.query_count = queries.size();
+    for (const PlusEntry& entry : plus_entries) {
+        if (batch.plus_terms.empty() ||
+            batch.plus_terms.back() != entry.term_id) {
+            batch.plus_terms.push_back(entry.term_id);
+            batch.plus_term_begins.push_back(batch.plus_subscribers.size());
+        }
+        batch.plus_subscribers.push_back(entry.subscriber);
+    }
+    batch.plus_term_begins.push_back(batch.plus_subscribers.size());
+    for (const auto& [term_id, query] : minus_entries) {
+        if (batch.minus_terms.empty() || batch.minus_terms.back() != term_id) {
+            batch.minus_terms.push_back(term_id);
+            batch.minus_term_begins.push_back(batch.minus_subscribers.size());
+        }
+        batch.minus_subscribers.push_back(query);
+    }
+    batch.minus_term_begins.push_back(batch.minus_subscribers.size());
+    return batch;
+}
+
+DocumentSet SearchServer::CollectExcludedDocuments(
+    const vector<TermId>& minus_terms, int first_ordinal,
+    int last_ordinal) const {
+    if (minus_terms.empty()) {
+        return DocumentSet(first_ordinal, first_ordinal);
+    }
+
+    DocumentSet excluded_documents(first_ordinal, last_ordinal);
+    for (const TermId term_id : minus_terms) {
+        PostingCursor cursor(index_, term_id);
+        for (cursor.NextGeq(first_ordinal); cursor.DocumentId() < last_ordinal;
+             cursor.Next()) {
+            excluded_documents.Insert(cursor.DocumentId());
+        }
+    }
+
+    return excluded_documents;
+}
+
+SearchServer::QueryScratch& SearchServer::GetThreadScratch(
+    size_t cell_count) const {
+    thread_local QueryScratch scratch;
+    // запрос, прерванный исключением предиката, мог оставить счетчики
+    for (const int ordinal : scratch.touched_ordinals_) {
+        scratch.relevances_[ordinal] = 0.0;
+        scratch.states_[ordinal] = QueryScratch::UNSEEN;
+    }
+    scratch.touched_ordinals_.clear();
+    if (scratch.states_.size() < cell_count) {
+        scratch.relevances_.resize(cell_count, 0.0);
+        scratch.states_.resize(cell_count, QueryScratch::UNSEEN);
+    }
+    return scratch;
+}
+
+const SearchServer::DocumentData& SearchServer::GetDocumentData(
+    int document_id) const {
+    return documents_[document_ordinals_.at(document_id)];
+}
+
+size_t SearchServer::GetDocumentWordCount(int document_id) const {
+    if (const auto it = document_to_word_freqs_.find(document_id);
+        it != document_to_word_freqs_.end()) {
+        return it->second.size();
+    }
+    const auto [begin, end] =
+        GetSnapshotWordFreqs(document_ordinals_.at(document_id));
+    return end - begin;
+}
+
+optional<pair<string_view, double>> SearchServer::FindWordFreq(
+    int document_id, string_view word) const {
+    if (const auto it = document_to_word_freqs_.find(document_id);
+        it != document_to_word_freqs_.end()) {
+        const auto word_it = it->second.find(word);
+        if (word_it == it->second.end()) {
+            return nullopt;
+        }
+        return *word_it;
+    }
+
+    const auto [begin, end] =
+        GetSnapshotWordFreqs(document_ordinals_.at(document_id));
+    const SnapshotWordFreq* word_freq = lower_bound(
+        begin, end, word,
+        [this](const SnapshotWordFreq& word_freq, string_view word) {
+            return index_.GetTerm(word_freq.term_id) < word;
+        });
+    if (word_freq == end || index_.GetTerm(word_freq->term_id) != word) {
+        return nullopt;
+    }
+    return pair{index_.GetTerm(word_freq->term_id), word_freq->term_freq};
+}
+
+pair<const SnapshotWordFreq*, const SnapshotWordFreq*>
+SearchServer::GetSnapshotWordFreqs(int ordinal) const {
+    const SnapshotWordFreq* begin =
+        snapshot_word_freqs_ + snapshot_word_freq_offsets_[ordinal];
+    const SnapshotWordFreq* end =
+        snapshot_word_freqs_ + snapshot_word_freq_offsets_[ordinal + 1];
+    if (any_of(begin, end, [this](const SnapshotWordFreq& word_freq) {
+            return word_freq.term_id >= snapshot_term_count_;
+        })) {
+        throw invalid_argument("Corrupted snapshot"s);
+    }
+    return {begin, end};
+}
+
+bool SearchServer::IsImpactIndexActual() const {
+    return impact_index_version_ == index_version_;
+}
+
+string SearchServer::BuildQueryCacheKey(const Query& query,
+                                        DocumentStatus filter_status,
+                                        ResultPage page) const {
+    // слова не содержат управляющих символов, поэтому '\n' однозначно
+    // разделяет части ключа. Индекс вкладов меняет результаты
+    // RetrievalEngine::IMPACT без изменения поколения, поэтому в ключ
+    // входит способ отбора, которым запрос будет выполнен на самом деле.
+    const RetrievalEngine engine =
+        retrieval_engine_ == RetrievalEngine::IMPACT && !IsImpactIndexActual()
+            ? RetrievalEngine::EXHAUSTIVE
+            : retrieval_engine_;
+    string key;
+    for (const string_view word : query.plus_words) {
+        key.append(word);
+        key.push_back(' ');
+    }
+    key.push_back('\n');
+    for (const string_view word : query.minus_words) {
+        key.append(word);
+        key.push_back(' ');
+    }
+    key.push_back('\n');
+    key.append(to_string(static_cast<int>(filter_status)));
+    key.push_back(' ');
+    key.append(to_string(static_cast<int>(engine)));
+    key.push_back(' ');
+    key.append(to_string(page.offset));
+    key.push_back(' ');
+    key.append(to_string(page.size));
+    return key;
+}
+
+size_t SearchServer::GetMemoryUsage() const {
+    const IndexStatistics statistics = GetIndexStatistics();
+    return statistics.postings_bytes + statistics.terms_bytes +
+           statistics.texts_bytes +
+           documents_.capacity() * sizeof(DocumentData);
+}
+
+void SearchServer::MarkDocumentRemoved(int document_id) {
+    documents_[document_ordinals_.at(document_id)].removed = true;
+    ++removed_document_count_;
+    document_ids_.erase(document_id);
+    document_to_word_freqs_.erase(document_id);
+    snapshot_word_freq_maps_.erase(document_id);
+    document_ordinals_.erase(document_id);
+    UpdateDocumentCount();
+}
+
+void SearchServer::CompactIfNeeded() {
+    if (removed_document_count_ >
+        compaction_threshold_ * static_cast<double>(documents_.size())) {
+        Compact();
+    }
+}
+
+void SearchServer::UpdateDocumentCount() {
+    index_version_ = NextIndexVersion();
+    log_document_count_ =
+        document_ordinals_.empty()
+            ? 0.0
+            : log(static_cast<double>(document_ordinals_.size()));
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term_id) const {
+    return log_document_count_ - index_.GetLogDocumentFreq(term_id);
 }
 
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
@@ -162,11 +1037,20 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
 SearchServer::Query SearchServer::ParseQuery(const string_view text,
                                              bool parallel) const {
     Query query;
-    for (string_view word : SplitIntoWordsNoStop(text)) {
-        if (!IsValidChars(word)) {
-            throw invalid_argument("Query contains invalid characters"s);
-        }
+    ParseQuery(text, parallel, query);
+    return query;
+}
 
+void SearchServer::ParseQuery(const string_view text, bool parallel,
+                              Query& query) const {
+    query.plus_words.clear();
+    query.minus_words.clear();
+    query.statistics = nullptr;
+    thread_local vector<string_view> words;
+    if (!SplitIntoWordsNoStop(text, words)) {
+        throw invalid_argument("Query contains invalid characters"s);
+    }
+    for (const string_view word : words) {
         if (word[0] == '-') {
             query.minus_words.push_back(ParseMinusWord(word));
         } else {
@@ -178,20 +1062,22 @@ SearchServer::Query SearchServer::ParseQuery(const string_view text,
         RemoveDuplicates(query.plus_words);
         RemoveDuplicates(query.minus_words);
     }
-
-    return query;
 }
 
-vector<string_view> SearchServer::SplitIntoWordsNoStop(
-    const string_view text) const {
-    vector<string_view> words;
-    for (const string_view word : SplitIntoWords(text)) {
-        if (stop_words_.count(word) == 0) {
-            words.push_back(word);
-        }
+bool SearchServer::SplitIntoWordsNoStop(const string_view text,
+                                        vector<string_view>& words) const {
+    if (!SplitIntoWords(text, words)) {
+        return false;
+    }
+    if (!stop_words_.Empty()) {
+        words.erase(remove_if(words.begin(), words.end(),
+                              [this](const string_view word) {
+                                  return stop_words_.Contains(word);
+                              }),
+                    words.end());
     }
 
-    return words;
+    return true;
 }
 
 string_view SearchServer::ParseMinusWord(const string_view word) {
@@ -208,6 +1094,5 @@ bool SearchServer::IsValidMinusWord(const string_view word) {
 }
 
 bool SearchServer::IsValidChars(const string_view word) {
-    return none_of(word.begin(), word.end(),
-                   [](char c) { return c >= '\0' && c < ' '; });
+    return !ContainsControlChars(word);
 }
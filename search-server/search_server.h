@@ -1,27 +1,124 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <execution>
+#include <functional>
+#include <optional>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <set>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
-#include "concurrent_map.h"
 #include "document.h"
+#include "document_set.h"
+#include "impact_index.h"
+#include "index_snapshot.h"
+#include "inverted_index.h"
+#include "posting_cursor.h"
+#include "query_result_cache.h"
+#include "stop_word_set.h"
+#include "string_arena.h"
+#include "top_documents.h"
 
 constexpr const size_t MAX_RESULT_DOCUMENT_COUNT = 5;
 
+// Параллельный поиск делит документы на диапазоны не меньше этого размера
+constexpr const size_t MIN_PARALLEL_CHUNK_SIZE = 4096;
+
+// Число счетчиков "запрос x документ" в окне пакетного поиска;
+// окно должно помещаться в кэш процессора
+constexpr const size_t BATCH_WINDOW_CELL_COUNT = 1 << 16;
+
+// Пакетное добавление делит документы на части не меньше этого размера
+constexpr const size_t MIN_INGESTION_CHUNK_SIZE = 64;
+
+// Страница выдачи: size документов, начиная с позиции offset
+struct ResultPage {
+    size_t offset = 0;
+    size_t size = MAX_RESULT_DOCUMENT_COUNT;
+};
+
+// Документ для пакетного добавления SearchServer::AddDocuments
+struct NewDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+// Производительность пакетного добавления документов
+struct IngestionStatistics {
+    size_t document_count = 0;
+    size_t byte_count = 0;
+    double seconds = 0.0;
+
+    double GetDocumentsPerSecond() const;
+
+    double GetMegabytesPerSecond() const;
+};
+
+// Статистика слов запроса по корпусу из нескольких серверов, чтобы IDF
+// совпадал с IDF единого сервера. Ключи ссылаются на словарь одного
+// из серверов.
+struct CorpusStatistics {
+    size_t document_count = 0;
+    std::map<std::string_view, size_t> document_freqs;
+
+    double ComputeInverseDocumentFreq(const std::string_view word) const;
+};
+
+// Результат сжатия индексов SearchServer::Compact
+struct CompactionStatistics {
+    size_t removed_document_count = 0;
+    size_t reclaimed_bytes = 0;
+};
+
+// WAND пропускает документы и блоки по верхней оценке релевантности
+// с тем же результатом, что EXHAUSTIVE. IMPACT использует индекс вкладов
+// (BuildImpactIndex), и при близкой релевантности состав выдачи может
+// отличаться; без актуального индекса используется EXHAUSTIVE.
+enum class RetrievalEngine {
+    EXHAUSTIVE,
+    WAND,
+    IMPACT,
+};
+
 class SearchServer {
    public:
+    // Индексы без удаленных документов, подготовленные BuildCompaction
+    struct Compaction;
+
+    class PreparedQuery;
+
+    class QueryScratch;
+
     template <typename Collection>
-    explicit SearchServer(const Collection& stop_words);
+    explicit SearchServer(const Collection& stop_words,
+                          IndexLayout layout = IndexLayout::PLAIN);
 
-    explicit SearchServer(const std::string& stop_words_str);
+    // Стоп-слова, таблица которых построена при компиляции
+    template <size_t N, size_t TableScale>
+    explicit SearchServer(
+        const StaticStopWordSet<N, TableScale>& stop_words,
+        IndexLayout layout = IndexLayout::PLAIN);
 
-    explicit SearchServer(const std::string_view stop_words_sv);
+    explicit SearchServer(const std::string& stop_words_str,
+                          IndexLayout layout = IndexLayout::PLAIN);
+
+    explicit SearchServer(const std::string_view stop_words_sv,
+                          IndexLayout layout = IndexLayout::PLAIN);
 
     std::set<int>::iterator begin() const;
 
@@ -32,14 +129,77 @@ class SearchServer {
 
     size_t GetDocumentCount() const;
 
+    IndexStatistics GetIndexStatistics() const;
+
+    void SetRetrievalEngine(RetrievalEngine engine);
+
+    // Индекс вкладов для RetrievalEngine::IMPACT; устаревает при изменении
+    // документов
+    void BuildImpactIndex();
+
+    // Кэш результатов FindTopDocuments с фильтром по статусу на capacity
+    // запросов, 0 отключает кэш. Нельзя вызывать одновременно с поиском.
+    void SetQueryCacheCapacity(size_t capacity);
+
+    QueryCacheStatistics GetQueryCacheStatistics() const;
+
+    // Увеличивается при каждом изменении набора документов
+    uint64_t GetIndexVersion() const;
+
     void AddDocument(int document_id, const std::string_view document_text,
                      DocumentStatus status, const std::vector<int>& ratings);
 
+    // Если хотя бы один документ некорректен, сервер не меняется
+    template <typename ExecutionPolicy>
+    IngestionStatistics AddDocuments(ExecutionPolicy&& policy,
+                                     const std::vector<NewDocument>& documents);
+
+    IngestionStatistics AddDocuments(const std::vector<NewDocument>& documents);
+
+    // Выбрасывает исключение, если AddDocuments отклонит документы
+    void ValidateNewDocuments(const std::vector<NewDocument>& documents) const;
+
+    // Число вхождений, после которого буфер записи индекса запечатывается
+    // в сегмент (см. InvertedIndex)
+    void SetSegmentBufferSize(size_t posting_count);
+
+    // Дожидается завершения фоновых слияний сегментов индекса
+    void WaitForSegmentMerges();
+
+    // Вхождения и текст удаленного документа освобождаются при сжатии
     void RemoveDocument(int document_id);
 
     template <typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
 
+    // Несуществующие id пропускаются
+    template <typename ExecutionPolicy>
+    void RemoveDocuments(ExecutionPolicy&& policy,
+                         const std::vector<int>& document_ids);
+
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    // Доля удаленных документов, при превышении которой RemoveDocument
+    // сжимает индексы. По умолчанию сжатие выполняется только вручную.
+    void SetCompactionThreshold(double removed_fraction);
+
+    CompactionStatistics Compact();
+
+    // BuildCompaction может выполняться одновременно с поиском;
+    // ApplyCompaction возвращает nullopt, если документы менялись после
+    // BuildCompaction.
+    Compaction BuildCompaction() const;
+
+    std::optional<CompactionStatistics> ApplyCompaction(Compaction compaction);
+
+    // Удаленные документы не сохраняются; path заменяется атомарно
+    SnapshotStatistics SaveSnapshot(const std::string& path) const;
+
+    // Файл отображается в память и не должен меняться, пока сервер его
+    // использует. Списки вхождений и слова документов проверяются при первом
+    // обращении; снимок с некорректной структурой не меняет сервер.
+    SnapshotStatistics LoadSnapshot(const std::string& path);
+
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
         const std::string_view raw_query, int document_id) const;
 
@@ -51,65 +211,307 @@ class SearchServer {
         const std::execution::parallel_policy& policy,
         const std::string_view raw_query, int document_id) const;
 
+    // Запрос для многократного выполнения (см. PreparedQuery)
+    PreparedQuery PrepareQuery(const std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        const PreparedQuery& query, int document_id) const;
+
+    // Проверка документа по подготовленному запросу не делится на части,
+    // поэтому policy не влияет на выполнение
+    template <typename ExecutionPolicy>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        ExecutionPolicy&& policy, const PreparedQuery& query,
+        int document_id) const;
+
     template <typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(
         ExecutionPolicy&& policy, const std::string_view raw_query,
-        DocumentPredicate document_predicate) const;
+        DocumentPredicate document_predicate, ResultPage page = {}) const;
 
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(
         const std::string_view raw_query,
-        DocumentPredicate document_predicate) const;
+        DocumentPredicate document_predicate, ResultPage page = {}) const;
 
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(
         ExecutionPolicy&& policy, const std::string_view raw_query,
-        DocumentStatus filter_status = DocumentStatus::ACTUAL) const;
+        DocumentStatus filter_status = DocumentStatus::ACTUAL,
+        ResultPage page = {}) const;
 
     std::vector<Document> FindTopDocuments(
         const std::string_view raw_query,
-        DocumentStatus filter_status = DocumentStatus::ACTUAL) const;
+        DocumentStatus filter_status = DocumentStatus::ACTUAL,
+        ResultPage page = {}) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+        ExecutionPolicy&& policy, const PreparedQuery& query,
+        DocumentPredicate document_predicate, ResultPage page = {}) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+        const PreparedQuery& query, DocumentPredicate document_predicate,
+        ResultPage page = {}) const;
+
+    // Подготовленные запросы выполняются мимо кэша результатов
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(
+        ExecutionPolicy&& policy, const PreparedQuery& query,
+        DocumentStatus filter_status = DocumentStatus::ACTUAL,
+        ResultPage page = {}) const;
+
+    std::vector<Document> FindTopDocuments(
+        const PreparedQuery& query,
+        DocumentStatus filter_status = DocumentStatus::ACTUAL,
+        ResultPage page = {}) const;
+
+    // Полный перебор без выделения памяти после того, как scratch
+    // и documents выросли; один scratch - на один поток
+    void FindTopDocuments(QueryScratch& scratch,
+                          const std::string_view raw_query,
+                          DocumentStatus filter_status, ResultPage page,
+                          std::vector<Document>& documents) const;
+
+    // Пакет запросов полным перебором: каждый список вхождений
+    // просматривается один раз на пакет. Результаты как при EXHAUSTIVE.
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(
+        ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries,
+        DocumentPredicate document_predicate, ResultPage page = {}) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(
+        ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries,
+        DocumentStatus filter_status = DocumentStatus::ACTUAL,
+        ResultPage page = {}) const;
+
+    // Добавляет в statistics документы сервера и число документов с каждым
+    // плюс-словом запроса
+    void AddQueryStatistics(const std::string_view raw_query,
+                            CorpusStatistics& statistics) const;
+
+    // Запрос мог быть подготовлен другим сервером с теми же стоп-словами
+    void AddQueryStatistics(const PreparedQuery& query,
+                            CorpusStatistics& statistics) const;
+
+    // IDF по статистике корпуса; RetrievalEngine::IMPACT заменяется полным
+    // перебором
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+        ExecutionPolicy&& policy, const std::string_view raw_query,
+        const CorpusStatistics& statistics,
+        DocumentPredicate document_predicate, ResultPage page = {}) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+        ExecutionPolicy&& policy, const PreparedQuery& query,
+        const CorpusStatistics& statistics,
+        DocumentPredicate document_predicate, ResultPage page = {}) const;
 
    private:
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        // статистика корпуса, если IDF вычисляется не по серверу
+        const CorpusStatistics* statistics = nullptr;
+    };
+
+    struct QueryTerm {
+        TermId term_id;
+        double idf;
+    };
+
+    // Запрос, слова которого сопоставлены со словарем индекса
+    struct ResolvedQuery {
+        std::vector<QueryTerm> plus_terms;
+        std::vector<TermId> minus_terms;
+        // IDF вычислен по статистике корпуса, а не сервера
+        bool corpus_idf = false;
     };
 
+    // Слова пакета запросов и подписанные на них запросы по диапазонам
+    struct QueryBatch {
+        struct Subscriber {
+            size_t query;
+            double idf;
+        };
+
+        size_t query_count = 0;
+        // упорядочены по словам, как плюс-слова в каждом запросе, поэтому
+        // релевантность суммируется в том же порядке, что и без пакета
+        std::vector<TermId> plus_terms;
+        std::vector<size_t> plus_term_begins;
+        std::vector<Subscriber> plus_subscribers;
+        std::vector<TermId> minus_terms;
+        std::vector<size_t> minus_term_begins;
+        std::vector<size_t> minus_subscribers;
+    };
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy,
+                                           const ResolvedQuery& query,
+                                           DocumentPredicate document_predicate,
+                                           ResultPage page) const;
+
     struct DocumentData {
+        int id;
         int rating;
         DocumentStatus status;
+        std::string_view text;
+        bool removed = false;
+    };
+
+    // Индексы части пакета добавляемых документов. Ключи ссылаются
+    // на тексты документов в texts_.
+    struct PartialIndex {
+        std::vector<std::map<std::string_view, double>> word_freqs;
+        std::unordered_map<std::string_view, std::vector<Posting>> postings;
     };
 
-    std::set<std::string, std::less<>> stop_words_;
+    StopWordSet stop_words_;
     std::set<int> document_ids_;
-    std::map<int, DocumentData> documents_data_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+    // Внутренние номера документов в порядке добавления; списки вхождений
+    // хранят номера, а не id
+    std::map<int, int> document_ordinals_;
+    std::vector<DocumentData> documents_;
+    InvertedIndex index_;
+    // log от числа документов, обновляется при добавлении и удалении
+    double log_document_count_ = 0.0;
+    // увеличивается при каждом изменении набора документов
+    uint64_t index_version_ = 0;
+    ImpactIndex impact_index_;
+    std::optional<uint64_t> impact_index_version_;
+    RetrievalEngine retrieval_engine_ = RetrievalEngine::EXHAUSTIVE;
+    std::unique_ptr<QueryResultCache> query_cache_;
     std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::vector<std::string> all_texts_;
+    StringArena texts_;
+    size_t removed_document_count_ = 0;
+    double compaction_threshold_ = 1.0;
+    // загруженный снимок, на который ссылаются тексты документов
+    std::shared_ptr<const MappedFile> snapshot_;
+    // Прямой индекс документов снимка, которых нет в document_to_word_freqs_
+    const SnapshotWordFreq* snapshot_word_freqs_ = nullptr;
+    std::vector<uint64_t> snapshot_word_freq_offsets_;
+    size_t snapshot_term_count_ = 0;
+    // словари документов снимка, построенные GetWordFrequencies
+    mutable std::map<int, std::map<std::string_view, double>>
+        snapshot_word_freq_maps_;
+    std::unique_ptr<std::mutex> snapshot_word_freq_maps_mutex_ =
+        std::make_unique<std::mutex>();
 
     template <typename ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(
-        ExecutionPolicy&& policy, const Query& query,
-        DocumentPredicate document_predicate) const;
+    void FindAllDocuments(ExecutionPolicy&& policy,
+                          const ResolvedQuery& query,
+                          DocumentPredicate document_predicate,
+                          TopDocuments& top_documents) const;
 
-    template <typename ExecutionPolicy>
-    void RemoveDocumentsWithMinusWords(
-        ExecutionPolicy&& policy,
-        ConcurrentMap<int, double>& document_to_relevance,
-        const Query& query) const;
+    template <typename DocumentPredicate>
+    void FindTopDocumentsWand(const ResolvedQuery& query,
+                              DocumentPredicate document_predicate,
+                              TopDocuments& top_documents) const;
 
-    template <typename ExecutionPolicy, typename DocumentPredicate>
-    ConcurrentMap<int, double> CalculateDocumentsRelevance(
-        ExecutionPolicy&& policy, const Query& query,
-        DocumentPredicate document_predicate) const;
+    template <typename DocumentPredicate>
+    void FindTopDocumentsImpact(const ResolvedQuery& query,
+                                DocumentPredicate document_predicate,
+                                TopDocuments& top_documents) const;
+
+    template <typename DocumentPredicate>
+    void FindDocumentsInRange(const std::vector<QueryTerm>& plus_terms,
+                              const std::vector<TermId>& minus_terms,
+                              DocumentPredicate document_predicate,
+                              int first_ordinal, int last_ordinal,
+                              TopDocuments& top_documents) const;
+
+    QueryBatch BuildQueryBatch(const std::vector<ResolvedQuery>& queries) const;
+
+    // Добавляет в top_documents[запрос] документы диапазона
+    // [first_ordinal, last_ordinal), найденные запросами пакета
+    template <typename DocumentPredicate>
+    void FindBatchDocumentsInRange(const QueryBatch& batch,
+                                   DocumentPredicate document_predicate,
+                                   int first_ordinal, int last_ordinal,
+                                   std::vector<TopDocuments>& top_documents)
+        const;
+
+    // Строит частичные индексы документов texts[first, last); документу
+    // texts[i] назначен номер first_ordinal + i
+    PartialIndex BuildPartialIndex(const std::vector<std::string_view>& texts,
+                                   size_t first, size_t last,
+                                   int first_ordinal) const;
+
+    std::vector<TermId> ResolveMinusWords(const Query& query) const;
+
+    ResolvedQuery ResolveQuery(const Query& query) const;
+
+    // Заменяет содержимое terms терминами query, переиспользуя их память
+    void ResolveQuery(const Query& query, ResolvedQuery& terms) const;
+
+    // Сопоставляет слова заново, если набор документов изменился
+    const ResolvedQuery& ResolvePreparedQuery(const PreparedQuery& query,
+                                              ResolvedQuery& resolved) const;
+
+    void AddQueryStatistics(const Query& query,
+                            CorpusStatistics& statistics) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    // Слова подготовленного запроса; ссылаются на строки query
+    static Query GetPreparedQueryWords(const PreparedQuery& query);
+
+    // Документы [first_ordinal, last_ordinal) с минус-словами
+    DocumentSet CollectExcludedDocuments(const std::vector<TermId>& minus_terms,
+                                         int first_ordinal,
+                                         int last_ordinal) const;
+
+    // Счетчики потока, не меньше cell_count; между запросами сбрасываются
+    // только затронутые элементы
+    QueryScratch& GetThreadScratch(size_t cell_count) const;
+
+    const DocumentData& GetDocumentData(int document_id) const;
+
+    // Вызывает function(word, term_freq) для слов документа по алфавиту;
+    // word - строка словаря
+    template <typename Function>
+    void ForEachWordFreq(int document_id, Function function) const;
+
+    size_t GetDocumentWordCount(int document_id) const;
+
+    // Строка словаря, равная word, и ее частота в документе
+    std::optional<std::pair<std::string_view, double>> FindWordFreq(
+        int document_id, std::string_view word) const;
+
+    // Слова документа снимка с номером ordinal. Проверяются при обращении:
+    // ссылка на слово вне словаря снимка выбрасывает std::invalid_argument.
+    std::pair<const SnapshotWordFreq*, const SnapshotWordFreq*>
+    GetSnapshotWordFreqs(int ordinal) const;
+
+    bool IsImpactIndexActual() const;
+
+    std::string BuildQueryCacheKey(const Query& query,
+                                   DocumentStatus filter_status,
+                                   ResultPage page) const;
+
+    size_t GetMemoryUsage() const;
+
+    void UpdateDocumentCount();
+
+    // Исключает документ из поиска после пометки или удаления его вхождений
+    void MarkDocumentRemoved(int document_id);
+
+    void CompactIfNeeded();
+
+    double ComputeWordInverseDocumentFreq(TermId term_id) const;
 
     Query ParseQuery(const std::string_view text, bool parallel = false) const;
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(
-        const std::string_view text) const;
+    // Заменяет содержимое query разобранным text, переиспользуя его память
+    void ParseQuery(const std::string_view text, bool parallel,
+                    Query& query) const;
+
+    // Заменяет содержимое words словами text без стоп-слов; false, если
+    // text содержит недопустимые символы
+    bool SplitIntoWordsNoStop(const std::string_view text,
+                              std::vector<std::string_view>& words) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
@@ -119,17 +521,56 @@ class SearchServer {
 
     static bool IsValidChars(const std::string_view word);
 
-    template <typename Collection>
-    static std::set<std::string, std::less<>> InitStopWords(
-        const Collection& stop_words);
 
     template <typename T>
     static void RemoveDuplicates(std::vector<T>& vec);
 };
 
+struct SearchServer::Compaction {
+    uint64_t index_version;
+    InvertedIndex index;
+    StringArena texts;
+    std::vector<DocumentData> documents;
+    std::map<int, int> document_ordinals;
+    std::map<int, std::map<std::string_view, double>> document_to_word_freqs;
+};
+
+class SearchServer::QueryScratch {
+   private:
+    friend class SearchServer;
+
+    enum DocumentState : uint8_t { UNSEEN, MATCHED, EXCLUDED };
+
+    Query query_;
+    ResolvedQuery terms_;
+    PostingCursor cursor_;
+    // по порядковым номерам документов
+    std::vector<double> relevances_;
+    std::vector<uint8_t> states_;
+    // документы, состояние которых отлично от UNSEEN
+    std::vector<int> touched_ordinals_;
+    TopDocuments top_documents_{0};
+};
+
+// Запрос, разобранный и сопоставленный со словарем заранее. После
+// изменения документов слова сопоставляются заново при каждом выполнении.
+class SearchServer::PreparedQuery {
+   public:
+    // Поколение индекса, по которому подготовлен запрос
+    uint64_t GetIndexVersion() const;
+
+   private:
+    friend class SearchServer;
+
+    std::vector<std::string> plus_words_;
+    std::vector<std::string> minus_words_;
+    ResolvedQuery terms_;
+    uint64_t index_version_ = 0;
+};
+
 template <typename Collection>
-SearchServer::SearchServer(const Collection& stop_words)
-    : stop_words_(InitStopWords(stop_words)) {
+SearchServer::SearchServer(const Collection& stop_words, IndexLayout layout)
+    : stop_words_(stop_words), index_(layout) {
     using namespace std::string_literals;
 
     if (!all_of(stop_words.begin(), stop_words.end(), IsValidChars)) {
@@ -137,144 +578,904 @@ SearchServer::SearchServer(const Collection& stop_words)
     }
 }
 
+template <size_t N, size_t TableScale>
+SearchServer::SearchServer(
+    const StaticStopWordSet<N, TableScale>& stop_words, IndexLayout layout)
+    : stop_words_(stop_words), index_(layout) {}
+
+template <typename ExecutionPolicy>
+IngestionStatistics SearchServer::AddDocuments(
+    ExecutionPolicy&& policy, const std::vector<NewDocument>& documents) {
+    const auto start_time = std::chrono::steady_clock::now();
+    ValidateNewDocuments(documents);
+    index_.InstallCompletedMerge();
+
+    IngestionStatistics statistics;
+    statistics.document_count = documents.size();
+    const int first_ordinal = static_cast<int>(documents_.size());
+    std::vector<std::string_view> texts;
+    texts.reserve(documents.size());
+    for (const NewDocument& document : documents) {
+        texts.push_back(texts_.Add(document.text));
+        statistics.byte_count += document.text.size();
+    }
+
+    size_t chunk_count = 1;
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>,
+                                  std::execution::sequenced_policy>) {
+        chunk_count = std::clamp<size_t>(
+            documents.size() / MIN_INGESTION_CHUNK_SIZE, 1,
+            std::max(1u, std::thread::hardware_concurrency()) * 4);
+    }
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    std::vector<PartialIndex> partial_indexes(chunk_count);
+    const auto chunk_begin = [&](size_t chunk) {
+        return documents.size() * chunk / chunk_count;
+    };
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        partial_indexes[chunk] =
+            BuildPartialIndex(texts, chunk_begin(chunk),
+                              chunk_begin(chunk + 1), first_ordinal);
+    });
+
+    // Пакет образует отдельный сегмент индекса
+    std::vector<std::pair<TermId, std::vector<const std::vector<Posting>*>>>
+        term_postings;
+    std::unordered_map<TermId, size_t> term_positions;
+    for (const PartialIndex& partial_index : partial_indexes) {
+        for (const auto& [word, postings] : partial_index.postings) {
+            const TermId term_id = index_.AddTerm(word);
+            const auto [it, inserted] =
+                term_positions.emplace(term_id, term_postings.size());
+            if (inserted) {
+                term_postings.push_back({term_id, {}});
+            }
+            term_postings[it->second].second.push_back(&postings);
+        }
+    }
+    std::sort(policy, term_postings.begin(), term_postings.end());
+    IndexSegment segment(index_.GetLayout(), 0);
+    if (index_.GetLayout() == IndexLayout::COMPRESSED) {
+        std::vector<CompressedPostingList> posting_lists(term_postings.size());
+        std::transform(
+            policy, term_postings.begin(), term_postings.end(),
+            posting_lists.begin(), [](const auto& term) {
+                CompressedPostingList posting_list;
+                for (const std::vector<Posting>* postings : term.second) {
+                    for (const auto& [document_id, term_freq] : *postings) {
+                        posting_list.Add(document_id, term_freq);
+                    }
+                }
+                return posting_list;
+            });
+        for (size_t i = 0; i < term_postings.size(); ++i) {
+            segment.AddPostingList(term_postings[i].first,
+                                   std::move(posting_lists[i]));
+        }
+    } else {
+        std::vector<Posting> posting_list;
+        for (const auto& [term_id, postings] : term_postings) {
+            posting_list.clear();
+            for (const std::vector<Posting>* part : postings) {
+                posting_list.insert(posting_list.end(), part->begin(),
+                                    part->end());
+            }
+            segment.AddPostingList(term_id, posting_list);
+        }
+    }
+    index_.AddSegment(std::move(segment));
+
+    // ключи прямого индекса переводятся на строки словаря
+    std::vector<std::map<std::string_view, double>> word_freqs(
+        documents.size());
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        for (size_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+            for (const auto& [word, term_freq] :
+                 partial_indexes[chunk].word_freqs[i - chunk_begin(chunk)]) {
+                word_freqs[i].emplace_hint(
+                    word_freqs[i].end(), index_.GetTerm(*index_.FindTerm(word)),
+                    term_freq);
+            }
+        }
+    });
+
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const NewDocument& document = documents[i];
+        document_ids_.insert(document.id);
+        document_ordinals_[document.id] = first_ordinal + static_cast<int>(i);
+        documents_.push_back({document.id,
+                              ComputeAverageRating(document.ratings),
+                              document.status, texts[i]});
+        document_to_word_freqs_[document.id] = std::move(word_freqs[i]);
+    }
+    UpdateDocumentCount();
+
+    statistics.seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start_time)
+                             .count();
+    return statistics;
+}
+
 template <typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
+    index_.InstallCompletedMerge();
     if (document_ids_.count(document_id) == 0) {
         return;
     }
 
-    std::vector<std::string_view> document_words;
-    document_words.reserve(document_to_word_freqs_.at(document_id).size());
-    std::for_each(
-        policy, document_to_word_freqs_.at(document_id).begin(),
-        document_to_word_freqs_.at(document_id).end(),
-        [&](const std::string_view word) { document_words.push_back(word); });
+    std::vector<TermId> term_ids;
+    ForEachWordFreq(document_id, [&](std::string_view word, double) {
+        term_ids.push_back(*index_.FindTerm(word));
+    });
 
-    std::for_each(policy, document_words.begin(), document_words.end(),
-                  [&](const std::string_view word) -> void {
-                      word_to_document_freqs_.at(word).erase(document_id);
-                  });
+    // слова документа различны, поэтому каждое слово меняется одним потоком
+    std::for_each(policy, term_ids.begin(), term_ids.end(),
+                  [&](TermId term_id) { index_.TombstonePosting(term_id); });
+    for (const TermId term_id : term_ids) {
+        index_.RemoveTermIfEmpty(term_id);
+    }
 
-    document_ids_.erase(document_id);
-    document_to_word_freqs_.erase(document_id);
-    documents_data_.erase(document_id);
+    MarkDocumentRemoved(document_id);
+    CompactIfNeeded();
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocuments(ExecutionPolicy&& policy,
+                                   const std::vector<int>& document_ids) {
+    index_.InstallCompletedMerge();
+    std::vector<int> ids;
+    ids.reserve(document_ids.size());
+    std::copy_if(
+        document_ids.begin(), document_ids.end(), std::back_inserter(ids),
+        [this](int document_id) { return document_ids_.count(document_id); });
+    RemoveDuplicates(ids);
+
+    // пары (слово, номер документа) всех удаляемых вхождений; каждый
+    // документ заполняет свой участок массива
+    std::vector<size_t> offsets(ids.size() + 1);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        offsets[i + 1] = offsets[i] + GetDocumentWordCount(ids[i]);
+    }
+    std::vector<std::pair<TermId, int>> postings(offsets.back());
+    std::vector<size_t> indexes(ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t i) {
+        const int ordinal = document_ordinals_.at(ids[i]);
+        size_t position = offsets[i];
+        ForEachWordFreq(ids[i], [&](std::string_view word, double) {
+            postings[position++] = {*index_.FindTerm(word), ordinal};
+        });
+    });
+    std::sort(policy, postings.begin(), postings.end());
+
+    std::vector<int> ordinals(postings.size());
+    std::transform(policy, postings.begin(), postings.end(), ordinals.begin(),
+                   [](const auto& posting) { return posting.second; });
+    std::vector<size_t> term_begins;
+    for (size_t i = 0; i < postings.size(); ++i) {
+        if (i == 0 || postings[i].first != postings[i - 1].first) {
+            term_begins.push_back(i);
+        }
+    }
+    term_begins.push_back(postings.size());
+    std::vector<size_t> terms(term_begins.size() - 1);
+    std::iota(terms.begin(), terms.end(), 0);
+    index_.DiscountBufferPostings(std::transform_reduce(
+        policy, terms.begin(), terms.end(), size_t{0}, std::plus<>{},
+        [&](size_t term) {
+            return index_.ErasePostings(
+                postings[term_begins[term]].first,
+                ordinals.data() + term_begins[term],
+                term_begins[term + 1] - term_begins[term]);
+        }));
+
+    for (const size_t term : terms) {
+        index_.RemoveTermIfEmpty(postings[term_begins[term]].first);
+    }
+    for (const int document_id : ids) {
+        MarkDocumentRemoved(document_id);
+    }
+    CompactIfNeeded();
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(
+    ExecutionPolicy&& policy, const std::string_view raw_query,
+    DocumentPredicate document_predicate, ResultPage page) const {
+    return FindTopDocuments(policy, ResolveQuery(ParseQuery(raw_query)),
+                            document_predicate, page);
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(
     ExecutionPolicy&& policy, const std::string_view raw_query,
-    DocumentPredicate document_predicate) const {
-    std::vector<Document> matched_documents =
-        FindAllDocuments(policy, ParseQuery(raw_query), document_predicate);
-    sort(policy, matched_documents.begin(), matched_documents.end(),
-         [](const Document& lhs, const Document& rhs) -> bool {
-             const double EPS = 10e-6;
-             if (std::abs(lhs.relevance - rhs.relevance) < EPS) {
-                 return lhs.rating > rhs.rating;
-             } else {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
-
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-
-    return matched_documents;
+    const CorpusStatistics& statistics, DocumentPredicate document_predicate,
+    ResultPage page) const {
+    Query query = ParseQuery(raw_query);
+    query.statistics = &statistics;
+    return FindTopDocuments(policy, ResolveQuery(query), document_predicate,
+                            page);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(
+    ExecutionPolicy&& policy, const PreparedQuery& query,
+    const CorpusStatistics& statistics, DocumentPredicate document_predicate,
+    ResultPage page) const {
+    Query words = GetPreparedQueryWords(query);
+    words.statistics = &statistics;
+    return FindTopDocuments(policy, ResolveQuery(words), document_predicate,
+                            page);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(
+    ExecutionPolicy&& policy, const ResolvedQuery& query,
+    DocumentPredicate document_predicate, ResultPage page) const {
+    const size_t top_count = page.size > SIZE_MAX - page.offset
+                                 ? SIZE_MAX
+                                 : page.offset + page.size;
+    if (top_count == 0) {
+        return {};
+    }
+
+    TopDocuments top_documents(top_count);
+    if (retrieval_engine_ == RetrievalEngine::WAND) {
+        FindTopDocumentsWand(query, document_predicate, top_documents);
+    } else if (retrieval_engine_ == RetrievalEngine::IMPACT &&
+               !query.corpus_idf && IsImpactIndexActual()) {
+        FindTopDocumentsImpact(query, document_predicate, top_documents);
+    } else {
+        FindAllDocuments(policy, query, document_predicate, top_documents);
+    }
+
+    return top_documents.Extract(page.offset);
 }
 
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(
-    const std::string_view raw_query,
-    DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    const std::string_view raw_query, DocumentPredicate document_predicate,
+    ResultPage page) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate,
+                            page);
 }
 
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(
     ExecutionPolicy&& policy, const std::string_view raw_query,
-    DocumentStatus filter_status) const {
+    DocumentStatus filter_status, ResultPage page) const {
     auto document_predicate = [filter_status](
                                   [[maybe_unused]] const int id,
                                   [[maybe_unused]] const DocumentStatus status,
                                   [[maybe_unused]] const int rating) {
         return status == filter_status;
     };
-    return FindTopDocuments(policy, raw_query, document_predicate);
+    if (!query_cache_) {
+        return FindTopDocuments(policy, raw_query, document_predicate, page);
+    }
+
+    const Query query = ParseQuery(raw_query);
+    std::string key = BuildQueryCacheKey(query, filter_status, page);
+    if (std::optional<std::vector<Document>> documents =
+            query_cache_->Find(key, index_version_)) {
+        return std::move(*documents);
+    }
+    std::vector<Document> documents =
+        FindTopDocuments(policy, ResolveQuery(query), document_predicate, page);
+    query_cache_->Insert(std::move(key), index_version_, documents);
+    return documents;
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(
-    ExecutionPolicy&& policy, const Query& query,
-    DocumentPredicate document_predicate) const {
-    std::vector<Document> relevant_documents;
-
-    ConcurrentMap<int, double> document_to_relevance =
-        CalculateDocumentsRelevance(policy, query, document_predicate);
-    RemoveDocumentsWithMinusWords(policy, document_to_relevance, query);
-    std::map<int, double> document_to_relevance_map =
-        document_to_relevance.BuildMap();
-    relevant_documents.reserve(document_to_relevance_map.size());
-    for (const auto& [id, relevance] : document_to_relevance_map) {
-        relevant_documents.push_back(
-            Document(id, relevance, documents_data_.at(id).rating));
-    }
-
-    return relevant_documents;
+std::vector<Document> SearchServer::FindTopDocuments(
+    ExecutionPolicy&& policy, const PreparedQuery& query,
+    DocumentPredicate document_predicate, ResultPage page) const {
+    ResolvedQuery resolved;
+    return FindTopDocuments(policy, ResolvePreparedQuery(query, resolved),
+                            document_predicate, page);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(
+    const PreparedQuery& query, DocumentPredicate document_predicate,
+    ResultPage page) const {
+    return FindTopDocuments(std::execution::seq, query, document_predicate,
+                            page);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(
+    ExecutionPolicy&& policy, const PreparedQuery& query,
+    DocumentStatus filter_status, ResultPage page) const {
+    return FindTopDocuments(
+        policy, query,
+        [filter_status]([[maybe_unused]] const int id,
+                        [[maybe_unused]] const DocumentStatus status,
+                        [[maybe_unused]] const int rating) {
+            return status == filter_status;
+        },
+        page);
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
-ConcurrentMap<int, double> SearchServer::CalculateDocumentsRelevance(
-    ExecutionPolicy&& policy, const Query& query,
-    DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance;
-    for_each(
-        policy, query.plus_words.begin(), query.plus_words.end(),
-        [&](const std::string_view word) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                return;
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(
+    ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries,
+    DocumentPredicate document_predicate, ResultPage page) const {
+    const size_t top_count = page.size > SIZE_MAX - page.offset
+                                 ? SIZE_MAX
+                                 : page.offset + page.size;
+    std::vector<std::vector<Document>> results(raw_queries.size());
+    if (top_count == 0 || raw_queries.empty()) {
+        return results;
+    }
+
+    // исключение из параллельного алгоритма завершило бы программу,
+    // поэтому запросы разбираются последовательно
+    std::vector<ResolvedQuery> queries;
+    queries.reserve(raw_queries.size());
+    for (const std::string& raw_query : raw_queries) {
+        queries.push_back(ResolveQuery(ParseQuery(raw_query)));
+    }
+    const QueryBatch batch = BuildQueryBatch(queries);
+    const size_t document_count = documents_.size();
+
+    size_t chunk_count = 1;
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>,
+                                  std::execution::sequenced_policy>) {
+        chunk_count = std::clamp<size_t>(
+            document_count / MIN_PARALLEL_CHUNK_SIZE, 1,
+            std::max(1u, std::thread::hardware_concurrency()) * 4);
+    }
+
+    // диапазоны документов независимы, как в FindAllDocuments; каждый
+    // список вхождений по-прежнему просматривается один раз
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    std::vector<std::vector<TopDocuments>> chunk_top_documents(
+        chunk_count,
+        std::vector<TopDocuments>(queries.size(), TopDocuments(top_count)));
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        FindBatchDocumentsInRange(
+            batch, document_predicate,
+            static_cast<int>(document_count * chunk / chunk_count),
+            static_cast<int>(document_count * (chunk + 1) / chunk_count),
+            chunk_top_documents[chunk]);
+    });
+
+    for (size_t query = 0; query < queries.size(); ++query) {
+        if (chunk_count == 1) {
+            results[query] = chunk_top_documents[0][query].Extract(page.offset);
+            continue;
+        }
+        TopDocuments top_documents(top_count);
+        for (std::vector<TopDocuments>& chunk_top : chunk_top_documents) {
+            for (const Document& document : chunk_top[query].Extract(0)) {
+                top_documents.Add(document);
             }
-            double word_idf = ComputeWordInverseDocumentFreq(word);
-            for (const auto& [id, word_tf] : word_to_document_freqs_.at(word)) {
-                const DocumentData& document = documents_data_.at(id);
-                if (document_predicate(id, document.status, document.rating)) {
-                    document_to_relevance[id].ref_to_value +=
-                        word_idf * word_tf;
-                }
+        }
+        results[query] = top_documents.Extract(page.offset);
+    }
+    return results;
+}
+
+template <typename ExecutionPolicy>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(
+    ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries,
+    DocumentStatus filter_status, ResultPage page) const {
+    return FindTopDocumentsBatch(
+        policy, raw_queries,
+        [filter_status]([[maybe_unused]] const int id,
+                        [[maybe_unused]] const DocumentStatus status,
+                        [[maybe_unused]] const int rating) {
+            return status == filter_status;
+        },
+        page);
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindBatchDocumentsInRange(
+    const QueryBatch& batch, DocumentPredicate document_predicate,
+    int first_ordinal, int last_ordinal,
+    std::vector<TopDocuments>& top_documents) const {
+    if (first_ordinal >= last_ordinal) {
+        return;
+    }
+    // счетчик запроса query для документа window_begin + offset -
+    // cells[offset * query_count + query]
+    const size_t query_count = batch.query_count;
+    const int window_size = static_cast<int>(std::clamp<size_t>(
+        BATCH_WINDOW_CELL_COUNT / query_count, 1,
+        static_cast<size_t>(last_ordinal - first_ordinal)));
+    QueryScratch& scratch = GetThreadScratch(window_size * query_count);
+    std::vector<double>& relevances = scratch.relevances_;
+    std::vector<uint8_t>& states = scratch.states_;
+    std::vector<int>& touched_cells = scratch.touched_ordinals_;
+
+    // каждый список вхождений просматривается один раз; окно обходит только
+    // курсоры с вхождениями в нем, в порядке слов
+    std::deque<PostingCursor> plus_cursors;
+    for (const TermId term_id : batch.plus_terms) {
+        plus_cursors.emplace_back(index_, term_id).NextGeq(first_ordinal);
+    }
+    std::deque<PostingCursor> minus_cursors;
+    for (const TermId term_id : batch.minus_terms) {
+        minus_cursors.emplace_back(index_, term_id).NextGeq(first_ordinal);
+    }
+    const auto make_cursor_heap = [](const std::deque<PostingCursor>& cursors) {
+        std::vector<size_t> heap;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            if (cursors[i].DocumentId() != PostingCursor::END) {
+                heap.push_back(i);
             }
-        });
+        }
+        return heap;
+    };
+    std::vector<size_t> plus_heap = make_cursor_heap(plus_cursors);
+    std::vector<size_t> minus_heap = make_cursor_heap(minus_cursors);
+    const auto later_of = [](const std::deque<PostingCursor>& cursors) {
+        return [cursors = &cursors](size_t lhs, size_t rhs) {
+            return (*cursors)[lhs].DocumentId() >
+                   (*cursors)[rhs].DocumentId();
+        };
+    };
+    std::make_heap(plus_heap.begin(), plus_heap.end(), later_of(plus_cursors));
+    std::make_heap(minus_heap.begin(), minus_heap.end(),
+                   later_of(minus_cursors));
+    std::vector<size_t> window_terms;
+    // обходит курсоры с вхождениями до window_end по возрастанию индекса;
+    // visit сдвигает курсор за окно
+    const auto for_each_window_term = [&window_terms, &later_of](
+                                          std::deque<PostingCursor>& cursors,
+                                          std::vector<size_t>& heap,
+                                          int window_end, auto visit) {
+        const auto later = later_of(cursors);
+        window_terms.clear();
+        while (!heap.empty() &&
+               cursors[heap.front()].DocumentId() < window_end) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            window_terms.push_back(heap.back());
+            heap.pop_back();
+        }
+        std::sort(window_terms.begin(), window_terms.end());
+        for (const size_t i : window_terms) {
+            visit(i, cursors[i]);
+            if (cursors[i].DocumentId() != PostingCursor::END) {
+                heap.push_back(i);
+                std::push_heap(heap.begin(), heap.end(), later);
+            }
+        }
+    };
 
-    return document_to_relevance;
+    for (int window_begin = first_ordinal; window_begin < last_ordinal;
+         window_begin += window_size) {
+        const int window_end =
+            std::min(last_ordinal, window_begin + window_size);
+        for_each_window_term(
+            minus_cursors, minus_heap, window_end,
+            [&](size_t i, PostingCursor& cursor) {
+                for (; cursor.DocumentId() < window_end; cursor.Next()) {
+                    const size_t row =
+                        (cursor.DocumentId() - window_begin) * query_count;
+                    for (size_t j = batch.minus_term_begins[i];
+                         j < batch.minus_term_begins[i + 1]; ++j) {
+                        const size_t cell = row + batch.minus_subscribers[j];
+                        if (states[cell] == QueryScratch::UNSEEN) {
+                            touched_cells.push_back(static_cast<int>(cell));
+                        }
+                        states[cell] = QueryScratch::EXCLUDED;
+                    }
+                }
+            });
+        for_each_window_term(
+            plus_cursors, plus_heap, window_end,
+            [&](size_t i, PostingCursor& cursor) {
+                for (; cursor.DocumentId() < window_end; cursor.Next()) {
+                    const size_t row =
+                        (cursor.DocumentId() - window_begin) * query_count;
+                    const double term_freq = cursor.TermFreq();
+                    for (size_t j = batch.plus_term_begins[i];
+                         j < batch.plus_term_begins[i + 1]; ++j) {
+                        const auto& [query, idf] = batch.plus_subscribers[j];
+                        const size_t cell = row + query;
+                        if (states[cell] == QueryScratch::EXCLUDED) {
+                            continue;
+                        }
+                        if (states[cell] == QueryScratch::UNSEEN) {
+                            touched_cells.push_back(static_cast<int>(cell));
+                            states[cell] = QueryScratch::MATCHED;
+                        }
+                        relevances[cell] += idf * term_freq;
+                    }
+                }
+            });
+
+        for (const int cell : touched_cells) {
+            if (states[cell] != QueryScratch::MATCHED) {
+                continue;
+            }
+            const DocumentData& document =
+                documents_[window_begin + cell / query_count];
+            if (!document.removed &&
+                document_predicate(document.id, document.status,
+                                   document.rating)) {
+                top_documents[cell % query_count].Add(
+                    Document(document.id, relevances[cell], document.rating));
+            }
+        }
+        for (const int cell : touched_cells) {
+            relevances[cell] = 0.0;
+            states[cell] = QueryScratch::UNSEEN;
+        }
+        touched_cells.clear();
+    }
 }
 
 template <typename ExecutionPolicy>
-void SearchServer::RemoveDocumentsWithMinusWords(
-    ExecutionPolicy&& policy, ConcurrentMap<int, double>& document_to_relevance,
-    const Query& query) const {
-    for_each(policy, query.minus_words.begin(), query.minus_words.end(),
-             [&](const std::string_view word) {
-                 if (word_to_document_freqs_.count(word) == 0) {
-                     return;
-                 }
-
-                 for (const auto& [document_id, _] :
-                      word_to_document_freqs_.at(word)) {
-                     document_to_relevance.erase(document_id);
-                 }
-             });
+std::tuple<std::vector<std::string_view>, DocumentStatus>
+SearchServer::MatchDocument([[maybe_unused]] ExecutionPolicy&& policy,
+                            const PreparedQuery& query,
+                            int document_id) const {
+    return MatchDocument(query, document_id);
 }
 
-template <typename Collection>
-std::set<std::string, std::less<>> SearchServer::InitStopWords(
-    const Collection& stop_words) {
-    std::set<std::string, std::less<>> stop_words_set;
-    for (const std::string_view word : stop_words) {
-        if (!word.empty()) {
-            stop_words_set.insert(std::string(word));
+template <typename ExecutionPolicy, typename DocumentPredicate>
+void SearchServer::FindAllDocuments(ExecutionPolicy&& policy,
+                                    const ResolvedQuery& query,
+                                    DocumentPredicate document_predicate,
+                                    TopDocuments& top_documents) const {
+    const std::vector<QueryTerm>& plus_terms = query.plus_terms;
+    const std::vector<TermId>& minus_terms = query.minus_terms;
+    const size_t document_count = documents_.size();
+
+    size_t chunk_count = 1;
+    if constexpr (!std::is_same_v<std::decay_t<ExecutionPolicy>,
+                                  std::execution::sequenced_policy>) {
+        chunk_count = std::clamp<size_t>(
+            document_count / MIN_PARALLEL_CHUNK_SIZE, 1,
+            std::max(1u, std::thread::hardware_concurrency()) * 4);
+    }
+    if (chunk_count == 1) {
+        FindDocumentsInRange(plus_terms, minus_terms, document_predicate, 0,
+                             static_cast<int>(document_count), top_documents);
+        return;
+    }
+
+    // у каждого диапазона свои счетчики и куча
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    std::vector<TopDocuments> chunk_top_documents(
+        chunk_count, TopDocuments(top_documents.GetCapacity()));
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        FindDocumentsInRange(
+            plus_terms, minus_terms, document_predicate,
+            static_cast<int>(document_count * chunk / chunk_count),
+            static_cast<int>(document_count * (chunk + 1) / chunk_count),
+            chunk_top_documents[chunk]);
+    });
+
+    for (TopDocuments& chunk_top : chunk_top_documents) {
+        for (const Document& document : chunk_top.Extract(0)) {
+            top_documents.Add(document);
+        }
+    }
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindDocumentsInRange(
+    const std::vector<QueryTerm>& plus_terms,
+    const std::vector<TermId>& minus_terms,
+    DocumentPredicate document_predicate, int first_ordinal, int last_ordinal,
+    TopDocuments& top_documents) const {
+    // диапазоны параллельного поиска не пересекаются, а у каждого потока
+    // свои счетчики, поэтому индексы по абсолютным номерам не конфликтуют
+    QueryScratch& scratch = GetThreadScratch(documents_.size());
+    std::vector<double>& relevances = scratch.relevances_;
+    std::vector<uint8_t>& states = scratch.states_;
+    std::vector<int>& touched_ordinals = scratch.touched_ordinals_;
+    for (const TermId term_id : minus_terms) {
+        PostingCursor cursor(index_, term_id);
+        for (cursor.NextGeq(first_ordinal); cursor.DocumentId() < last_ordinal;
+             cursor.Next()) {
+            uint8_t& state = states[cursor.DocumentId()];
+            if (state == QueryScratch::UNSEEN) {
+                touched_ordinals.push_back(cursor.DocumentId());
+            }
+            state = QueryScratch::EXCLUDED;
+        }
+    }
+    for (const auto& [term_id, idf] : plus_terms) {
+        PostingCursor cursor(index_, term_id);
+        for (cursor.NextGeq(first_ordinal); cursor.DocumentId() < last_ordinal;
+             cursor.Next()) {
+            const int ordinal = cursor.DocumentId();
+            uint8_t& state = states[ordinal];
+            if (state == QueryScratch::EXCLUDED) {
+                continue;
+            }
+            if (state == QueryScratch::UNSEEN) {
+                touched_ordinals.push_back(ordinal);
+                state = QueryScratch::MATCHED;
+            }
+            relevances[ordinal] += idf * cursor.TermFreq();
+        }
+    }
+
+    for (const int ordinal : touched_ordinals) {
+        if (states[ordinal] != QueryScratch::MATCHED) {
+            continue;
+        }
+        const DocumentData& document = documents_[ordinal];
+        if (!document.removed &&
+            document_predicate(document.id, document.status, document.rating)) {
+            top_documents.Add(
+                Document(document.id, relevances[ordinal], document.rating));
+        }
+    }
+    for (const int ordinal : touched_ordinals) {
+        relevances[ordinal] = 0.0;
+        states[ordinal] = QueryScratch::UNSEEN;
+    }
+    touched_ordinals.clear();
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindTopDocumentsWand(const ResolvedQuery& query,
+                                        DocumentPredicate document_predicate,
+                                        TopDocuments& top_documents) const {
+    struct WandTerm {
+        PostingCursor* cursor;
+        double idf;
+    };
+
+    std::deque<PostingCursor> cursors;
+    std::vector<WandTerm> terms;
+    for (const auto& [term_id, idf] : query.plus_terms) {
+        cursors.emplace_back(index_, term_id);
+        terms.push_back({&cursors.back(), idf});
+    }
+    const DocumentSet excluded_documents = CollectExcludedDocuments(
+        query.minus_terms, 0, static_cast<int>(documents_.size()));
+
+    const auto by_document = [](const WandTerm& lhs, const WandTerm& rhs) {
+        return lhs.cursor->DocumentId() < rhs.cursor->DocumentId();
+    };
+    // число первых курсоров, сдвинутых на предыдущем шаге
+    size_t moved_count = terms.size();
+    while (true) {
+        // остальные курсоры уже упорядочены: сортируем сдвинутые и сливаем
+        std::sort(terms.begin(), terms.begin() + moved_count, by_document);
+        std::inplace_merge(terms.begin(), terms.begin() + moved_count,
+                           terms.end(), by_document);
+        // запас в 2 * RELEVANCE_EPSILON сохраняет документы, которые при
+        // равной релевантности могут обойти худший документ по рейтингу
+        const double threshold =
+            top_documents.IsFull()
+                ? top_documents.GetMinRelevance() - 2 * RELEVANCE_EPSILON
+                : -std::numeric_limits<double>::infinity();
+
+        size_t pivot = 0;
+        double upper_bound = 0.0;
+        for (; pivot < terms.size(); ++pivot) {
+            if (terms[pivot].cursor->DocumentId() == PostingCursor::END) {
+                pivot = terms.size();
+                break;
+            }
+            upper_bound +=
+                terms[pivot].idf * terms[pivot].cursor->GetMaxTermFreq();
+            if (upper_bound > threshold) {
+                break;
+            }
+        }
+        if (pivot == terms.size()) {
+            break;
+        }
+
+        const int pivot_id = terms[pivot].cursor->DocumentId();
+        while (pivot + 1 < terms.size() &&
+               terms[pivot + 1].cursor->DocumentId() == pivot_id) {
+            ++pivot;
+        }
+        // исключенный или удаленный документ пропускается до подсчета
+        // оценок и релевантности
+        if (documents_[pivot_id].removed ||
+            excluded_documents.Contains(pivot_id)) {
+            for (size_t i = 0; i <= pivot; ++i) {
+                terms[i].cursor->NextGeq(pivot_id + 1);
+            }
+            moved_count = pivot + 1;
+            continue;
+        }
+
+        double block_upper_bound = 0.0;
+        for (size_t i = 0; i <= pivot; ++i) {
+            terms[i].cursor->ShallowNextGeq(pivot_id);
+            block_upper_bound +=
+                terms[i].idf * terms[i].cursor->GetBlockMaxTermFreq();
+        }
+        if (block_upper_bound <= threshold) {
+            int next_id = pivot + 1 < terms.size()
+                              ? terms[pivot + 1].cursor->DocumentId()
+                              : PostingCursor::END;
+            for (size_t i = 0; i <= pivot; ++i) {
+                const int block_last_id =
+                    terms[i].cursor->GetBlockLastDocumentId();
+                if (block_last_id < next_id) {
+                    next_id = block_last_id + 1;
+                }
+            }
+            for (size_t i = 0; i <= pivot; ++i) {
+                terms[i].cursor->NextGeq(next_id);
+            }
+            moved_count = pivot + 1;
+            continue;
+        }
+
+        if (terms[0].cursor->DocumentId() != pivot_id) {
+            for (size_t i = 0; i < pivot; ++i) {
+                terms[i].cursor->NextGeq(pivot_id);
+            }
+            moved_count = pivot;
+            continue;
+        }
+
+        double relevance = 0.0;
+        for (size_t i = 0; i <= pivot; ++i) {
+            relevance += terms[i].idf * terms[i].cursor->TermFreq();
+            terms[i].cursor->Next();
+        }
+        moved_count = pivot + 1;
+        const DocumentData& document = documents_[pivot_id];
+        if (document_predicate(document.id, document.status,
+                               document.rating)) {
+            top_documents.Add(
+                Document(document.id, relevance, document.rating));
+        }
+    }
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindTopDocumentsImpact(const ResolvedQuery& query,
+                                          DocumentPredicate document_predicate,
+                                          TopDocuments& top_documents) const {
+    struct ImpactSegment {
+        const ImpactIndex::Segment* segment;
+        size_t term_index;
+    };
+
+    const std::vector<QueryTerm>& plus_terms = query.plus_terms;
+    // вклады - целые числа, поэтому их суммы в relevances_ точны;
+    // MATCHED означает кандидата, EXCLUDED - отвергнутый документ
+    QueryScratch& scratch = GetThreadScratch(documents_.size());
+    std::vector<double>& scores = scratch.relevances_;
+    std::vector<uint8_t>& states = scratch.states_;
+    std::vector<int>& touched_ordinals = scratch.touched_ordinals_;
+    for (const TermId term_id : query.minus_terms) {
+        PostingCursor cursor(index_, term_id);
+        for (; cursor.DocumentId() != PostingCursor::END; cursor.Next()) {
+            uint8_t& state = states[cursor.DocumentId()];
+            if (state == QueryScratch::UNSEEN) {
+                touched_ordinals.push_back(cursor.DocumentId());
+                state = QueryScratch::EXCLUDED;
+            }
+        }
+    }
+
+    // сегменты всех слов запроса по убыванию вклада; next_impacts хранит
+    // вклад первого необработанного сегмента каждого слова
+    std::vector<ImpactSegment> segments;
+    std::vector<uint32_t> next_impacts(plus_terms.size());
+    for (size_t i = 0; i < plus_terms.size(); ++i) {
+        const auto& term_segments =
+            impact_index_.GetSegments(plus_terms[i].term_id);
+        for (const ImpactIndex::Segment& segment : term_segments) {
+            segments.push_back({&segment, i});
+        }
+        if (!term_segments.empty()) {
+            next_impacts[i] = term_segments.front().impact;
+        }
+    }
+    std::stable_sort(segments.begin(), segments.end(),
+                     [](const ImpactSegment& lhs, const ImpactSegment& rhs) {
+                         return lhs.segment->impact > rhs.segment->impact;
+                     });
+
+    const size_t top_count = top_documents.GetCapacity();
+    std::vector<int> candidates;
+    // верхняя оценка вклада, который еще может получить любой документ
+    uint32_t remaining_bound =
+        std::accumulate(next_impacts.begin(), next_impacts.end(), 0u);
+    uint32_t checked_bound = remaining_bound;
+    const auto by_score = [&scores](int lhs, int rhs) {
+        return scores[lhs] > scores[rhs];
+    };
+
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const auto& [segment, term_index] = segments[i];
+        const int* ordinals = impact_index_.GetDocuments(*segment);
+        for (uint32_t j = 0; j < segment->end - segment->begin; ++j) {
+            const int ordinal = ordinals[j];
+            if (states[ordinal] == QueryScratch::UNSEEN) {
+                const DocumentData& document = documents_[ordinal];
+                const bool accepted =
+                    !document.removed &&
+                    document_predicate(document.id, document.status,
+                                       document.rating);
+                touched_ordinals.push_back(ordinal);
+                states[ordinal] =
+                    accepted ? QueryScratch::MATCHED : QueryScratch::EXCLUDED;
+                if (accepted) {
+                    candidates.push_back(ordinal);
+                }
+            }
+            scores[ordinal] += segment->impact;
+        }
+
+        const auto& term_segments =
+            impact_index_.GetSegments(plus_terms[term_index].term_id);
+        const size_t segment_index = segment - term_segments.data();
+        const uint32_t next_impact =
+            segment_index + 1 < term_segments.size()
+                ? term_segments[segment_index + 1].impact
+                : 0;
+        remaining_bound -= next_impacts[term_index] - next_impact;
+        next_impacts[term_index] = next_impact;
+
+        // проверяем, определился ли состав выдачи, когда оценка оставшегося
+        // вклада уменьшилась вдвое: top_count-й документ должен опережать
+        // следующий и любой непросмотренный больше чем на remaining_bound
+        if (candidates.size() < top_count ||
+            (remaining_bound > checked_bound / 2 && i + 1 < segments.size())) {
+            continue;
+        }
+        checked_bound = remaining_bound;
+        std::nth_element(candidates.begin(), candidates.begin() + top_count - 1,
+                         candidates.end(), by_score);
+        double next_score = 0.0;
+        if (candidates.size() > top_count) {
+            next_score = scores[*std::max_element(
+                candidates.begin() + top_count, candidates.end(), by_score)];
+        }
+        if (scores[candidates[top_count - 1]] > next_score + remaining_bound) {
+            candidates.resize(top_count);
+            break;
         }
     }
 
-    return stop_words_set;
+    // точная релевантность по прямому индексу
+    for (const int ordinal : candidates) {
+        const DocumentData& document = documents_[ordinal];
+        double relevance = 0.0;
+        for (const auto& [term_id, idf] : plus_terms) {
+            if (const auto word_freq =
+                    FindWordFreq(document.id, index_.GetTerm(term_id))) {
+                relevance += idf * word_freq->second;
+            }
+        }
+        top_documents.Add(Document(document.id, relevance, document.rating));
+    }
+    for (const int ordinal : touched_ordinals) {
+        scores[ordinal] = 0.0;
+        states[ordinal] = QueryScratch::UNSEEN;
+    }
+    touched_ordinals.clear();
+}
+
+template <typename Function>
+void SearchServer::ForEachWordFreq(int document_id, Function function) const {
+    if (const auto it = document_to_word_freqs_.find(document_id);
+        it != document_to_word_freqs_.end()) {
+        for (const auto& [word, term_freq] : it->second) {
+            function(word, term_freq);
+        }
+        return;
+    }
+    const auto [begin, end] =
+        GetSnapshotWordFreqs(document_ordinals_.at(document_id));
+    for (const SnapshotWordFreq* word_freq = begin; word_freq != end;
+         ++word_freq) {
+        function(index_.GetTerm(word_freq->term_id), word_freq->term_freq);
+    }
 }
 
 template <typename T>
@@ -0,0 +1,229 @@
+#include "shard_coordinator.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+#include "shard_protocol.h"
+#include "top_documents.h"
+
+using namespace std;
+
+bool DistributedSearchResult::IsPartial() const {
+    return responded_shard_count < shard_count;
+}
+
+ShardCoordinator::ShardCoordinator(vector<string> addresses,
+                                   chrono::milliseconds timeout)
+    : timeout_(timeout) {
+    for (string& address : addresses) {
+        shards_.push_back({move(address), -1, {}});
+    }
+}
+
+ShardCoordinator::~ShardCoordinator() {
+    for (ShardConnection& shard : shards_) {
+        Disconnect(shard);
+    }
+}
+
+size_t ShardCoordinator::GetShardCount() const { return shards_.size(); }
+
+DistributedSearchResult ShardCoordinator::FindTopDocuments(
+    const string_view raw_query, DocumentStatus filter_status,
+    ResultPage page) {
+    const size_t top_count = page.size > SIZE_MAX - page.offset
+                                 ? SIZE_MAX
+                                 : page.offset + page.size;
+    // ответ ERROR означает некорректный запрос; ответ другого вида или
+    // ERROR без текста ошибки считается отсутствием ответа
+    const auto open_response = [this](size_t shard,
+                                      const optional<string>& response,
+                                      ShardMessageType expected_type)
+        -> optional<MessageReader> {
+        if (!response) {
+            return nullopt;
+        }
+        MessageReader reader(*response);
+        if (reader.GetType() == ShardMessageType::ERROR) {
+            string error;
+            try {
+                error = reader.ReadString();
+            } catch (const invalid_argument&) {
+                Disconnect(shards_[shard]);
+                return nullopt;
+            }
+            throw invalid_argument(error);
+        }
+        if (reader.GetType() != expected_type) {
+            return nullopt;
+        }
+        return reader;
+    };
+
+    MessageWriter statistics_request(ShardMessageType::STATISTICS_REQUEST);
+    statistics_request.WriteString(raw_query);
+    const vector<optional<string>> statistics_responses = Exchange(
+        vector<string>(shards_.size(), statistics_request.GetMessage()));
+
+    // слова статистики ссылаются на ответы шардов
+    CorpusStatistics statistics;
+    vector<bool> responded(shards_.size(), false);
+    for (size_t shard = 0; shard < shards_.size(); ++shard) {
+        optional<MessageReader> reader =
+            open_response(shard, statistics_responses[shard],
+                          ShardMessageType::STATISTICS_RESPONSE);
+        if (!reader) {
+            continue;
+        }
+        try {
+            const CorpusStatistics shard_statistics =
+                ReadCorpusStatistics(*reader);
+            statistics.document_count += shard_statistics.document_count;
+            for (const auto& [word, document_freq] :
+                 shard_statistics.document_freqs) {
+                statistics.document_freqs[word] += document_freq;
+            }
+            responded[shard] = true;
+        } catch (const invalid_argument&) {
+            Disconnect(shards_[shard]);
+        }
+    }
+
+    MessageWriter search_request(ShardMessageType::SEARCH_REQUEST);
+    search_request.WriteString(raw_query);
+    search_request.WriteUint32(static_cast<uint32_t>(filter_status));
+    search_request.WriteUint64(top_count);
+    WriteCorpusStatistics(search_request, statistics);
+    vector<string> search_requests(shards_.size());
+    for (size_t shard = 0; shard < shards_.size(); ++shard) {
+        if (responded[shard]) {
+            search_requests[shard] = search_request.GetMessage();
+        }
+    }
+    const vector<optional<string>> search_responses = Exchange(search_requests);
+
+    DistributedSearchResult result;
+    result.shard_count = shards_.size();
+    TopDocuments top_documents(top_count);
+    for (size_t shard = 0; shard < shards_.size(); ++shard) {
+        optional<MessageReader> reader =
+            open_response(shard, search_responses[shard],
+                          ShardMessageType::SEARCH_RESPONSE);
+        if (!reader) {
+            continue;
+        }
+        try {
+            for (const Document& document : ReadDocuments(*reader)) {
+                top_documents.Add(document);
+            }
+            ++result.responded_shard_count;
+        } catch (const invalid_argument&) {
+            Disconnect(shards_[shard]);
+        }
+    }
+    result.documents = top_documents.Extract(page.offset);
+    return result;
+}
+
+vector<optional<string>> ShardCoordinator::Exchange(
+    const vector<string>& requests) {
+    const auto deadline = chrono::steady_clock::now() + timeout_;
+    vector<optional<string>> responses(shards_.size());
+    vector<size_t> waiting_shards;
+    for (size_t shard = 0; shard < shards_.size(); ++shard) {
+        ShardConnection& connection = shards_[shard];
+        if (requests[shard].empty()) {
+            continue;
+        }
+        if (connection.socket < 0) {
+            // соединение входит в то же время ожидания, что и ответ
+            connection.socket = ConnectToAddress(
+                connection.address,
+                max(chrono::duration_cast<chrono::milliseconds>(
+                        deadline - chrono::steady_clock::now()),
+                    chrono::milliseconds(0)));
+        }
+        if (connection.socket < 0) {
+            continue;
+        }
+        if (!SendMessage(connection.socket, requests[shard])) {
+            Disconnect(connection);
+            continue;
+        }
+        waiting_shards.push_back(shard);
+    }
+
+    char chunk[4096];
+    vector<pollfd> poll_sockets;
+    while (!waiting_shards.empty()) {
+        const auto remaining = chrono::duration_cast<chrono::milliseconds>(
+            deadline - chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            break;
+        }
+
+        poll_sockets.clear();
+        for (const size_t shard : waiting_shards) {
+            poll_sockets.push_back({shards_[shard].socket, POLLIN, 0});
+        }
+        if (poll(poll_sockets.data(), poll_sockets.size(),
+                 static_cast<int>(remaining.count())) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        vector<size_t> still_waiting;
+        for (size_t i = 0; i < waiting_shards.size(); ++i) {
+            const size_t shard = waiting_shards[i];
+            ShardConnection& connection = shards_[shard];
+            if (poll_sockets[i].revents == 0) {
+                still_waiting.push_back(shard);
+                continue;
+            }
+
+            const ssize_t result =
+                recv(connection.socket, chunk, sizeof(chunk), MSG_DONTWAIT);
+            if (result < 0 && (errno == EINTR || errno == EAGAIN ||
+                               errno == EWOULDBLOCK)) {
+                still_waiting.push_back(shard);
+                continue;
+            }
+            if (result <= 0) {
+                Disconnect(connection);
+                continue;
+            }
+
+            connection.input.append(chunk, static_cast<size_t>(result));
+            try {
+                responses[shard] = ExtractMessage(connection.input);
+            } catch (const invalid_argument&) {
+                Disconnect(connection);
+                continue;
+            }
+            if (!responses[shard]) {
+                still_waiting.push_back(shard);
+            }
+        }
+        waiting_shards = move(still_waiting);
+    }
+
+    for (const size_t shard : waiting_shards) {
+        Disconnect(shards_[shard]);
+    }
+    return responses;
+}
+
+void ShardCoordinator::Disconnect(ShardConnection& shard) {
+    if (shard.socket >= 0) {
+        close(shard.socket);
+    }
+    shard.socket = -1;
+    shard.input.clear();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// Время ожидания ответа шарда по умолчанию
+constexpr const std::chrono::milliseconds SHARD_RESPONSE_TIMEOUT{1000};
+
+// Результат распределенного поиска. Если часть шардов не ответила,
+// выдача составлена по ответившим.
+struct DistributedSearchResult {
+    std::vector<Document> documents;
+    size_t shard_count = 0;
+    size_t responded_shard_count = 0;
+
+    bool IsPartial() const;
+};
+
+// Координатор поиска по шардам в других процессах (см. ShardServer).
+// Запрос выполняется в два обмена: статистика слов, затем поиск с общим
+// IDF. Не ответивший за тайм-аут шард пропускается, а его соединение
+// закрывается, чтобы опоздавший ответ не приняли за следующий.
+class ShardCoordinator {
+   public:
+    explicit ShardCoordinator(
+        std::vector<std::string> addresses,
+        std::chrono::milliseconds timeout = SHARD_RESPONSE_TIMEOUT);
+
+    ShardCoordinator(const ShardCoordinator&) = delete;
+    ShardCoordinator& operator=(const ShardCoordinator&) = delete;
+
+    ~ShardCoordinator();
+
+    size_t GetShardCount() const;
+
+    // Некорректный запрос отклоняется шардами, и исключение
+    // std::invalid_argument выбрасывается с их сообщением
+    DistributedSearchResult FindTopDocuments(
+        const std::string_view raw_query,
+        DocumentStatus filter_status = DocumentStatus::ACTUAL,
+        ResultPage page = {});
+
+   private:
+    struct ShardConnection {
+        std::string address;
+        int socket = -1;
+        std::string input;
+    };
+
+    std::vector<ShardConnection> shards_;
+    std::chrono::milliseconds timeout_;
+
+    // Отправляет requests[i] шарду i (пустой запрос не отправляется)
+    // и возвращает полученные за время ожидания ответы
+    std::vector<std::optional<std::string>> Exchange(
+        const std::vector<std::string>& requests);
+
+    void Disconnect(ShardConnection& shard);
+};
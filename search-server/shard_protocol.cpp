@@ -0,0 +1,353 @@
+#include "shard_protocol.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+
+namespace {
+
+const size_t MESSAGE_LENGTH_SIZE = 4;
+
+uint32_t DecodeUint32(const char* bytes) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i]))
+                 << (8 * i);
+    }
+    return value;
+}
+
+void EncodeUint32(uint32_t value, string& output) {
+    for (size_t i = 0; i < 4; ++i) {
+        output.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+bool IsUnixSocketAddress(const string& address) {
+    return !address.empty() && (address[0] == '/' || address[0] == '.');
+}
+
+sockaddr_un MakeUnixSocketAddress(const string& path) {
+    using namespace std::string_literals;
+    sockaddr_un socket_address = {};
+    socket_address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(socket_address.sun_path)) {
+        throw invalid_argument("Unix socket path is too long"s);
+    }
+    memcpy(socket_address.sun_path, path.data(), path.size());
+    return socket_address;
+}
+
+// Разрешает host:port; результат освобождается freeaddrinfo
+addrinfo* ResolveTcpAddress(const string& address, bool passive) {
+    using namespace std::string_literals;
+    const size_t colon = address.rfind(':');
+    if (colon == string::npos) {
+        throw invalid_argument("Address must be a socket path or host:port"s);
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    const string host = address.substr(0, colon);
+    const string port = address.substr(colon + 1);
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(),
+                    &hints, &result) != 0) {
+        throw invalid_argument("Cannot resolve address "s + address);
+    }
+    return result;
+}
+
+// Соединяется неблокирующим connect, ожидая не дольше deadline;
+// возвращает -1, если соединиться не удалось
+int ConnectSocket(int family, int type, int protocol, const sockaddr* address,
+                  socklen_t address_size,
+                  chrono::steady_clock::time_point deadline) {
+    const int connected_socket = socket(family, type | SOCK_NONBLOCK, protocol);
+    if (connected_socket < 0) {
+        return -1;
+    }
+
+    bool connected = connect(connected_socket, address, address_size) == 0;
+    if (!connected && (errno == EINPROGRESS || errno == EINTR)) {
+        while (true) {
+            const auto remaining = chrono::duration_cast<chrono::milliseconds>(
+                deadline - chrono::steady_clock::now());
+            pollfd poll_socket = {connected_socket, POLLOUT, 0};
+            const int ready =
+                poll(&poll_socket, 1,
+                     static_cast<int>(max<int64_t>(remaining.count(), 0)));
+            if (ready < 0 && errno == EINTR) {
+                continue;
+            }
+            int error = 0;
+            socklen_t error_size = sizeof(error);
+            connected = ready > 0 &&
+                        getsockopt(connected_socket, SOL_SOCKET, SO_ERROR,
+                                   &error, &error_size) == 0 &&
+                        error == 0;
+            break;
+        }
+    }
+
+    const int flags = fcntl(connected_socket, F_GETFL);
+    if (!connected || flags < 0 ||
+        fcntl(connected_socket, F_SETFL, flags & ~O_NONBLOCK) != 0) {
+        close(connected_socket);
+        return -1;
+    }
+    return connected_socket;
+}
+
+}  // namespace
+
+MessageWriter::MessageWriter(ShardMessageType type) {
+    message_.push_back(static_cast<char>(type));
+}
+
+void MessageWriter::WriteUint32(uint32_t value) {
+    EncodeUint32(value, message_);
+}
+
+void MessageWriter::WriteUint64(uint64_t value) {
+    WriteUint32(static_cast<uint32_t>(value));
+    WriteUint32(static_cast<uint32_t>(value >> 32));
+}
+
+void MessageWriter::WriteDouble(double value) {
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    WriteUint64(bits);
+}
+
+void MessageWriter::WriteString(const string_view value) {
+    WriteUint32(static_cast<uint32_t>(value.size()));
+    message_.append(value);
+}
+
+const string& MessageWriter::GetMessage() const { return message_; }
+
+MessageReader::MessageReader(const string_view message) : data_(message) {
+    type_ = static_cast<ShardMessageType>(ReadBytes(1)[0]);
+}
+
+ShardMessageType MessageReader::GetType() const { return type_; }
+
+uint32_t MessageReader::ReadUint32() {
+    return DecodeUint32(ReadBytes(4).data());
+}
+
+uint64_t MessageReader::ReadUint64() {
+    const uint64_t low = ReadUint32();
+    return low | static_cast<uint64_t>(ReadUint32()) << 32;
+}
+
+double MessageReader::ReadDouble() {
+    const uint64_t bits = ReadUint64();
+    double value = 0.0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+string_view MessageReader::ReadString() { return ReadBytes(ReadUint32()); }
+
+string_view MessageReader::ReadBytes(size_t count) {
+    using namespace std::string_literals;
+    if (count > data_.size()) {
+        throw invalid_argument("Malformed shard message"s);
+    }
+
+    const string_view bytes = data_.substr(0, count);
+    data_.remove_prefix(count);
+    return bytes;
+}
+
+void WriteCorpusStatistics(MessageWriter& writer,
+                           const CorpusStatistics& statistics) {
+    writer.WriteUint64(statistics.document_count);
+    writer.WriteUint32(static_cast<uint32_t>(statistics.document_freqs.size()));
+    for (const auto& [word, document_freq] : statistics.document_freqs) {
+        writer.WriteString(word);
+        writer.WriteUint64(document_freq);
+    }
+}
+
+CorpusStatistics ReadCorpusStatistics(MessageReader& reader) {
+    CorpusStatistics statistics;
+    statistics.document_count = reader.ReadUint64();
+    const uint32_t word_count = reader.ReadUint32();
+    for (uint32_t i = 0; i < word_count; ++i) {
+        const string_view word = reader.ReadString();
+        statistics.document_freqs[word] += reader.ReadUint64();
+    }
+    return statistics;
+}
+
+void WriteDocuments(MessageWriter& writer, const vector<Document>& documents) {
+    writer.WriteUint32(static_cast<uint32_t>(documents.size()));
+    for (const Document& document : documents) {
+        writer.WriteUint32(static_cast<uint32_t>(document.id));
+        writer.WriteDouble(document.relevance);
+        writer.WriteUint32(static_cast<uint32_t>(document.rating));
+    }
+}
+
+vector<Document> ReadDocuments(MessageReader& reader) {
+    const uint32_t document_count = reader.ReadUint32();
+    vector<Document> documents;
+    for (uint32_t i = 0; i < document_count; ++i) {
+        const int id = static_cast<int>(reader.ReadUint32());
+        const double relevance = reader.ReadDouble();
+        const int rating = static_cast<int>(reader.ReadUint32());
+        documents.emplace_back(id, relevance, rating);
+    }
+    return documents;
+}
+
+int ListenOnAddress(const string& address) {
+    using namespace std::string_literals;
+    int listen_socket = -1;
+    if (IsUnixSocketAddress(address)) {
+        const sockaddr_un socket_address = MakeUnixSocketAddress(address);
+        listen_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(address.c_str());
+        if (listen_socket < 0 ||
+            bind(listen_socket,
+                 reinterpret_cast<const sockaddr*>(&socket_address),
+                 sizeof(socket_address)) != 0) {
+            const int error = errno;
+            if (listen_socket >= 0) {
+                close(listen_socket);
+            }
+            throw system_error(error, generic_category(),
+                               "Cannot bind "s + address);
+        }
+    } else {
+        addrinfo* addresses = ResolveTcpAddress(address, true);
+        listen_socket = socket(addresses->ai_family, addresses->ai_socktype,
+                               addresses->ai_protocol);
+        const int reuse = 1;
+        if (listen_socket >= 0) {
+            setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &reuse,
+                       sizeof(reuse));
+        }
+        if (listen_socket < 0 || bind(listen_socket, addresses->ai_addr,
+                                      addresses->ai_addrlen) != 0) {
+            const int error = errno;
+            freeaddrinfo(addresses);
+            if (listen_socket >= 0) {
+                close(listen_socket);
+            }
+            throw system_error(error, generic_category(),
+                               "Cannot bind "s + address);
+        }
+        freeaddrinfo(addresses);
+    }
+
+    if (listen(listen_socket, SOMAXCONN) != 0) {
+        const int error = errno;
+        close(listen_socket);
+        throw system_error(error, generic_category(),
+                           "Cannot listen on "s + address);
+    }
+    return listen_socket;
+}
+
+int ConnectToAddress(const string& address, chrono::milliseconds timeout) {
+    const auto deadline = chrono::steady_clock::now() + timeout;
+    addrinfo* addresses = nullptr;
+    try {
+        if (IsUnixSocketAddress(address)) {
+            const sockaddr_un socket_address = MakeUnixSocketAddress(address);
+            return ConnectSocket(
+                AF_UNIX, SOCK_STREAM, 0,
+                reinterpret_cast<const sockaddr*>(&socket_address),
+                sizeof(socket_address), deadline);
+        }
+        addresses = ResolveTcpAddress(address, false);
+    } catch (const invalid_argument&) {
+        return -1;
+    }
+
+    int connected_socket = -1;
+    for (const addrinfo* it = addresses; it != nullptr && connected_socket < 0;
+         it = it->ai_next) {
+        connected_socket =
+            ConnectSocket(it->ai_family, it->ai_socktype, it->ai_protocol,
+                          it->ai_addr, it->ai_addrlen, deadline);
+    }
+    freeaddrinfo(addresses);
+    return connected_socket;
+}
+
+bool SendMessage(int socket, const string_view message) {
+    string frame;
+    frame.reserve(MESSAGE_LENGTH_SIZE + message.size());
+    EncodeUint32(static_cast<uint32_t>(message.size()), frame);
+    frame.append(message);
+
+    size_t sent = 0;
+    while (sent < frame.size()) {
+        // MSG_NOSIGNAL: закрытое соединение - ошибка, а не SIGPIPE
+        const ssize_t result = send(socket, frame.data() + sent,
+                                    frame.size() - sent, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+optional<string> ReceiveMessage(int socket, string& buffer) {
+    char chunk[4096];
+    while (true) {
+        if (optional<string> message = ExtractMessage(buffer)) {
+            return message;
+        }
+
+        const ssize_t result = recv(socket, chunk, sizeof(chunk), 0);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return nullopt;
+        }
+        buffer.append(chunk, static_cast<size_t>(result));
+    }
+}
+
+optional<string> ExtractMessage(string& buffer) {
+    using namespace std::string_literals;
+    if (buffer.size() < MESSAGE_LENGTH_SIZE) {
+        return nullopt;
+    }
+
+    const uint32_t size = DecodeUint32(buffer.data());
+    if (size == 0 || size > MAX_SHARD_MESSAGE_SIZE) {
+        throw invalid_argument("Malformed shard message"s);
+    }
+    if (buffer.size() < MESSAGE_LENGTH_SIZE + size) {
+        return nullopt;
+    }
+
+    string message = buffer.substr(MESSAGE_LENGTH_SIZE, size);
+    buffer.erase(0, MESSAGE_LENGTH_SIZE + size);
+    return message;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// Сообщения ShardCoordinator и ShardServer. На каждый запрос шард
+// отвечает ровно одним сообщением: ответом того же вида или ERROR.
+enum class ShardMessageType : uint8_t {
+    STATISTICS_REQUEST,
+    STATISTICS_RESPONSE,
+    SEARCH_REQUEST,
+    SEARCH_RESPONSE,
+    ERROR,
+};
+
+// Наибольшая допустимая длина сообщения
+constexpr const uint32_t MAX_SHARD_MESSAGE_SIZE = 64 * 1024 * 1024;
+
+/**
+ * Запись тела сообщения. Числа записываются в порядке little-endian
+ * независимо от платформы, поэтому шарды могут работать на разных машинах.
+ */
+class MessageWriter {
+   public:
+    explicit MessageWriter(ShardMessageType type);
+
+    void WriteUint32(uint32_t value);
+
+    void WriteUint64(uint64_t value);
+
+    void WriteDouble(double value);
+
+    void WriteString(const std::string_view value);
+
+    const std::string& GetMessage() const;
+
+   private:
+    std::string message_;
+};
+
+// Чтение тела сообщения. При выходе за конец сообщения выбрасывается
+// std::invalid_argument. Строки ссылаются на данные сообщения.
+class MessageReader {
+   public:
+    explicit MessageReader(const std::string_view message);
+
+    ShardMessageType GetType() const;
+
+    uint32_t ReadUint32();
+
+    uint64_t ReadUint64();
+
+    double ReadDouble();
+
+    std::string_view ReadString();
+
+   private:
+    ShardMessageType type_;
+    std::string_view data_;
+
+    std::string_view ReadBytes(size_t count);
+};
+
+void WriteCorpusStatistics(MessageWriter& writer,
+                           const CorpusStatistics& statistics);
+
+CorpusStatistics ReadCorpusStatistics(MessageReader& reader);
+
+void WriteDocuments(MessageWriter& writer,
+                    const std::vector<Document>& documents);
+
+std::vector<Document> ReadDocuments(MessageReader& reader);
+
+// Адрес сокета - путь Unix-сокета (начинается с '/' или '.') либо
+// host:port для TCP. Ошибки системных вызовов выбрасываются как
+// std::system_error.
+int ListenOnAddress(const std::string& address);
+
+// Соединение устанавливается неблокирующим connect не дольше timeout.
+// Возвращает сокет в блокирующем режиме или -1, если адрес некорректен,
+// не разрешается или соединиться не удалось. Разрешение имени
+// (getaddrinfo) тайм-аутом не ограничено.
+int ConnectToAddress(const std::string& address,
+                     std::chrono::milliseconds timeout);
+
+// Сообщение передается как 4 байта длины и тело
+bool SendMessage(int socket, const std::string_view message);
+
+// Блокирующее чтение сообщения; nullopt при закрытии соединения или
+// истечении тайм-аута приема сокета. В buffer остаются байты, полученные
+// после сообщения.
+std::optional<std::string> ReceiveMessage(int socket, std::string& buffer);
+
+// Извлекает из начала buffer полностью полученное сообщение
+std::optional<std::string> ExtractMessage(std::string& buffer);
@@ -0,0 +1,120 @@
+#include "shard_server.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <execution>
+#include <future>
+#include <list>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+
+#include "shard_protocol.h"
+
+using namespace std;
+
+ShardServer::ShardServer(const SearchServer& search_server,
+                         const string& address, chrono::milliseconds timeout)
+    : search_server_(search_server),
+      listen_socket_(ListenOnAddress(address)),
+      timeout_(timeout) {}
+
+ShardServer::~ShardServer() { close(listen_socket_); }
+
+void ShardServer::Serve() {
+    list<future<void>> connections;
+    while (true) {
+        const int connection = accept(listen_socket_, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+
+        connections.remove_if([](const future<void>& served) {
+            return served.wait_for(chrono::seconds(0)) ==
+                   future_status::ready;
+        });
+        try {
+            connections.push_back(async(launch::async, [this, connection]() {
+                ServeConnection(connection);
+                close(connection);
+            }));
+        } catch (const system_error&) {
+            // поток не создан, соединение отклоняется
+            close(connection);
+        }
+    }
+
+    for (future<void>& served : connections) {
+        served.wait();
+    }
+}
+
+void ShardServer::ServeConnection(int connection) {
+    const auto seconds = chrono::duration_cast<chrono::seconds>(timeout_);
+    timeval timeout{};
+    timeout.tv_sec = seconds.count();
+    timeout.tv_usec =
+        chrono::duration_cast<chrono::microseconds>(timeout_ - seconds)
+            .count();
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+               sizeof(timeout));
+    setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+               sizeof(timeout));
+
+    string buffer;
+    try {
+        while (const optional<string> message =
+                   ReceiveMessage(connection, buffer)) {
+            if (!SendMessage(connection, HandleMessage(*message))) {
+                return;
+            }
+        }
+    } catch (const exception&) {
+        // поток сообщений нарушен или запрос не выполнен, соединение
+        // закрывается, а остальные продолжают обслуживаться
+    }
+}
+
+string ShardServer::HandleMessage(const string& message) const {
+    using namespace std::string_literals;
+    try {
+        MessageReader reader(message);
+        const string_view raw_query = reader.ReadString();
+        if (reader.GetType() == ShardMessageType::STATISTICS_REQUEST) {
+            CorpusStatistics statistics;
+            search_server_.AddQueryStatistics(raw_query, statistics);
+            MessageWriter writer(ShardMessageType::STATISTICS_RESPONSE);
+            WriteCorpusStatistics(writer, statistics);
+            return writer.GetMessage();
+        }
+        if (reader.GetType() == ShardMessageType::SEARCH_REQUEST) {
+            const DocumentStatus filter_status =
+                static_cast<DocumentStatus>(reader.ReadUint32());
+            const size_t top_count = reader.ReadUint64();
+            const CorpusStatistics statistics = ReadCorpusStatistics(reader);
+            MessageWriter writer(ShardMessageType::SEARCH_RESPONSE);
+            WriteDocuments(
+                writer,
+                search_server_.FindTopDocuments(
+                    execution::seq, raw_query, statistics,
+                    [filter_status]([[maybe_unused]] const int id,
+                                    const DocumentStatus status,
+                                    [[maybe_unused]] const int rating) {
+                        return status == filter_status;
+                    },
+                    ResultPage{0, top_count}));
+            return writer.GetMessage();
+        }
+        throw invalid_argument("Unknown shard request"s);
+    } catch (const invalid_argument& error) {
+        MessageWriter writer(ShardMessageType::ERROR);
+        writer.WriteString(error.what());
+        return writer.GetMessage();
+    }
+}
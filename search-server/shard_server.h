@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include "search_server.h"
+
+// Соединение, по которому так долго не приходит сообщение, закрывается
+constexpr const std::chrono::milliseconds SHARD_CONNECTION_TIMEOUT{60000};
+
+// Шард распределенного поиска: отвечает на запросы ShardCoordinator.
+// Каждое соединение обслуживается своим потоком; ошибка или тайм-аут
+// закрывают только это соединение.
+class ShardServer {
+   public:
+    // Начинает прослушивать адрес (см. ListenOnAddress), поэтому
+    // координатор может подключаться сразу после создания объекта
+    ShardServer(const SearchServer& search_server, const std::string& address,
+                std::chrono::milliseconds timeout = SHARD_CONNECTION_TIMEOUT);
+
+    ShardServer(const ShardServer&) = delete;
+    ShardServer& operator=(const ShardServer&) = delete;
+
+    ~ShardServer();
+
+    // Обслуживает соединения, пока не закрыт прослушивающий сокет, и
+    // дожидается завершения начатых соединений
+    void Serve();
+
+    // Обслуживает одно соединение до его закрытия или тайм-аута
+    void ServeConnection(int connection);
+
+    // Ответ на одно сообщение
+    std::string HandleMessage(const std::string& message) const;
+
+   private:
+    const SearchServer& search_server_;
+    int listen_socket_;
+    std::chrono::milliseconds timeout_;
+};
@@ -0,0 +1,91 @@
+#include "sharded_search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+using namespace std;
+
+size_t ShardedSearchServer::GetShardCount() const { return shards_.size(); }
+
+const SearchServer& ShardedSearchServer::GetShard(size_t shard) const {
+    return *shards_.at(shard);
+}
+
+size_t ShardedSearchServer::GetDocumentCount() const {
+    size_t document_count = 0;
+    for (const auto& shard : shards_) {
+        document_count += shard->GetDocumentCount();
+    }
+
+    return document_count;
+}
+
+void ShardedSearchServer::SetRetrievalEngine(RetrievalEngine engine) {
+    for (const auto& shard : shards_) {
+        shard->SetRetrievalEngine(engine);
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id,
+                                      const string_view document_text,
+                                      DocumentStatus status,
+                                      const vector<int>& ratings) {
+    GetDocumentShard(document_id)
+        .AddDocument(document_id, document_text, status, ratings);
+}
+
+IngestionStatistics ShardedSearchServer::AddDocuments(
+    const vector<NewDocument>& documents) {
+    const auto start_time = chrono::steady_clock::now();
+    vector<vector<NewDocument>> shard_documents(shards_.size());
+    for (const NewDocument& document : documents) {
+        shard_documents[static_cast<unsigned>(document.id) % shards_.size()]
+            .push_back(document);
+    }
+    for (size_t shard = 0; shard < shards_.size(); ++shard) {
+        shards_[shard]->ValidateNewDocuments(shard_documents[shard]);
+    }
+
+    vector<size_t> shards(shards_.size());
+    iota(shards.begin(), shards.end(), 0);
+    vector<IngestionStatistics> shard_statistics(shards_.size());
+    for_each(execution::par, shards.begin(), shards.end(), [&](size_t shard) {
+        shard_statistics[shard] = shards_[shard]->AddDocuments(
+            execution::seq, shard_documents[shard]);
+    });
+
+    IngestionStatistics statistics;
+    for (const IngestionStatistics& shard_statistic : shard_statistics) {
+        statistics.document_count += shard_statistic.document_count;
+        statistics.byte_count += shard_statistic.byte_count;
+    }
+    statistics.seconds = chrono::duration<double>(chrono::steady_clock::now() -
+                                                  start_time)
+                             .count();
+    return statistics;
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    GetDocumentShard(document_id).RemoveDocument(document_id);
+}
+
+void ShardedSearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    RemoveDocuments(execution::seq, document_ids);
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(
+    const string_view raw_query, int document_id) const {
+    return GetDocumentShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(
+    const string_view raw_query, DocumentStatus filter_status,
+    ResultPage page) const {
+    return FindTopDocuments(execution::par, raw_query, filter_status, page);
+}
+
+SearchServer& ShardedSearchServer::GetDocumentShard(int document_id) const {
+    // отрицательный id попадает в какой-либо шард, который его отклонит
+    return *shards_[static_cast<unsigned>(document_id) % shards_.size()];
+}
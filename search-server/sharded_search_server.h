@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "search_server.h"
+#include "top_documents.h"
+
+// Сервер, разделенный на шарды по document_id % GetShardCount(). IDF
+// вычисляется по статистике всех шардов, поэтому выдача та же, что у
+// одного SearchServer.
+class ShardedSearchServer {
+   public:
+    template <typename... Args>
+    explicit ShardedSearchServer(size_t shard_count, const Args&... args);
+
+    size_t GetShardCount() const;
+
+    const SearchServer& GetShard(size_t shard) const;
+
+    size_t GetDocumentCount() const;
+
+    void SetRetrievalEngine(RetrievalEngine engine);
+
+    void AddDocument(int document_id, const std::string_view document_text,
+                     DocumentStatus status, const std::vector<int>& ratings);
+
+    // Распределяет документы по шардам и добавляет их во все шарды
+    // параллельно. Если хотя бы один документ некорректен, исключение
+    // выбрасывается до изменения шардов.
+    IngestionStatistics AddDocuments(const std::vector<NewDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    // Шарды удаляют свои документы параллельно согласно policy
+    template <typename ExecutionPolicy>
+    void RemoveDocuments(ExecutionPolicy&& policy,
+                         const std::vector<int>& document_ids);
+
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        const std::string_view raw_query, int document_id) const;
+
+    template <typename ExecutionPolicy>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+        ExecutionPolicy&& policy, const std::string_view raw_query,
+        int document_id) const;
+
+    // Шарды обходятся согласно policy; без policy - параллельно
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+        ExecutionPolicy&& policy, const std::string_view raw_query,
+        DocumentPredicate document_predicate, ResultPage page = {}) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(
+        const std::string_view raw_query,
+        DocumentPredicate document_predicate, ResultPage page = {}) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(
+        ExecutionPolicy&& policy, const std::string_view raw_query,
+        DocumentStatus filter_status = DocumentStatus::ACTUAL,
+        ResultPage page = {}) const;
+
+    std::vector<Document> FindTopDocuments(
+        const std::string_view raw_query,
+        DocumentStatus filter_status = DocumentStatus::ACTUAL,
+        ResultPage page = {}) const;
+
+   private:
+    std::vector<std::unique_ptr<SearchServer>> shards_;
+
+    SearchServer& GetDocumentShard(int document_id) const;
+};
+
+template <typename... Args>
+ShardedSearchServer::ShardedSearchServer(size_t shard_count,
+                                         const Args&... args) {
+    using namespace std::string_literals;
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+
+    shards_.reserve(shard_count);
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        shards_.push_back(std::make_unique<SearchServer>(args...));
+    }
+}
+
+template <typename ExecutionPolicy>
+void ShardedSearchServer::RemoveDocuments(
+    ExecutionPolicy&& policy, const std::vector<int>& document_ids) {
+    std::vector<std::vector<int>> shard_document_ids(shards_.size());
+    for (const int document_id : document_ids) {
+        shard_document_ids[static_cast<unsigned>(document_id) %
+                           shards_.size()]
+            .push_back(document_id);
+    }
+
+    std::vector<size_t> shards(shards_.size());
+    std::iota(shards.begin(), shards.end(), 0);
+    std::for_each(policy, shards.begin(), shards.end(), [&](size_t shard) {
+        shards_[shard]->RemoveDocuments(std::execution::seq,
+                                        shard_document_ids[shard]);
+    });
+}
+
+template <typename ExecutionPolicy>
+std::tuple<std::vector<std::string_view>, DocumentStatus>
+ShardedSearchServer::MatchDocument(ExecutionPolicy&& policy,
+                                   const std::string_view raw_query,
+                                   int document_id) const {
+    return GetDocumentShard(document_id)
+        .MatchDocument(policy, raw_query, document_id);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+    ExecutionPolicy&& policy, const std::string_view raw_query,
+    DocumentPredicate document_predicate, ResultPage page) const {
+    // запрос разбирается один раз, и некорректный запрос отклоняется
+    // до обращения к шардам; стоп-слова у всех шардов одинаковые
+    const SearchServer::PreparedQuery query =
+        shards_.front()->PrepareQuery(raw_query);
+    std::vector<CorpusStatistics> shard_statistics(shards_.size());
+    std::transform(policy, shards_.begin(), shards_.end(),
+                   shard_statistics.begin(), [&](const auto& shard) {
+                       CorpusStatistics statistics;
+                       shard->AddQueryStatistics(query, statistics);
+                       return statistics;
+                   });
+    CorpusStatistics statistics;
+    for (const CorpusStatistics& shard_statistic : shard_statistics) {
+        statistics.document_count += shard_statistic.document_count;
+        for (const auto& [word, document_freq] :
+             shard_statistic.document_freqs) {
+            statistics.document_freqs[word] += document_freq;
+        }
+    }
+
+    const size_t top_count = page.size > SIZE_MAX - page.offset
+                                 ? SIZE_MAX
+                                 : page.offset + page.size;
+    std::vector<std::vector<Document>> shard_results(shards_.size());
+    std::transform(policy, shards_.begin(), shards_.end(),
+                   shard_results.begin(), [&](const auto& shard) {
+                       return shard->FindTopDocuments(
+                           std::execution::seq, query, statistics,
+                           document_predicate, ResultPage{0, top_count});
+                   });
+
+    TopDocuments top_documents(top_count);
+    for (const std::vector<Document>& documents : shard_results) {
+        for (const Document& document : documents) {
+            top_documents.Add(document);
+        }
+    }
+
+    return top_documents.Extract(page.offset);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+    const std::string_view raw_query, DocumentPredicate document_predicate,
+    ResultPage page) const {
+    return FindTopDocuments(std::execution::par, raw_query,
+                            document_predicate, page);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(
+    ExecutionPolicy&& policy, const std::string_view raw_query,
+    DocumentStatus filter_status, ResultPage page) const {
+    return FindTopDocuments(
+        policy, raw_query,
+        [filter_status]([[maybe_unused]] const int id,
+                        [[maybe_unused]] const DocumentStatus status,
+                        [[maybe_unused]] const int rating) {
+            return status == filter_status;
+        },
+        page);
+}
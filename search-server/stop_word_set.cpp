@@ -0,0 +1,49 @@
+#include "stop_word_set.h"
+
+using namespace std;
+
+StopWordSet::StopWordSet() : seeds_(1, 0), slots_(1, 0) {}
+
+bool StopWordSet::Contains(string_view word) const {
+    if (word.size() > max_word_size_) {
+        return false;
+    }
+    const uint64_t hash = HashStopWord(word);
+    const uint32_t slot = slots_[GetStopWordSlot(
+        hash, seeds_[GetStopWordBucket(hash, seeds_.size())], slots_.size())];
+    return slot != 0 && words_[slot - 1] == word;
+}
+
+bool StopWordSet::Empty() const { return words_.empty(); }
+
+size_t StopWordSet::Size() const { return words_.size(); }
+
+vector<string>::const_iterator StopWordSet::begin() const {
+    return words_.begin();
+}
+
+vector<string>::const_iterator StopWordSet::end() const { return words_.end(); }
+
+void StopWordSet::Build() {
+    for (const string& word : words_) {
+        max_word_size_ = max(max_word_size_, word.size());
+    }
+
+    vector<uint64_t> hashes(words_.size());
+    size_t bucket_count = GetStopWordBucketCount(words_.size());
+    size_t slot_count = GetStopWordSlotCount(words_.size());
+    for (size_t growth = 0;; ++growth) {
+        vector<uint32_t> bucket_sizes(bucket_count, 0);
+        seeds_.assign(bucket_count, 0);
+        slots_.assign(slot_count, 0);
+        const StopWordTableStatus status = BuildStopWordTable(
+            words_, words_.size(), hashes, bucket_sizes, seeds_, slots_);
+        if (status != StopWordTableStatus::TABLE_TOO_SMALL ||
+            growth == MAX_STOP_WORD_TABLE_GROWTH) {
+            CheckStopWordTableStatus(status);
+            return;
+        }
+        bucket_count *= 2;
+        slot_count *= 2;
+    }
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Наибольшее число слов в одной корзине таблицы стоп-слов
+constexpr const size_t MAX_STOP_WORD_BUCKET_SIZE = 32;
+
+// Число перебираемых сдвигов корзины, после которого таблица увеличивается
+constexpr const uint32_t MAX_STOP_WORD_SEED = 1 << 16;
+
+// Сколько раз StopWordSet удваивает таблицу, прежде чем отказаться
+constexpr const size_t MAX_STOP_WORD_TABLE_GROWTH = 8;
+
+enum class StopWordTableStatus {
+    BUILT,
+    // слова повторяются
+    DUPLICATE_WORDS,
+    // у различных слов одинаковый хеш, такие слова не разделить
+    HASH_COLLISION,
+    // корзина больше MAX_STOP_WORD_BUCKET_SIZE или сдвиг не найден
+    TABLE_TOO_SMALL,
+};
+
+constexpr uint64_t HashStopWord(std::string_view word) {
+    // FNV-1a
+    uint64_t hash = 0xCBF29CE484222325;
+    for (const char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3;
+    }
+    return hash;
+}
+
+// Ячейка таблицы для слова с хешем hash в корзине со сдвигом seed
+constexpr size_t GetStopWordSlot(uint64_t hash, uint32_t seed,
+                                 size_t slot_count) {
+    uint64_t value = hash + (seed + 1) * 0x9E3779B97F4A7C15;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+    return static_cast<size_t>((value ^ (value >> 31)) & (slot_count - 1));
+}
+
+constexpr size_t GetStopWordBucket(uint64_t hash, size_t bucket_count) {
+    return static_cast<size_t>(((hash >> 32) * bucket_count) >> 32);
+}
+
+constexpr size_t GetStopWordBucketCount(size_t word_count) {
+    return word_count / 2 + 1;
+}
+
+// Степень двойки не меньше полутора чисел слов: таблица заполнена
+// не больше чем на две трети
+constexpr size_t GetStopWordSlotCount(size_t word_count) {
+    size_t slot_count = 1;
+    while (slot_count < word_count + word_count / 2) {
+        slot_count *= 2;
+    }
+    return slot_count;
+}
+
+// Строит совершенную хеш-функцию методом hash and displace:
+// slots[ячейка] - номер слова плюс один, 0 - пустая ячейка.
+template <typename Words, typename Hashes, typename Buckets, typename Slots>
+constexpr StopWordTableStatus BuildStopWordTable(
+    const Words& words, size_t word_count, Hashes& hashes,
+    Buckets& bucket_sizes, Buckets& seeds, Slots& slots) {
+    const size_t bucket_count = seeds.size();
+    size_t max_bucket_size = 0;
+    for (size_t i = 0; i < word_count; ++i) {
+        hashes[i] = HashStopWord(words[i]);
+        const size_t bucket = GetStopWordBucket(hashes[i], bucket_count);
+        max_bucket_size =
+            std::max<size_t>(max_bucket_size, ++bucket_sizes[bucket]);
+    }
+    // строки сравниваются только при совпадении хешей
+    for (size_t i = 0; i < word_count; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            if (hashes[i] == hashes[j]) {
+                return std::string_view(words[i]) == std::string_view(words[j])
+                           ? StopWordTableStatus::DUPLICATE_WORDS
+                           : StopWordTableStatus::HASH_COLLISION;
+            }
+        }
+    }
+    if (max_bucket_size > MAX_STOP_WORD_BUCKET_SIZE) {
+        return StopWordTableStatus::TABLE_TOO_SMALL;
+    }
+
+    for (size_t bucket_size = max_bucket_size; bucket_size > 0;
+         --bucket_size) {
+        for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+            if (bucket_sizes[bucket] != bucket_size) {
+                continue;
+            }
+            size_t members[MAX_STOP_WORD_BUCKET_SIZE] = {};
+            size_t member_slots[MAX_STOP_WORD_BUCKET_SIZE] = {};
+            size_t member_count = 0;
+            for (size_t i = 0; i < word_count; ++i) {
+                if (GetStopWordBucket(hashes[i], bucket_count) == bucket) {
+                    members[member_count++] = i;
+                }
+            }
+
+            bool placed = false;
+            for (uint32_t seed = 0; seed < MAX_STOP_WORD_SEED && !placed;
+                 ++seed) {
+                placed = true;
+                for (size_t j = 0; j < member_count && placed; ++j) {
+                    member_slots[j] = GetStopWordSlot(hashes[members[j]], seed,
+                                                      slots.size());
+                    placed = slots[member_slots[j]] == 0;
+                    for (size_t k = 0; k < j && placed; ++k) {
+                        placed = member_slots[k] != member_slots[j];
+                    }
+                }
+                if (placed) {
+                    seeds[bucket] = seed;
+                }
+            }
+            if (!placed) {
+                return StopWordTableStatus::TABLE_TOO_SMALL;
+            }
+            for (size_t j = 0; j < member_count; ++j) {
+                slots[member_slots[j]] = static_cast<uint32_t>(members[j] + 1);
+            }
+        }
+    }
+    return StopWordTableStatus::BUILT;
+}
+
+// Выбрасывает std::invalid_argument, если таблица не построена
+constexpr void CheckStopWordTableStatus(StopWordTableStatus status) {
+    switch (status) {
+        case StopWordTableStatus::BUILT:
+            return;
+        case StopWordTableStatus::DUPLICATE_WORDS:
+            throw std::invalid_argument("Stop words are not unique");
+        case StopWordTableStatus::HASH_COLLISION:
+            throw std::invalid_argument("Stop words have equal hashes");
+        case StopWordTableStatus::TABLE_TOO_SMALL:
+            throw std::invalid_argument("Stop word table is too small");
+    }
+}
+
+// Набор стоп-слов, таблица которого строится при компиляции, если
+// набор объявлен constexpr. TableScale увеличивает таблицу.
+template <size_t N, size_t TableScale = 1>
+class StaticStopWordSet {
+   public:
+    static_assert(TableScale > 0 && (TableScale & (TableScale - 1)) == 0,
+                  "Stop word table scale must be a power of two");
+
+    static constexpr size_t BUCKET_COUNT =
+        GetStopWordBucketCount(N) * TableScale;
+    static constexpr size_t SLOT_COUNT = GetStopWordSlotCount(N) * TableScale;
+
+    constexpr explicit StaticStopWordSet(
+        const std::array<std::string_view, N>& words)
+        : words_(words) {
+        for (const std::string_view word : words_) {
+            if (word.empty()) {
+                throw std::invalid_argument("Stop word is empty");
+            }
+            for (const char c : word) {
+                if (c >= '\0' && c < ' ') {
+                    throw std::invalid_argument(
+                        "Stop words contain invalid characters");
+                }
+            }
+        }
+        std::array<uint64_t, N> hashes{};
+        std::array<uint32_t, BUCKET_COUNT> bucket_sizes{};
+        CheckStopWordTableStatus(BuildStopWordTable(words_, N, hashes,
+                                                    bucket_sizes, seeds_,
+                                                    slots_));
+    }
+
+    constexpr bool Contains(std::string_view word) const {
+        const uint64_t hash = HashStopWord(word);
+        const uint32_t slot = slots_[GetStopWordSlot(
+            hash, seeds_[GetStopWordBucket(hash, BUCKET_COUNT)], SLOT_COUNT)];
+        return slot != 0 && words_[slot - 1] == word;
+    }
+
+    constexpr const std::array<std::string_view, N>& GetWords() const {
+        return words_;
+    }
+
+    constexpr const std::array<uint32_t, BUCKET_COUNT>& GetSeeds() const {
+        return seeds_;
+    }
+
+    constexpr const std::array<uint32_t, SLOT_COUNT>& GetSlots() const {
+        return slots_;
+    }
+
+   private:
+    std::array<std::string_view, N> words_;
+    std::array<uint32_t, BUCKET_COUNT> seeds_{};
+    std::array<uint32_t, SLOT_COUNT> slots_{};
+};
+
+template <size_t N>
+StaticStopWordSet(const std::array<std::string_view, N>&)
+    -> StaticStopWordSet<N>;
+
+// Набор стоп-слов SearchServer: проверка слова - один хеш
+// и одно сравнение строк
+class StopWordSet {
+   public:
+    StopWordSet();
+
+    // Пустые и повторяющиеся слова пропускаются
+    template <typename Collection>
+    explicit StopWordSet(const Collection& words);
+
+    // Таблица, построенная при компиляции, копируется без перестроения
+    template <size_t N, size_t TableScale>
+    explicit StopWordSet(const StaticStopWordSet<N, TableScale>& words);
+
+    bool Contains(std::string_view word) const;
+
+    bool Empty() const;
+
+    size_t Size() const;
+
+    std::vector<std::string>::const_iterator begin() const;
+
+    std::vector<std::string>::const_iterator end() const;
+
+   private:
+    std::vector<std::string> words_;
+    std::vector<uint32_t> seeds_;
+    std::vector<uint32_t> slots_;
+    size_t max_word_size_ = 0;
+
+    // Строит таблицу, увеличивая ее, пока подходящие сдвиги не найдутся,
+    // но не больше MAX_STOP_WORD_TABLE_GROWTH раз
+    void Build();
+};
+
+template <typename Collection>
+StopWordSet::StopWordSet(const Collection& words) {
+    for (const std::string_view word : words) {
+        if (!word.empty()) {
+            words_.emplace_back(word);
+        }
+    }
+    std::sort(words_.begin(), words_.end());
+    words_.erase(std::unique(words_.begin(), words_.end()), words_.end());
+    Build();
+}
+
+template <size_t N, size_t TableScale>
+StopWordSet::StopWordSet(const StaticStopWordSet<N, TableScale>& words)
+    : words_(words.GetWords().begin(), words.GetWords().end()),
+      seeds_(words.GetSeeds().begin(), words.GetSeeds().end()),
+      slots_(words.GetSlots().begin(), words.GetSlots().end()) {
+    for (const std::string& word : words_) {
+        max_word_size_ = std::max(max_word_size_, word.size());
+    }
+}
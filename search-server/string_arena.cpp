@@ -0,0 +1,38 @@
+#include "string_arena.h"
+
+#include <cstring>
+
+using namespace std;
+
+StringArena::StringArena(size_t chunk_size) : chunk_size_(chunk_size) {}
+
+string_view StringArena::Add(string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+
+    char* data = nullptr;
+    if (text.size() > chunk_size_ / 4) {
+        data = Allocate(text.size());
+    } else {
+        if (text.size() > free_size_) {
+            free_begin_ = Allocate(chunk_size_);
+            free_size_ = chunk_size_;
+        }
+        data = free_begin_;
+        free_begin_ += text.size();
+        free_size_ -= text.size();
+    }
+    memcpy(data, text.data(), text.size());
+
+    return {data, text.size()};
+}
+
+size_t StringArena::GetMemoryUsage() const { return memory_usage_; }
+
+char* StringArena::Allocate(size_t size) {
+    // память не обнуляется: она сразу перезаписывается строкой
+    chunks_.emplace_back(new char[size]);
+    memory_usage_ += size;
+    return chunks_.back().get();
+}
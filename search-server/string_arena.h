@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Размер блока памяти StringArena по умолчанию
+constexpr const size_t STRING_ARENA_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Хранилище строк, в которое можно только добавлять.
+ *
+ * Строки копируются подряд в большие блоки памяти, поэтому добавление
+ * не требует отдельного выделения памяти на каждую строку. Блоки никогда
+ * не перемещаются, и string_view, возвращенные Add, остаются валидными
+ * все время жизни хранилища, в том числе после его перемещения.
+ * Строки длиннее четверти блока получают собственный блок.
+ */
+class StringArena {
+   public:
+    explicit StringArena(size_t chunk_size = STRING_ARENA_CHUNK_SIZE);
+
+    std::string_view Add(std::string_view text);
+
+    // Объем выделенной памяти в байтах
+    size_t GetMemoryUsage() const;
+
+   private:
+    size_t chunk_size_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* free_begin_ = nullptr;
+    size_t free_size_ = 0;
+    size_t memory_usage_ = 0;
+
+    char* Allocate(size_t size);
+};
@@ -1,17 +1,193 @@
 #include "string_processing.h"
 
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SEARCH_SERVER_X86_64
+#endif
+
 using namespace std;
 
+namespace {
+
+// Состояние разбора, переходящее из блока в блок
+struct TokenizerState {
+    size_t position = 0;
+    size_t word_begin = 0;
+    bool previous_space = true;
+};
+
+bool IsControlChar(char c) { return c >= '\0' && c < ' '; }
+
+// Бит i масок spaces соответствует байту state.position + i. Слова
+// начинаются и заканчиваются там, где бит отличается от предыдущего.
+inline void AddBlockWords(string_view str, uint32_t spaces, size_t width,
+                          TokenizerState& state, vector<string_view>& words) {
+    uint32_t transitions =
+        spaces ^ ((spaces << 1) | (state.previous_space ? 1u : 0u));
+    if (width < 32) {
+        transitions &= (1u << width) - 1;
+    }
+    while (transitions != 0) {
+        const int bit = __builtin_ctz(transitions);
+        transitions &= transitions - 1;
+        const size_t position = state.position + bit;
+        if ((spaces >> bit) & 1) {
+            words.push_back(
+                str.substr(state.word_begin, position - state.word_begin));
+        } else {
+            state.word_begin = position;
+        }
+    }
+    state.previous_space = (spaces >> (width - 1)) & 1;
+    state.position += width;
+}
+
+// Остаток текста, не кратный блоку
+bool SplitTail(string_view str, TokenizerState& state,
+               vector<string_view>& words) {
+    for (; state.position < str.size(); ++state.position) {
+        const char c = str[state.position];
+        if (IsControlChar(c)) {
+            return false;
+        }
+        const bool space = c == ' ';
+        if (space && !state.previous_space) {
+            words.push_back(str.substr(state.word_begin,
+                                       state.position - state.word_begin));
+        } else if (!space && state.previous_space) {
+            state.word_begin = state.position;
+        }
+        state.previous_space = space;
+    }
+    if (!state.previous_space) {
+        words.push_back(str.substr(state.word_begin));
+    }
+    return true;
+}
+
+#ifdef SEARCH_SERVER_X86_64
+
+bool SplitBlocksSse2(string_view str, TokenizerState& state,
+                     vector<string_view>& words) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i negative = _mm_set1_epi8(-1);
+    for (; state.position + 16 <= str.size();) {
+        const __m128i block = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(str.data() + state.position));
+        const __m128i control = _mm_and_si128(_mm_cmplt_epi8(block, space),
+                                              _mm_cmpgt_epi8(block, negative));
+        if (_mm_movemask_epi8(control) != 0) {
+            return false;
+        }
+        const uint32_t spaces = static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(block, space)));
+        AddBlockWords(str, spaces, 16, state, words);
+    }
+    return true;
+}
+
+__attribute__((target("avx2"))) bool SplitBlocksAvx2(
+    string_view str, TokenizerState& state, vector<string_view>& words) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i negative = _mm256_set1_epi8(-1);
+    for (; state.position + 32 <= str.size();) {
+        const __m256i block = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(str.data() + state.position));
+        const __m256i control =
+            _mm256_and_si256(_mm256_cmpgt_epi8(space, block),
+                             _mm256_cmpgt_epi8(block, negative));
+        if (_mm256_movemask_epi8(control) != 0) {
+            return false;
+        }
+        const uint32_t spaces = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, space)));
+        AddBlockWords(str, spaces, 32, state, words);
+    }
+    return true;
+}
+
+bool ContainsControlCharsSse2(string_view str, size_t& position) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i negative = _mm_set1_epi8(-1);
+    for (; position + 16 <= str.size(); position += 16) {
+        const __m128i block = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(str.data() + position));
+        const __m128i control = _mm_and_si128(_mm_cmplt_epi8(block, space),
+                                              _mm_cmpgt_epi8(block, negative));
+        if (_mm_movemask_epi8(control) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+__attribute__((target("avx2"))) bool ContainsControlCharsAvx2(
+    string_view str, size_t& position) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i negative = _mm256_set1_epi8(-1);
+    for (; position + 32 <= str.size(); position += 32) {
+        const __m256i block = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(str.data() + position));
+        const __m256i control =
+            _mm256_and_si256(_mm256_cmpgt_epi8(space, block),
+                             _mm256_cmpgt_epi8(block, negative));
+        if (_mm256_movemask_epi8(control) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HasAvx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+
+#endif
+
+}  // namespace
+
 vector<string_view> SplitIntoWords(string_view str) {
+    using namespace std::string_literals;
     vector<string_view> words;
-
-    str.remove_prefix(min(str.size(), str.find_first_not_of(" ")));
-    while (!str.empty()) {
-        size_t space_pos = str.find(" ");
-        words.push_back(str.substr(0, space_pos));
-        str.remove_prefix(
-            min(str.size(), str.find_first_not_of(" ", space_pos)));
+    if (!SplitIntoWords(str, words)) {
+        throw invalid_argument("Text contains invalid characters"s);
     }
 
     return words;
 }
+
+bool SplitIntoWords(string_view str, vector<string_view>& words) {
+    words.clear();
+    TokenizerState state;
+#ifdef SEARCH_SERVER_X86_64
+    if (HasAvx2() && !SplitBlocksAvx2(str, state, words)) {
+        return false;
+    }
+    if (!SplitBlocksSse2(str, state, words)) {
+        return false;
+    }
+#endif
+    return SplitTail(str, state, words);
+}
+
+bool ContainsControlChars(string_view str) {
+    size_t position = 0;
+#ifdef SEARCH_SERVER_X86_64
+    if (HasAvx2() && ContainsControlCharsAvx2(str, position)) {
+        return true;
+    }
+    if (ContainsControlCharsSse2(str, position)) {
+        return true;
+    }
+#endif
+    for (; position < str.size(); ++position) {
+        if (IsControlChar(str[position])) {
+            return true;
+        }
+    }
+    return false;
+}
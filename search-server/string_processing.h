@@ -3,4 +3,13 @@
 #include <string_view>
 #include <vector>
 
+// Выбрасывает std::invalid_argument, если str содержит управляющие символы
 std::vector<std::string_view> SplitIntoWords(std::string_view str);
+
+// Разбивает str на слова по пробелам, заменяя ими содержимое words, и за
+// тот же проход проверяет, что в str нет управляющих символов (коды 0-31).
+// Если они есть, возвращает false, и содержимое words не определено.
+// На x86-64 текст обрабатывается блоками по 32 (AVX2) или 16 (SSE2) байт.
+bool SplitIntoWords(std::string_view str, std::vector<std::string_view>& words);
+
+bool ContainsControlChars(std::string_view str);
@@ -0,0 +1,49 @@
+#include "top_documents.h"
+
+#include <algorithm>
+
+using namespace std;
+
+TopDocuments::TopDocuments(size_t capacity) : capacity_(capacity) {}
+
+void TopDocuments::Add(const Document& document) {
+    if (capacity_ == 0) {
+        return;
+    }
+
+    if (heap_.size() < capacity_) {
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    } else if (IsMoreRelevant(document, heap_.front())) {
+        pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        heap_.back() = document;
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+}
+
+size_t TopDocuments::GetCapacity() const { return capacity_; }
+
+bool TopDocuments::IsFull() const { return heap_.size() == capacity_; }
+
+double TopDocuments::GetMinRelevance() const { return heap_.front().relevance; }
+
+vector<Document> TopDocuments::Extract(size_t offset) {
+    sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    if (offset >= heap_.size()) {
+        return {};
+    }
+
+    heap_.erase(heap_.begin(), heap_.begin() + offset);
+    return move(heap_);
+}
+
+void TopDocuments::Extract(size_t offset, vector<Document>& documents) {
+    sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    documents.assign(heap_.begin() + min(offset, heap_.size()), heap_.end());
+    heap_.clear();
+}
+
+void TopDocuments::Reset(size_t capacity) {
+    capacity_ = capacity;
+    heap_.clear();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+#include "document.h"
+
+/**
+ * Отбирает capacity самых релевантных документов с помощью ограниченной
+ * кучи: вершина кучи - наименее релевантный из отобранных документов,
+ * поэтому добавление стоит O(log capacity), а не сортировку всех найденных.
+ */
+class TopDocuments {
+   public:
+    explicit TopDocuments(size_t capacity);
+
+    void Add(const Document& document);
+
+    size_t GetCapacity() const;
+
+    bool IsFull() const;
+
+    // Релевантность наименее релевантного из отобранных документов.
+    // Документ с меньшей релевантностью в выдачу уже не попадет.
+    double GetMinRelevance() const;
+
+    // Возвращает отобранные документы, начиная с позиции offset,
+    // упорядоченные по убыванию релевантности
+    std::vector<Document> Extract(size_t offset);
+
+    // То же, но документы заменяют содержимое documents, а память кучи
+    // остается для следующего отбора
+    void Extract(size_t offset, std::vector<Document>& documents);
+
+    // Начинает новый отбор с другой емкостью, сохраняя память кучи
+    void Reset(size_t capacity);
+
+   private:
+    size_t capacity_;
+    std::vector<Document> heap_;
+};
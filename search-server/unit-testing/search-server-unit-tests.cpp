@@ -1,7 +1,36 @@
 // -------- Начало модульных тестов поисковой системы ----------
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <random>
+#include <thread>
+
+#include "../allocation_counter.h"
+#include "../compressed_posting_list.h"
+#include "../concurrent_search_server.h"
+#include "../directory_indexer.h"
+#include "../read_input_functions.h"
+#include "../durable_search_server.h"
+#include "../process_queries.h"
+#include "../query_executor.h"
+#include "../query_result_cache.h"
 #include "../search_server.h"
+#include "../shard_coordinator.h"
+#include "../shard_protocol.h"
+#include "../shard_server.h"
+#include "../sharded_search_server.h"
+#include "../stop_word_set.h"
+#include "../string_arena.h"
+#include "../string_processing.h"
 #include "test-framework.h"
 
 void TestExcludeStopWordsFromAddedDocumentContent() {
@@ -54,6 +83,17 @@ void TestDocumentMatch() {
             const auto [words, status] = server.MatchDocument("-in cat"s, 42);
             ASSERT(words.empty());
         }
+
+        // minus-words are checked the same way by the parallel version
+        {
+            server.AddDocument(43, "dog in the city"s, DocumentStatus::BANNED, ratings);
+            const auto [words, status] =
+                server.MatchDocument(execution::par, "-cat city"s, 43);
+            const vector<string_view> expected_result = {"city"sv};
+            ASSERT_EQUAL(words, expected_result);
+            ASSERT(status == DocumentStatus::BANNED);
+            ASSERT(get<0>(server.MatchDocument(execution::par, "-cat city"s, 42)).empty());
+        }
     }
 }
 
@@ -237,6 +277,1866 @@ void TestRating() {
 
 void TestGetWordFrequencies() { SearchServer search_server(""s); }
 
+void TestTermDictionaryAfterRemoval() {
+    SearchServer server(""s);
+    // короткие тексты хранятся в SSO-буфере и перемещаются при росте вектора
+    for (int id = 0; id < 100; ++id) {
+        server.AddDocument(id, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    }
+    server.AddDocument(100, "cat bird"s, DocumentStatus::ACTUAL, {1});
+
+    ASSERT_EQUAL(server.FindTopDocuments("bird"s).size(), 1);
+    ASSERT_EQUAL(server.GetWordFrequencies(0).count("dog"sv), 1);
+
+    server.RemoveDocument(100);
+    ASSERT(server.FindTopDocuments("bird"s).empty());
+
+    server.AddDocument(101, "bird"s, DocumentStatus::ACTUAL, {1});
+    const auto [words, status] = server.MatchDocument("bird cat"s, 101);
+    const vector<string_view> expected_result = {"bird"sv};
+    ASSERT_EQUAL(words, expected_result);
+
+    // слово удаляется из словаря, даже если его вхождения в сегментах
+    // только помечены удаленными
+    SearchServer sealed(""s);
+    sealed.SetCompactionThreshold(1.0);
+    sealed.SetSegmentBufferSize(1);
+    const vector<string> texts = {"cat dog"s, "cat bird"s, "cat fish"s, "cat owl"s};
+    for (int id = 0; id < 4; ++id) {
+        sealed.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {1});
+    }
+    ASSERT_EQUAL(sealed.GetIndexStatistics().term_count, 5u);
+    sealed.RemoveDocument(1);
+    ASSERT_EQUAL(sealed.GetIndexStatistics().term_count, 4u);
+    sealed.RemoveDocument(execution::par, 2);
+    ASSERT_EQUAL(sealed.GetIndexStatistics().term_count, 3u);
+    sealed.RemoveDocuments({3});
+    ASSERT_EQUAL(sealed.GetIndexStatistics().term_count, 2u);
+    sealed.RemoveDocuments(execution::par, {0});
+    ASSERT_EQUAL(sealed.GetIndexStatistics().term_count, 0u);
+    sealed.AddDocument(4, "bird cat"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(sealed.GetIndexStatistics().term_count, 2u);
+    ASSERT_EQUAL(sealed.FindTopDocuments("bird"s).size(), 1u);
+    ASSERT_EQUAL(sealed.FindTopDocuments("cat -dog"s).size(), 1u);
+}
+
+void TestCompressedPostingList() {
+    mt19937 generator;
+    CompressedPostingList postings;
+    map<int, double> expected;
+    for (int i = 0; i < 5000; ++i) {
+        const int id = uniform_int_distribution(0, 3000)(generator);
+        if (uniform_int_distribution(0, 3)(generator) == 0) {
+            postings.Erase(id);
+            expected.erase(id);
+        } else if (expected.count(id) == 0) {
+            const double term_freq = uniform_real_distribution(0.01, 1.0)(generator);
+            postings.Add(id, term_freq);
+            expected[id] = term_freq;
+        }
+    }
+
+    ASSERT_EQUAL(postings.size(), expected.size());
+    auto it = expected.begin();
+    postings.ForEach([&](int document_id, double term_freq) {
+        ASSERT_EQUAL(document_id, it->first);
+        ASSERT(std::abs(term_freq - it->second) < 1e-4);
+        ++it;
+    });
+    ASSERT(it == expected.end());
+
+    // разности всех ширин; блоки разной длины заканчиваются неполной
+    // четверкой полос
+    for (int bit_width = 0; bit_width <= 24; ++bit_width) {
+        for (const int count : {1, 2, 5, 128, 130, 259}) {
+            CompressedPostingList list;
+            vector<int> ids;
+            int id = 0;
+            for (int i = 0; i < count; ++i) {
+                ids.push_back(id);
+                list.Add(id, 0.5);
+                id += 1 + (i % 3 == 0 ? (1 << bit_width) - 1 : i % (1 << bit_width));
+            }
+            size_t position = 0;
+            list.ForEach([&](int document_id, double) {
+                ASSERT_EQUAL_HINT(document_id, ids[position], to_string(bit_width));
+                ++position;
+            });
+            ASSERT_EQUAL(position, ids.size());
+        }
+    }
+}
+
+void TestCompressedLayout() {
+    SearchServer plain(""s);
+    SearchServer compressed(""s, IndexLayout::COMPRESSED);
+    for (int id = 0; id < 500; ++id) {
+        const string text = "w"s + to_string(id % 7) + " w"s + to_string(id % 11) +
+                            " w"s + to_string(id % 13);
+        plain.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+        compressed.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+    }
+    for (int id = 0; id < 500; id += 3) {
+        plain.RemoveDocument(id);
+        compressed.RemoveDocument(id);
+    }
+
+    for (const string& query : {"w1 w2"s, "w3 -w4"s, "w5 w10 w12 -w0"s}) {
+        const vector<Document> expected = plain.FindTopDocuments(query);
+        const vector<Document> result = compressed.FindTopDocuments(query);
+        ASSERT_EQUAL(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); ++i) {
+            ASSERT_EQUAL(result[i].id, expected[i].id);
+            ASSERT(std::abs(result[i].relevance - expected[i].relevance) < 1e-4);
+        }
+    }
+
+    const IndexStatistics plain_statistics = plain.GetIndexStatistics();
+    const IndexStatistics compressed_statistics =
+        compressed.GetIndexStatistics();
+    ASSERT_EQUAL(compressed_statistics.posting_count,
+                 plain_statistics.posting_count);
+    ASSERT(compressed_statistics.postings_bytes <
+           plain_statistics.postings_bytes);
+}
+
+void TestResultPages() {
+    SearchServer server(""s);
+    for (int id = 0; id < 20; ++id) {
+        server.AddDocument(id, "cat"s + string(id, 'x') + " cat"s, DocumentStatus::ACTUAL,
+                           {id % 4});
+    }
+    server.AddDocument(20, "dog"s, DocumentStatus::ACTUAL, {1});
+
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), MAX_RESULT_DOCUMENT_COUNT);
+
+    const vector<Document> all_documents =
+        server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, {0, 100});
+    ASSERT_EQUAL(all_documents.size(), 20);
+    for (size_t i = 1; i < all_documents.size(); ++i) {
+        ASSERT(!IsMoreRelevant(all_documents[i], all_documents[i - 1]));
+    }
+
+    const vector<Document> page =
+        server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, {7, 6});
+    ASSERT_EQUAL(page.size(), 6);
+    for (size_t i = 0; i < page.size(); ++i) {
+        ASSERT_EQUAL(page[i].id, all_documents[7 + i].id);
+    }
+
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, {18, 5}).size(), 2);
+    ASSERT(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, {20, 5}).empty());
+    ASSERT(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, {0, 0}).empty());
+}
+
+void TestWandMatchesExhaustive() {
+    mt19937 generator;
+    const auto random_text = [&generator](int word_count) {
+        string text;
+        for (int i = 0; i < word_count; ++i) {
+            // неравномерное распределение дает и частые, и редкие слова
+            const int word = static_cast<int>(
+                exponential_distribution(0.05)(generator));
+            text += (uniform_int_distribution(0, 9)(generator) == 0 ? " -w"s : " w"s) +
+                    to_string(word);
+        }
+        return text;
+    };
+
+    for (const IndexLayout layout : {IndexLayout::PLAIN, IndexLayout::COMPRESSED}) {
+        SearchServer server(""s, layout);
+        for (int id = 0; id < 2000; ++id) {
+            string text = random_text(20);
+            replace(text.begin(), text.end(), '-', 'x');
+            server.AddDocument(id * 3, text, DocumentStatus::ACTUAL,
+                               {uniform_int_distribution(0, 5)(generator)});
+        }
+        const auto predicate = [](int id, DocumentStatus, int rating) {
+            return id % 7 != 0 && rating != 3;
+        };
+
+        for (int i = 0; i < 50; ++i) {
+            const string query = random_text(1 + i % 6);
+            const ResultPage page{static_cast<size_t>(i % 3), 10};
+
+            server.SetRetrievalEngine(RetrievalEngine::EXHAUSTIVE);
+            const vector<Document> expected = server.FindTopDocuments(query, predicate, page);
+            server.SetRetrievalEngine(RetrievalEngine::WAND);
+            const vector<Document> result = server.FindTopDocuments(query, predicate, page);
+
+            ASSERT_EQUAL_HINT(result.size(), expected.size(), query);
+            for (size_t j = 0; j < result.size(); ++j) {
+                ASSERT_EQUAL_HINT(result[j].id, expected[j].id, query);
+                ASSERT(std::abs(result[j].relevance - expected[j].relevance) < 1e-9);
+            }
+        }
+    }
+
+    // документы с минус-словами и удаленные не доходят до предиката
+    SearchServer server(""s);
+    for (int id = 0; id < 300; ++id) {
+        server.AddDocument(id, "cat w"s + to_string(id % 5) + (id % 3 == 0 ? " dog"s : ""s),
+                           DocumentStatus::ACTUAL, {1});
+    }
+    server.RemoveDocument(4);
+    server.SetRetrievalEngine(RetrievalEngine::WAND);
+    vector<int> checked_ids;
+    const vector<Document> result = server.FindTopDocuments(
+        "cat w1 -dog"s,
+        [&checked_ids](int id, DocumentStatus, int) {
+            checked_ids.push_back(id);
+            return true;
+        },
+        ResultPage{0, 1000});
+    ASSERT_EQUAL(result.size(), 199u);
+    for (const int id : checked_ids) {
+        ASSERT_HINT(id % 3 != 0 && id != 4, to_string(id));
+    }
+}
+
+void TestParallelMatchesSequential() {
+    SearchServer server(""s);
+    const int document_count = static_cast<int>(MIN_PARALLEL_CHUNK_SIZE) * 3;
+    for (int id = 0; id < document_count; ++id) {
+        const string text = "w"s + to_string(id % 17) + " w"s + to_string(id % 19) +
+                            " w"s + to_string(id % 23) + " w"s + to_string(id % 101);
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 10});
+    }
+    for (int id = 0; id < document_count; id += 5) {
+        server.RemoveDocument(id);
+    }
+
+    for (const string& query : {"w1 w2 w3"s, "w5 w77 -w6"s, "w0 w18 w100 -w1"s}) {
+        const vector<Document> expected =
+            server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, {0, 50});
+        const vector<Document> result =
+            server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, {0, 50});
+        ASSERT_EQUAL(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); ++i) {
+            ASSERT_EQUAL(result[i].id, expected[i].id);
+        }
+    }
+}
+
+void TestImpactEngine() {
+    // в документе id слово cat встречается id раз, поэтому релевантности
+    // документов различаются сильнее шага квантования
+    const auto make_text = [](int id) {
+        string text;
+        for (int i = 0; i < 20; ++i) {
+            text += (i < id ? " cat"s : " f"s + to_string(id)) +
+                    (i % 2 == 0 ? " dog"s : ""s);
+        }
+        return text;
+    };
+    SearchServer server(""s);
+    for (int id = 0; id < 20; ++id) {
+        server.AddDocument(id, make_text(id), DocumentStatus::ACTUAL, {id % 4});
+    }
+    for (int id = 100; id < 300; ++id) {
+        server.AddDocument(id, "dog bird"s, DocumentStatus::ACTUAL, {1});
+    }
+    server.BuildImpactIndex();
+
+    const auto predicate = [](int id, DocumentStatus, int) { return id % 5 != 0; };
+    for (const string& query : {"cat"s, "cat dog"s, "cat -f19"s, "f3 f7 cat"s}) {
+        for (const ResultPage page : {ResultPage{}, ResultPage{3, 4}, ResultPage{0, 30}}) {
+            server.SetRetrievalEngine(RetrievalEngine::EXHAUSTIVE);
+            const vector<Document> expected = server.FindTopDocuments(query, predicate, page);
+            server.SetRetrievalEngine(RetrievalEngine::IMPACT);
+            const vector<Document> result = server.FindTopDocuments(query, predicate, page);
+
+            ASSERT_EQUAL_HINT(result.size(), expected.size(), query);
+            for (size_t i = 0; i < result.size(); ++i) {
+                ASSERT_EQUAL_HINT(result[i].id, expected[i].id, query);
+                ASSERT_EQUAL_HINT(result[i].relevance, expected[i].relevance, query);
+            }
+        }
+    }
+
+    // устаревший индекс вкладов не используется
+    server.AddDocument(500, "cat cat cat"s, DocumentStatus::ACTUAL, {1});
+    server.SetRetrievalEngine(RetrievalEngine::IMPACT);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s)[0].id, 500);
+    server.RemoveDocument(500);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s)[0].id, 19);
+
+    // счетчики потока после запроса, прерванного предикатом, не влияют
+    // на следующий запрос
+    server.BuildImpactIndex();
+    const auto throwing_predicate = [](int id, DocumentStatus, int) {
+        if (id == 19) {
+            throw runtime_error("predicate"s);
+        }
+        return true;
+    };
+    for (const RetrievalEngine engine : {RetrievalEngine::EXHAUSTIVE, RetrievalEngine::IMPACT}) {
+        server.SetRetrievalEngine(engine);
+        const vector<Document> expected = server.FindTopDocuments("cat -f19"s, predicate);
+        try {
+            server.FindTopDocuments("cat dog"s, throwing_predicate);
+            ASSERT_HINT(false, "Predicate exception must propagate"s);
+        } catch (const runtime_error&) {
+        }
+        const vector<Document> result = server.FindTopDocuments("cat -f19"s, predicate);
+        ASSERT_EQUAL(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); ++i) {
+            ASSERT_EQUAL(result[i].id, expected[i].id);
+            ASSERT_EQUAL(result[i].relevance, expected[i].relevance);
+        }
+    }
+}
+
+void TestInverseDocumentFreqAfterRemoval() {
+    SearchServer server(""s);
+    SearchServer expected_server(""s);
+    const vector<string> texts = {"cat dog"s, "cat bird"s, "fish"s, "dog fish"s};
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {1});
+        if (id != 1) {
+            expected_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {1});
+        }
+    }
+    server.RemoveDocument(1);
+
+    const vector<Document> result = server.FindTopDocuments("cat fish"s);
+    const vector<Document> expected = expected_server.FindTopDocuments("cat fish"s);
+    ASSERT_EQUAL(result.size(), expected.size());
+    for (size_t i = 0; i < result.size(); ++i) {
+        ASSERT_EQUAL(result[i].id, expected[i].id);
+        ASSERT(std::abs(result[i].relevance - expected[i].relevance) < 1e-12);
+    }
+}
+
+void TestAddDocuments() {
+    const vector<string> texts = {"white cat and fancy collar"s, "fluffy cat fluffy tail"s,
+                                  "groomed dog expressive eyes"s, "groomed starling eugene"s,
+                                  "cat"s, ""s};
+    for (const IndexLayout layout : {IndexLayout::PLAIN, IndexLayout::COMPRESSED}) {
+        SearchServer expected_server("and"s, layout);
+        vector<NewDocument> documents;
+        for (int i = 0; i < 200; ++i) {
+            const string& text = texts[i % texts.size()];
+            expected_server.AddDocument(i * 2, text, DocumentStatus::ACTUAL, {i % 7});
+            documents.push_back({i * 2, text, DocumentStatus::ACTUAL, {i % 7}});
+        }
+
+        SearchServer seq_server("and"s, layout);
+        SearchServer par_server("and"s, layout);
+        seq_server.AddDocument(1000, "fluffy dog"s, DocumentStatus::ACTUAL, {1});
+        par_server.AddDocument(1000, "fluffy dog"s, DocumentStatus::ACTUAL, {1});
+        expected_server.AddDocument(1000, "fluffy dog"s, DocumentStatus::ACTUAL, {1});
+        const IngestionStatistics statistics = seq_server.AddDocuments(documents);
+        par_server.AddDocuments(execution::par, documents);
+        ASSERT_EQUAL(statistics.document_count, documents.size());
+
+        for (const SearchServer* server : {&seq_server, &par_server}) {
+            ASSERT_EQUAL(server->GetDocumentCount(), expected_server.GetDocumentCount());
+            for (const int id : expected_server) {
+                ASSERT(server->GetWordFrequencies(id) == expected_server.GetWordFrequencies(id));
+            }
+            for (const string& query : {"fluffy cat"s, "groomed -dog"s, "eyes tail cat"s}) {
+                const ResultPage page{0, 20};
+                const vector<Document> result = server->FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                const vector<Document> expected =
+                    expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                ASSERT_EQUAL_HINT(result.size(), expected.size(), query);
+                for (size_t i = 0; i < result.size(); ++i) {
+                    ASSERT_EQUAL_HINT(result[i].id, expected[i].id, query);
+                    ASSERT_EQUAL_HINT(result[i].relevance, expected[i].relevance, query);
+                }
+            }
+        }
+    }
+
+    // некорректный пакет не меняет сервер
+    SearchServer server(""s);
+    server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    for (const vector<NewDocument>& documents :
+         {vector<NewDocument>{{2, "dog"sv, DocumentStatus::ACTUAL, {1}},
+                              {1, "dog"sv, DocumentStatus::ACTUAL, {1}}},
+          vector<NewDocument>{{2, "dog"sv, DocumentStatus::ACTUAL, {1}},
+                              {2, "dog"sv, DocumentStatus::ACTUAL, {1}}},
+          vector<NewDocument>{{-2, "dog"sv, DocumentStatus::ACTUAL, {1}}},
+          vector<NewDocument>{{2, "d\x12og"sv, DocumentStatus::ACTUAL, {1}}}}) {
+        try {
+            server.AddDocuments(execution::par, documents);
+            ASSERT_HINT(false, "invalid batch was accepted"s);
+        } catch (const invalid_argument&) {
+        }
+        ASSERT_EQUAL(server.GetDocumentCount(), 1u);
+        ASSERT(server.FindTopDocuments("dog"s).empty());
+    }
+}
+
+void TestStringArena() {
+    StringArena arena(64);
+    vector<string> expected;
+    vector<string_view> views;
+    for (int i = 0; i < 500; ++i) {
+        // короткие строки делят блоки, длинные получают собственные
+        expected.push_back(string(i % 40, static_cast<char>('a' + i % 26)));
+        views.push_back(arena.Add(expected.back()));
+    }
+    StringArena moved_arena = std::move(arena);
+    for (size_t i = 0; i < views.size(); ++i) {
+        ASSERT_EQUAL(views[i], expected[i]);
+    }
+    ASSERT(moved_arena.GetMemoryUsage() >= 500 * 19);
+
+    // строки сервера не зависят от исходного текста
+    SearchServer server(""s);
+    for (int id = 0; id < 100; ++id) {
+        string text = "w"s + to_string(id) + " cat"s;
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {1});
+        text.assign(text.size(), 'x');
+    }
+    ASSERT_EQUAL(server.GetWordFrequencies(42).count("w42"sv), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("w7"s)[0].id, 7);
+}
+
+void TestCompaction() {
+    const auto make_text = [](int id) {
+        return "common word"s + to_string(id % 10) + " long document text number "s +
+               to_string(id);
+    };
+    for (const IndexLayout layout : {IndexLayout::PLAIN, IndexLayout::COMPRESSED}) {
+        SearchServer server(""s, layout);
+        SearchServer expected_server(""s, layout);
+        for (int id = 0; id < 300; ++id) {
+            server.AddDocument(id, make_text(id), DocumentStatus::ACTUAL, {id % 5});
+            if (id % 3 != 0) {
+                expected_server.AddDocument(id, make_text(id), DocumentStatus::ACTUAL, {id % 5});
+            }
+        }
+        for (int id = 0; id < 300; id += 3) {
+            server.RemoveDocument(id);
+        }
+
+        const auto check_results = [&]() {
+            ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+            for (const string& query : {"word3 number"s, "common -word4"s, "12 text 15"s}) {
+                const ResultPage page{0, 50};
+                const vector<Document> result = server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                const vector<Document> expected =
+                    expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                ASSERT_EQUAL_HINT(result.size(), expected.size(), query);
+                for (size_t i = 0; i < result.size(); ++i) {
+                    ASSERT_EQUAL_HINT(result[i].id, expected[i].id, query);
+                    ASSERT(std::abs(result[i].relevance - expected[i].relevance) < 1e-12);
+                }
+            }
+        };
+
+        // удаленные документы не находятся еще до сжатия
+        check_results();
+        const CompactionStatistics statistics = server.Compact();
+        ASSERT_EQUAL(statistics.removed_document_count, 100u);
+        ASSERT(statistics.reclaimed_bytes > 0);
+        check_results();
+
+        const auto [words, status] = server.MatchDocument("common number"s, 4);
+        ASSERT_EQUAL(words, vector<string_view>({"common"sv, "number"sv}));
+        server.AddDocument(3, make_text(3), DocumentStatus::ACTUAL, {3});
+        expected_server.AddDocument(3, make_text(3), DocumentStatus::ACTUAL, {3});
+        check_results();
+    }
+
+    // сжатие по порогу
+    SearchServer server(""s);
+    for (int id = 0; id < 100; ++id) {
+        server.AddDocument(id, make_text(id), DocumentStatus::ACTUAL, {1});
+    }
+    server.SetCompactionThreshold(0.25);
+    for (int id = 0; id < 30; ++id) {
+        server.RemoveDocument(id);
+    }
+    ASSERT_EQUAL(server.Compact().removed_document_count, 4u);
+
+    // подготовка сжатия в фоне одновременно с поиском
+    for (int id = 30; id < 60; ++id) {
+        server.RemoveDocument(id);
+    }
+    auto compaction = async(launch::async, [&server]() { return server.BuildCompaction(); });
+    ASSERT_EQUAL(server.FindTopDocuments("number 75"s)[0].id, 75);
+    const optional<CompactionStatistics> statistics = server.ApplyCompaction(compaction.get());
+    ASSERT(statistics.has_value());
+    ASSERT_EQUAL(server.FindTopDocuments("number 75"s)[0].id, 75);
+
+    // индексы, подготовленные до изменения документов, не применяются
+    server.RemoveDocument(60);
+    SearchServer::Compaction outdated_compaction = server.BuildCompaction();
+    server.RemoveDocument(61);
+    ASSERT(!server.ApplyCompaction(std::move(outdated_compaction)).has_value());
+    ASSERT(server.FindTopDocuments("number 61"s).size() > 0);
+    ASSERT(server.FindTopDocuments("61"s).empty());
+}
+
+void TestRemoveDocuments() {
+    const auto make_text = [](int id) {
+        return "common word"s + to_string(id % 10) + " rare"s + to_string(id);
+    };
+    for (const IndexLayout layout : {IndexLayout::PLAIN, IndexLayout::COMPRESSED}) {
+        for (const bool parallel : {false, true}) {
+            SearchServer server(""s, layout);
+            SearchServer expected_server(""s, layout);
+            vector<int> removed_ids = {-1, 5000, 7, 7};
+            for (int id = 0; id < 1000; ++id) {
+                server.AddDocument(id, make_text(id), DocumentStatus::ACTUAL, {id % 5});
+                if (id % 4 == 1 || id == 7) {
+                    removed_ids.push_back(id);
+                } else {
+                    expected_server.AddDocument(id, make_text(id), DocumentStatus::ACTUAL,
+                                                {id % 5});
+                }
+            }
+            if (parallel) {
+                server.RemoveDocuments(execution::par, removed_ids);
+            } else {
+                server.RemoveDocuments(removed_ids);
+            }
+
+            ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+            ASSERT_EQUAL(server.GetIndexStatistics().term_count,
+                         expected_server.GetIndexStatistics().term_count);
+            ASSERT_EQUAL(server.GetIndexStatistics().posting_count,
+                         expected_server.GetIndexStatistics().posting_count);
+            for (const string& query : {"word1 rare13"s, "common -word3"s, "rare8 rare9 word7"s}) {
+                const ResultPage page{0, 100};
+                const vector<Document> result = server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                const vector<Document> expected =
+                    expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                ASSERT_EQUAL_HINT(result.size(), expected.size(), query);
+                for (size_t i = 0; i < result.size(); ++i) {
+                    ASSERT_EQUAL_HINT(result[i].id, expected[i].id, query);
+                    ASSERT(std::abs(result[i].relevance - expected[i].relevance) < 1e-12);
+                }
+            }
+            ASSERT_EQUAL(server.Compact().removed_document_count, 251u);
+        }
+    }
+}
+
+void TestSegmentedIndex() {
+    const auto make_text = [](int id) {
+        return "common word"s + to_string(id % 10) + " rare"s + to_string(id);
+    };
+    for (const IndexLayout layout : {IndexLayout::PLAIN, IndexLayout::COMPRESSED}) {
+        SearchServer server(""s, layout);
+        SearchServer expected_server(""s, layout);
+        // буфер запечатывается примерно через каждые 16 документов
+        server.SetSegmentBufferSize(48);
+        for (int id = 0; id < 1000; ++id) {
+            server.AddDocument(id, make_text(id), DocumentStatus::ACTUAL, {id % 5});
+            expected_server.AddDocument(id, make_text(id), DocumentStatus::ACTUAL, {id % 5});
+        }
+        vector<string> texts;
+        vector<NewDocument> documents;
+        for (int id = 1000; id < 1200; ++id) {
+            texts.push_back(make_text(id));
+        }
+        for (int id = 1000; id < 1200; ++id) {
+            documents.push_back({id, texts[id - 1000], DocumentStatus::ACTUAL, {id % 5}});
+        }
+        server.AddDocuments(execution::par, documents);
+        expected_server.AddDocuments(documents);
+        server.AddDocument(1200, "common tail"s, DocumentStatus::ACTUAL, {1});
+        expected_server.AddDocument(1200, "common tail"s, DocumentStatus::ACTUAL, {1});
+        ASSERT(server.GetIndexStatistics().segment_count > 1);
+        ASSERT_EQUAL(server.GetIndexStatistics().posting_count,
+                     expected_server.GetIndexStatistics().posting_count);
+
+        // удаления затрагивают и сегменты, и буфер записи
+        vector<int> removed_ids = {1200};
+        for (int id = 3; id < 1200; id += 7) {
+            removed_ids.push_back(id);
+        }
+        server.RemoveDocuments(execution::par, removed_ids);
+        expected_server.RemoveDocuments(removed_ids);
+        server.RemoveDocument(10);
+        expected_server.RemoveDocument(10);
+
+        server.WaitForSegmentMerges();
+        ASSERT(server.GetIndexStatistics().segment_count < 16);
+        for (const RetrievalEngine engine : {RetrievalEngine::EXHAUSTIVE, RetrievalEngine::WAND}) {
+            server.SetRetrievalEngine(engine);
+            expected_server.SetRetrievalEngine(engine);
+            for (const string& query :
+                 {"word1 rare13"s, "common -word3"s, "rare8 rare9 word7 tail"s, "rare1100 word4"s}) {
+                const ResultPage page{0, 100};
+                const vector<Document> result = server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                const vector<Document> expected =
+                    expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                ASSERT_EQUAL_HINT(result.size(), expected.size(), query);
+                for (size_t i = 0; i < result.size(); ++i) {
+                    ASSERT_EQUAL_HINT(result[i].id, expected[i].id, query);
+                    ASSERT(std::abs(result[i].relevance - expected[i].relevance) < 1e-12);
+                }
+            }
+        }
+
+        server.Compact();
+        ASSERT_EQUAL(server.GetIndexStatistics().segment_count, 1u);
+        ASSERT_EQUAL(server.FindTopDocuments("word4"s).size(),
+                     expected_server.FindTopDocuments("word4"s).size());
+    }
+}
+
+void TestCompletedMergeInstalledOnWrite() {
+    SearchServer server(""s);
+    // каждый документ запечатывается в отдельный сегмент, четвертый
+    // сегмент запускает фоновое слияние
+    server.SetSegmentBufferSize(1);
+    for (int id = 0; id < 4; ++id) {
+        server.AddDocument(id, "cat word"s + to_string(id), DocumentStatus::ACTUAL, {1});
+    }
+    ASSERT_EQUAL(server.GetIndexStatistics().segment_count, 4u);
+
+    // удаление отсутствующего документа не запечатывает буфер, но
+    // устанавливает завершенное слияние
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(30);
+    while (server.GetIndexStatistics().segment_count != 1 &&
+           chrono::steady_clock::now() < deadline) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+        server.RemoveDocument(100);
+    }
+    ASSERT_EQUAL(server.GetIndexStatistics().segment_count, 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 4u);
+}
+
+void TestShardedSearchServer() {
+    const auto make_text = [](int id) {
+        return "common word"s + to_string(id % 10) + " rare"s + to_string(id % 97) +
+               (id % 3 == 0 ? " and cat"s : " dog"s);
+    };
+    ShardedSearchServer server(3, "and"s);
+    SearchServer expected_server("and"s);
+    vector<string> texts;
+    for (int id = 0; id < 400; ++id) {
+        texts.push_back(make_text(id));
+    }
+    vector<NewDocument> documents;
+    for (int id = 0; id < 300; ++id) {
+        documents.push_back({id, texts[id], DocumentStatus::ACTUAL, {id % 7}});
+    }
+    ASSERT_EQUAL(server.AddDocuments(documents).document_count, 300u);
+    expected_server.AddDocuments(documents);
+    for (int id = 300; id < 400; ++id) {
+        server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 7});
+        expected_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 7});
+    }
+    for (int id = 5; id < 400; id += 11) {
+        server.RemoveDocument(id);
+        expected_server.RemoveDocument(id);
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+    // в каждом шарде свои частоты слов, но IDF общий
+    ASSERT(server.GetShard(0).GetDocumentCount() < server.GetDocumentCount());
+
+    for (const RetrievalEngine engine : {RetrievalEngine::EXHAUSTIVE, RetrievalEngine::WAND}) {
+        server.SetRetrievalEngine(engine);
+        expected_server.SetRetrievalEngine(engine);
+        for (const string& query : {"cat rare13"s, "common -word3"s, "word7 dog rare1 rare2"s, "missing"s}) {
+            for (const ResultPage page : {ResultPage{0, 10}, ResultPage{7, 20}}) {
+                const vector<Document> result = server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                const vector<Document> expected =
+                    expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                ASSERT_EQUAL_HINT(result.size(), expected.size(), query);
+                for (size_t i = 0; i < result.size(); ++i) {
+                    ASSERT_EQUAL_HINT(result[i].id, expected[i].id, query);
+                    ASSERT_EQUAL_HINT(result[i].relevance, expected[i].relevance, query);
+                }
+                const vector<Document> sequential =
+                    server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, page);
+                ASSERT_EQUAL_HINT(sequential.size(), expected.size(), query);
+                for (size_t i = 0; i < sequential.size(); ++i) {
+                    ASSERT_EQUAL_HINT(sequential[i].id, expected[i].id, query);
+                    ASSERT_EQUAL_HINT(sequential[i].relevance, expected[i].relevance, query);
+                }
+            }
+        }
+    }
+
+    const auto [words, status] = server.MatchDocument("cat dog word4"s, 4);
+    ASSERT_EQUAL(words, get<0>(expected_server.MatchDocument("cat dog word4"s, 4)));
+    ASSERT(status == DocumentStatus::ACTUAL);
+    ASSERT_EQUAL(get<0>(server.MatchDocument(execution::par, "cat dog word4"s, 4)), words);
+
+    const vector<int> removed_ids = {1, 2, 3, 5, 6, -1, 1000};
+    server.RemoveDocuments(execution::par, removed_ids);
+    expected_server.RemoveDocuments(removed_ids);
+    ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+    const vector<Document> after_removal = server.FindTopDocuments(execution::par, "cat dog"s);
+    const vector<Document> expected_after_removal = expected_server.FindTopDocuments("cat dog"s);
+    ASSERT_EQUAL(after_removal.size(), expected_after_removal.size());
+    for (size_t i = 0; i < after_removal.size(); ++i) {
+        ASSERT_EQUAL(after_removal[i].id, expected_after_removal[i].id);
+    }
+
+    try {
+        server.AddDocuments({{401, "new"sv, DocumentStatus::ACTUAL, {}}, {4, "duplicate"sv, DocumentStatus::ACTUAL, {}}});
+        ASSERT_HINT(false, "Duplicate id must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+    try {
+        server.FindTopDocuments("cat --dog"s);
+        ASSERT_HINT(false, "Invalid query must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestShardServerConnections() {
+    SearchServer search_server(""s);
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    const string address = "/tmp/search-server-test-"s + to_string(getpid()) + "-connections.sock"s;
+    ShardServer shard_server(search_server, address, chrono::milliseconds(200));
+    const pid_t child = fork();
+    if (child == 0) {
+        shard_server.Serve();
+        _exit(0);
+    }
+
+    // молчащее соединение не задерживает остальные и закрывается шардом
+    // по тайм-ауту
+    const int idle = ConnectToAddress(address, chrono::seconds(5));
+    const int active = ConnectToAddress(address, chrono::seconds(5));
+    ASSERT(idle >= 0 && active >= 0);
+    MessageWriter request(ShardMessageType::STATISTICS_REQUEST);
+    request.WriteString("cat"sv);
+    ASSERT(SendMessage(active, request.GetMessage()));
+    string buffer;
+    const optional<string> response = ReceiveMessage(active, buffer);
+    ASSERT(response.has_value());
+    MessageReader reader(*response);
+    ASSERT(reader.GetType() == ShardMessageType::STATISTICS_RESPONSE);
+    ASSERT_EQUAL(ReadCorpusStatistics(reader).document_count, 1u);
+
+    pollfd poll_socket = {idle, POLLIN, 0};
+    ASSERT_EQUAL(poll(&poll_socket, 1, 5000), 1);
+    char byte = 0;
+    ASSERT_EQUAL(recv(idle, &byte, 1, 0), 0);
+
+    close(idle);
+    close(active);
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    unlink(address.c_str());
+}
+
+void TestShardCoordinator() {
+    const auto make_text = [](int id) {
+        return "common word"s + to_string(id % 10) + " rare"s + to_string(id % 97) +
+               (id % 3 == 0 ? " and cat"s : " dog"s);
+    };
+    const size_t shard_count = 2;
+    SearchServer expected_server("and"s);
+    vector<unique_ptr<SearchServer>> shards;
+    vector<string> addresses;
+    for (size_t shard = 0; shard < shard_count + 1; ++shard) {
+        shards.push_back(make_unique<SearchServer>("and"s));
+        addresses.push_back("/tmp/search-server-test-"s + to_string(getpid()) + "-"s +
+                            to_string(shard) + ".sock"s);
+    }
+    for (int id = 0; id < 400; ++id) {
+        const string text = make_text(id);
+        shards[id % shard_count]->AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+        expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+    }
+
+    // шарды работают в дочерних процессах; последний адрес принимает
+    // соединения, но не отвечает
+    vector<pid_t> children;
+    for (size_t shard = 0; shard < shard_count; ++shard) {
+        ShardServer shard_server(*shards[shard], addresses[shard]);
+        const pid_t child = fork();
+        if (child == 0) {
+            shard_server.Serve();
+            _exit(0);
+        }
+        children.push_back(child);
+    }
+    const int hung_shard = ListenOnAddress(addresses[shard_count]);
+
+    {
+        ShardCoordinator coordinator(vector<string>(addresses.begin(), addresses.begin() + shard_count),
+                                     chrono::seconds(10));
+        for (const string& query : {"cat rare13"s, "common -word3"s, "word7 dog rare1 rare2"s, "missing"s}) {
+            for (const ResultPage page : {ResultPage{0, 10}, ResultPage{7, 20}}) {
+                const DistributedSearchResult result =
+                    coordinator.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                const vector<Document> expected =
+                    expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+                ASSERT(!result.IsPartial());
+                ASSERT_EQUAL_HINT(result.documents.size(), expected.size(), query);
+                for (size_t i = 0; i < expected.size(); ++i) {
+                    ASSERT_EQUAL_HINT(result.documents[i].id, expected[i].id, query);
+                    ASSERT_EQUAL_HINT(result.documents[i].relevance, expected[i].relevance, query);
+                }
+            }
+        }
+        try {
+            coordinator.FindTopDocuments("cat --dog"s);
+            ASSERT_HINT(false, "Invalid query must be rejected"s);
+        } catch (const invalid_argument&) {
+        }
+    }
+    {
+        ShardCoordinator coordinator(addresses, chrono::milliseconds(100));
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            const DistributedSearchResult result = coordinator.FindTopDocuments("cat"s);
+            ASSERT(result.IsPartial());
+            ASSERT_EQUAL(result.shard_count, shard_count + 1);
+            ASSERT_EQUAL(result.responded_shard_count, shard_count);
+            ASSERT_EQUAL(result.documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+        }
+    }
+
+    // некорректные адреса и сообщения - отказ шарда, а не ошибка запроса
+    {
+        const string broken_address = addresses[shard_count] + ".broken"s;
+        const int broken_shard = ListenOnAddress(broken_address);
+        atomic<bool> stopping = false;
+        // отвечает на каждое соединение сообщением ERROR без текста
+        thread broken_server([broken_shard, &stopping]() {
+            while (!stopping) {
+                pollfd poll_socket = {broken_shard, POLLIN, 0};
+                if (poll(&poll_socket, 1, 10) <= 0) {
+                    continue;
+                }
+                const int connection = accept(broken_shard, nullptr, nullptr);
+                const string frame("\x01\0\0\0\x04", 5);
+                send(connection, frame.data(), frame.size(), MSG_NOSIGNAL);
+                close(connection);
+            }
+        });
+        vector<string> shard_addresses(addresses.begin(), addresses.begin() + shard_count);
+        for (const string& address : {"no-port"s, "shard.invalid:1"s, broken_address}) {
+            shard_addresses.push_back(address);
+        }
+        ShardCoordinator coordinator(shard_addresses, chrono::milliseconds(500));
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            const DistributedSearchResult result = coordinator.FindTopDocuments("cat"s);
+            ASSERT_EQUAL(result.shard_count, shard_count + 3);
+            ASSERT_EQUAL(result.responded_shard_count, shard_count);
+            ASSERT_EQUAL(result.documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+        }
+        stopping = true;
+        broken_server.join();
+        close(broken_shard);
+        unlink(broken_address.c_str());
+    }
+
+    for (const pid_t child : children) {
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+    }
+    close(hung_shard);
+    for (const string& address : addresses) {
+        unlink(address.c_str());
+    }
+}
+
+void TestSnapshot() {
+    const auto make_text = [](int id) {
+        return "common word"s + to_string(id % 10) + " rare"s + to_string(id % 97) +
+               (id % 3 == 0 ? " and cat"s : " dog"s);
+    };
+    const string path = "/tmp/search-server-test-"s + to_string(getpid()) + ".snapshot"s;
+    for (const IndexLayout layout : {IndexLayout::PLAIN, IndexLayout::COMPRESSED}) {
+        SearchServer expected_server("and"s, layout);
+        {
+            SearchServer server("and"s, layout);
+            for (int id = 0; id < 500; ++id) {
+                server.AddDocument(id, make_text(id), DocumentStatus::ACTUAL, {id % 7});
+                expected_server.AddDocument(id, make_text(id), DocumentStatus::ACTUAL, {id % 7});
+            }
+            server.AddDocument(500, "only removed"s, DocumentStatus::BANNED, {1});
+            server.RemoveDocument(500);
+            for (int id = 3; id < 500; id += 9) {
+                server.RemoveDocument(id);
+                expected_server.RemoveDocument(id);
+            }
+            const SnapshotStatistics statistics = server.SaveSnapshot(path);
+            ASSERT_EQUAL(statistics.document_count, expected_server.GetDocumentCount());
+            ASSERT(statistics.byte_count > 0);
+        }
+
+        // снимок заменяет документы и стоп-слова сервера
+        SearchServer server("cat"s, layout);
+        server.AddDocument(1000, "old document"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_EQUAL(server.LoadSnapshot(path).document_count, expected_server.GetDocumentCount());
+        ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+        ASSERT(server.FindTopDocuments("old"s).empty());
+        ASSERT(server.FindTopDocuments("removed"s).empty());
+        ASSERT_EQUAL(server.GetIndexStatistics().term_count, expected_server.GetIndexStatistics().term_count);
+        for (const string& query : {"cat rare13"s, "common -word3"s, "word7 dog rare1 and"s}) {
+            const ResultPage page{0, 50};
+            const vector<Document> result = server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+            const vector<Document> expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, page);
+            ASSERT_EQUAL_HINT(result.size(), expected.size(), query);
+            for (size_t i = 0; i < result.size(); ++i) {
+                ASSERT_EQUAL_HINT(result[i].id, expected[i].id, query);
+                ASSERT(std::abs(result[i].relevance - expected[i].relevance) < 1e-12);
+            }
+        }
+        ASSERT(server.GetWordFrequencies(42) == expected_server.GetWordFrequencies(42));
+        ASSERT_EQUAL(get<0>(server.MatchDocument("cat common"s, 42)),
+                     get<0>(expected_server.MatchDocument("cat common"s, 42)));
+
+        // снимок заменяется новым файлом, и отображение прежнего остается
+        // целым
+        ASSERT_EQUAL(server.SaveSnapshot(path).document_count, expected_server.GetDocumentCount());
+        ASSERT_EQUAL(server.FindTopDocuments("cat rare13"s).size(),
+                     expected_server.FindTopDocuments("cat rare13"s).size());
+        ASSERT_EQUAL(SearchServer(""s, layout).LoadSnapshot(path).document_count,
+                     expected_server.GetDocumentCount());
+
+        // загруженный сервер можно изменять
+        server.AddDocument(600, "fresh cat"s, DocumentStatus::ACTUAL, {5});
+        server.RemoveDocument(42);
+        ASSERT_EQUAL(server.FindTopDocuments("fresh"s).size(), 1u);
+        ASSERT_EQUAL(server.Compact().removed_document_count, 1u);
+        ASSERT_EQUAL(server.FindTopDocuments("fresh"s).size(), 1u);
+        ASSERT_EQUAL(server.FindTopDocuments("word2"s, DocumentStatus::ACTUAL, {0, 1000}).size(),
+                     expected_server.FindTopDocuments("word2"s, DocumentStatus::ACTUAL, {0, 1000}).size() - 1);
+    }
+
+    // вхождение ссылается на документ за пределами снимка
+    {
+        SearchServer source(""s);
+        source.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+        source.AddDocument(2, "cat dog"s, DocumentStatus::ACTUAL, {1});
+        source.SaveSnapshot(path);
+        fstream file(path, ios::binary | ios::in | ios::out);
+        SnapshotHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        file.seekp(header.postings.offset + sizeof(Posting) + offsetof(Posting, document_id));
+        const int ordinal = 1000;
+        file.write(reinterpret_cast<const char*>(&ordinal), sizeof(ordinal));
+    }
+    // сжатый индекс проверяет вхождения при загрузке, отображенный -
+    // при первом обращении к списку, который обрывается перед ошибкой
+    try {
+        SearchServer(""s, IndexLayout::COMPRESSED).LoadSnapshot(path);
+        ASSERT_HINT(false, "Posting outside the snapshot must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    {
+        SearchServer server(""s);
+        ASSERT_EQUAL(server.LoadSnapshot(path).document_count, 2u);
+        const vector<Document> documents = server.FindTopDocuments("cat"s);
+        ASSERT_EQUAL(documents.size(), 1u);
+        ASSERT_EQUAL(documents[0].id, 1);
+        ASSERT_EQUAL(server.FindTopDocuments("dog"s).size(), 1u);
+    }
+
+    // слово документа вне словаря снимка
+    {
+        fstream file(path, ios::binary | ios::in | ios::out);
+        SnapshotHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        file.seekp(header.word_freqs.offset + sizeof(SnapshotWordFreq) + offsetof(SnapshotWordFreq, term_id));
+        const uint32_t term_id = 1000;
+        file.write(reinterpret_cast<const char*>(&term_id), sizeof(term_id));
+    }
+    {
+        SearchServer server(""s);
+        server.LoadSnapshot(path);
+        ASSERT_EQUAL(server.GetWordFrequencies(1).size(), 1u);
+        try {
+            server.GetWordFrequencies(2);
+            ASSERT_HINT(false, "Word outside the snapshot must be rejected"s);
+        } catch (const invalid_argument&) {
+        }
+    }
+
+    {
+        ofstream corrupted(path, ios::binary | ios::trunc);
+        corrupted << "SRCHSNAP but not really"s;
+    }
+    SearchServer server(""s);
+    server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    try {
+        server.LoadSnapshot(path);
+        ASSERT_HINT(false, "Corrupted snapshot must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 1u);
+    unlink(path.c_str());
+}
+
+void TestWriteAheadLog() {
+    const string prefix = "/tmp/search-server-test-"s + to_string(getpid());
+    const string snapshot_path = prefix + ".durable-snapshot"s;
+    const string log_path = prefix + ".wal"s;
+    unlink(snapshot_path.c_str());
+    unlink(log_path.c_str());
+
+    const auto check_documents = [](const SearchServer& server) {
+        ASSERT_EQUAL(server.GetDocumentCount(), 2u);
+        ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 1u);
+        ASSERT(server.FindTopDocuments("dog"s).empty());
+        const vector<Document> banned = server.FindTopDocuments("dog"s, DocumentStatus::BANNED);
+        ASSERT_EQUAL(banned.size(), 1u);
+        ASSERT_EQUAL(banned[0].id, 3);
+        ASSERT_EQUAL(banned[0].rating, -4);
+    };
+
+    {
+        DurableSearchServer server(snapshot_path, log_path, WalSync::FDATASYNC, "and"s);
+        ASSERT_EQUAL(server.GetRecoveryStatistics().replayed_record_count, 0u);
+        server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1, 2});
+        server.AddDocuments({{2, "black dog"sv, DocumentStatus::ACTUAL, {3}},
+                             {3, "cat and dog"sv, DocumentStatus::BANNED, {-4}}});
+        server.RemoveDocument(2);
+        try {
+            server.AddDocument(1, "duplicate"s, DocumentStatus::ACTUAL, {});
+            ASSERT_HINT(false, "Duplicate document must be rejected"s);
+        } catch (const invalid_argument&) {
+        }
+        // отклоненный документ не попадает в журнал
+        ASSERT_EQUAL(server.GetLog().GetRecordCount(), 4u);
+    }
+
+    // после аварийного завершения сервер восстанавливается из журнала
+    {
+        DurableSearchServer server(snapshot_path, log_path, WalSync::FDATASYNC, "and"s);
+        ASSERT_EQUAL(server.GetRecoveryStatistics().replayed_record_count, 4u);
+        ASSERT(!server.GetRecoveryStatistics().tail_truncated);
+        check_documents(server.GetServer());
+    }
+
+    // запись, оборванная при сбое, отбрасывается
+    {
+        ofstream log(log_path, ios::binary | ios::app);
+        log << string("\x64\0\0\0\0\0\0\0bird", 12);
+    }
+    {
+        DurableSearchServer server(snapshot_path, log_path, WalSync::FDATASYNC, "and"s);
+        ASSERT_EQUAL(server.GetRecoveryStatistics().replayed_record_count, 4u);
+        ASSERT(server.GetRecoveryStatistics().tail_truncated);
+        check_documents(server.GetServer());
+        server.AddDocument(4, "fresh cat"s, DocumentStatus::ACTUAL, {5});
+    }
+
+    // запись с неверной контрольной суммой тоже отбрасывается
+    {
+        fstream log(log_path, ios::binary | ios::in | ios::out);
+        log.seekp(-1, ios::end);
+        log.put('X');
+    }
+    {
+        DurableSearchServer server(snapshot_path, log_path, WalSync::FDATASYNC, "and"s);
+        ASSERT_EQUAL(server.GetRecoveryStatistics().replayed_record_count, 4u);
+        ASSERT(server.GetRecoveryStatistics().tail_truncated);
+        ASSERT(server.GetServer().FindTopDocuments("fresh"s).empty());
+        ASSERT_EQUAL(server.Checkpoint().document_count, 2u);
+        ASSERT_EQUAL(access((snapshot_path + ".writing"s).c_str(), F_OK), -1);
+        server.AddDocument(5, "bird"s, DocumentStatus::ACTUAL, {1});
+    }
+
+    // после контрольной точки повторяется только хвост журнала
+    {
+        DurableSearchServer server(snapshot_path, log_path, WalSync::FDATASYNC, "and"s);
+        ASSERT_EQUAL(server.GetRecoveryStatistics().snapshot_document_count, 2u);
+        ASSERT_EQUAL(server.GetRecoveryStatistics().replayed_record_count, 1u);
+        ASSERT_EQUAL(server.GetServer().FindTopDocuments("bird"s).size(), 1u);
+        ASSERT_EQUAL(server.GetServer().FindTopDocuments("cat"s).size(), 1u);
+    }
+
+    // повтор идемпотентен: журнал, уже учтенный в снимке, ничего не меняет
+    {
+        WriteAheadLog log(log_path);
+        log.WaitDurable(log.Append({WalOperation::ADD_DOCUMENT, 1, "white cat"sv, DocumentStatus::ACTUAL, {1, 2}}));
+        log.WaitDurable(log.Append({WalOperation::REMOVE_DOCUMENT, 2, {}, DocumentStatus::ACTUAL, {}}));
+    }
+    {
+        DurableSearchServer server(snapshot_path, log_path, WalSync::FDATASYNC, "and"s);
+        ASSERT_EQUAL(server.GetRecoveryStatistics().replayed_record_count, 3u);
+        ASSERT_EQUAL(server.GetServer().GetDocumentCount(), 3u);
+    }
+    unlink(snapshot_path.c_str());
+    unlink(log_path.c_str());
+
+    // записи, добавленные до ожидания, фиксируются одной группой
+    {
+        WriteAheadLog log(log_path);
+        uint64_t sequence = 0;
+        for (int id = 0; id < 10; ++id) {
+            sequence = log.Append({WalOperation::REMOVE_DOCUMENT, id, {}, DocumentStatus::ACTUAL, {}});
+        }
+        log.WaitDurable(sequence);
+        ASSERT_EQUAL(log.GetRecordCount(), 10u);
+        ASSERT_EQUAL(log.GetSyncCount(), 1u);
+        ASSERT_EQUAL(log.Replay([](const WalRecord&) {}), 10u);
+    }
+    unlink(log_path.c_str());
+
+    // одновременные изменения из нескольких потоков
+    {
+        DurableSearchServer server(snapshot_path, log_path, WalSync::FDATASYNC, ""s);
+        vector<thread> writers;
+        for (int writer = 0; writer < 4; ++writer) {
+            writers.emplace_back([&server, writer]() {
+                for (int i = 0; i < 50; ++i) {
+                    server.AddDocument(writer * 100 + i, "word"s + to_string(i), DocumentStatus::ACTUAL, {i});
+                }
+            });
+        }
+        for (thread& writer : writers) {
+            writer.join();
+        }
+        ASSERT_EQUAL(server.GetLog().GetRecordCount(), 200u);
+        ASSERT(server.GetLog().GetSyncCount() <= 200u);
+    }
+    {
+        DurableSearchServer server(snapshot_path, log_path, WalSync::NONE, ""s);
+        ASSERT_EQUAL(server.GetRecoveryStatistics().replayed_record_count, 200u);
+        ASSERT_EQUAL(server.GetServer().FindTopDocuments("word7"s).size(), 4u);
+    }
+    unlink(log_path.c_str());
+
+    // после ошибки записи ни одна запись не считается зафиксированной
+    {
+        WriteAheadLog log("/dev/full"s, WalSync::NONE);
+        const uint64_t first = log.Append({WalOperation::REMOVE_DOCUMENT, 1, {}, DocumentStatus::ACTUAL, {}});
+        vector<thread> waiters;
+        atomic<int> failed_count = 0;
+        for (int i = 0; i < 3; ++i) {
+            waiters.emplace_back([&log, &failed_count, first]() {
+                try {
+                    log.WaitDurable(first);
+                } catch (const system_error&) {
+                    ++failed_count;
+                }
+            });
+        }
+        for (thread& waiter : waiters) {
+            waiter.join();
+        }
+        ASSERT_EQUAL(failed_count.load(), 3);
+        const uint64_t second = log.Append({WalOperation::REMOVE_DOCUMENT, 2, {}, DocumentStatus::ACTUAL, {}});
+        for (const uint64_t sequence : {first, second}) {
+            try {
+                log.WaitDurable(sequence);
+                ASSERT_HINT(false, "Failed log must stay failed"s);
+            } catch (const system_error&) {
+            }
+        }
+        ASSERT_EQUAL(log.GetSyncCount(), 0u);
+    }
+
+    // незафиксированное изменение не применяется к серверу
+    {
+        DurableSearchServer server(snapshot_path, "/dev/full"s, WalSync::NONE, ""s);
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            try {
+                server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+                ASSERT_HINT(false, "Unwritten document must be rejected"s);
+            } catch (const system_error&) {
+            }
+        }
+        try {
+            server.AddDocuments({{2, "black dog"sv, DocumentStatus::ACTUAL, {3}}});
+            ASSERT_HINT(false, "Unwritten documents must be rejected"s);
+        } catch (const system_error&) {
+        }
+        ASSERT_EQUAL(server.GetServer().GetDocumentCount(), 0u);
+        ASSERT(server.GetServer().FindTopDocuments("cat"s).empty());
+    }
+}
+
+void TestDirectoryIndexer() {
+    namespace fs = std::filesystem;
+    const fs::path root = "/tmp/search-server-test-"s + to_string(getpid()) + "-corpus"s;
+    fs::remove_all(root);
+    fs::create_directories(root / "nested"s);
+    const auto write_file = [](const fs::path& path, const string& text) {
+        ofstream output(path, ios::binary | ios::trunc);
+        output << text;
+    };
+    write_file(root / "a.txt"s, "white cat\nand dog"s);
+    write_file(root / "nested"s / "b.txt"s, "black\tdog"s);
+    write_file(root / "empty.txt"s, ""s);
+    string big_text;
+    while (big_text.size() < 256 * 1024) {
+        big_text += "big\r\nparrot "s;
+    }
+    write_file(root / "nested"s / "big.txt"s, big_text);
+
+    SearchServer server("and"s);
+    DirectoryIndexer indexer(server, 100, 2);
+    DirectoryIndexingStatistics statistics = indexer.Index({root.string()});
+    ASSERT_EQUAL(statistics.scanned_file_count, 4u);
+    ASSERT_EQUAL(statistics.indexed_file_count, 4u);
+    ASSERT_EQUAL(statistics.byte_count, big_text.size() + 26);
+    ASSERT_EQUAL(server.GetDocumentCount(), 4u);
+    ASSERT_EQUAL(indexer.GetFileCount(), 4u);
+    {
+        // управляющие символы заменены пробелами
+        const vector<Document> documents = server.FindTopDocuments("parrot"s);
+        ASSERT_EQUAL(documents.size(), 1u);
+        ASSERT(documents[0].id >= 100);
+        ASSERT_EQUAL(indexer.GetDocumentPath(documents[0].id), (root / "nested"s / "big.txt"s).string());
+        ASSERT_EQUAL(server.FindTopDocuments("dog"s).size(), 2u);
+        ASSERT_EQUAL(server.FindTopDocuments("white"s).size(), 1u);
+    }
+
+    // неизмененные файлы пропускаются
+    statistics = indexer.Index({root.string()});
+    ASSERT_EQUAL(statistics.scanned_file_count, 4u);
+    ASSERT_EQUAL(statistics.unchanged_file_count, 4u);
+    ASSERT_EQUAL(statistics.indexed_file_count, 0u);
+    ASSERT_EQUAL(server.GetDocumentCount(), 4u);
+
+    // измененный файл индексируется заново, удаленный - удаляется
+    write_file(root / "nested"s / "b.txt"s, "black bird"s);
+    fs::remove(root / "a.txt"s);
+    statistics = indexer.Index({root.string()});
+    ASSERT_EQUAL(statistics.indexed_file_count, 1u);
+    ASSERT_EQUAL(statistics.unchanged_file_count, 2u);
+    ASSERT_EQUAL(statistics.removed_file_count, 1u);
+    ASSERT_EQUAL(server.GetDocumentCount(), 3u);
+    ASSERT_EQUAL(indexer.GetFileCount(), 3u);
+    ASSERT(server.FindTopDocuments("dog"s).empty());
+    ASSERT(server.FindTopDocuments("white"s).empty());
+    const vector<Document> documents = server.FindTopDocuments("black"s);
+    ASSERT_EQUAL(documents.size(), 1u);
+    ASSERT_EQUAL(indexer.GetDocumentPath(documents[0].id), (root / "nested"s / "b.txt"s).string());
+
+    // если новая версия файла отклонена, прежняя остается в индексе
+    server.AddDocument(documents[0].id + 1, "blocker"s, DocumentStatus::ACTUAL, {});
+    write_file(root / "nested"s / "b.txt"s, "black goldfish"s);
+    try {
+        indexer.Index({root.string()});
+        ASSERT_HINT(false, "Duplicate document id must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(server.FindTopDocuments("black"s).size(), 1u);
+    ASSERT(server.FindTopDocuments("goldfish"s).empty());
+    server.RemoveDocument(documents[0].id + 1);
+    statistics = indexer.Index({root.string()});
+    ASSERT_EQUAL(statistics.indexed_file_count, 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("goldfish"s).size(), 1u);
+    ASSERT(server.FindTopDocuments("bird"s).empty());
+
+    try {
+        indexer.Index({(root / "missing"s).string()});
+        ASSERT_HINT(false, "Missing directory must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), 3u);
+    fs::remove_all(root);
+}
+
+void TestInputReader() {
+    const string input = "3\n"s
+                         "white cat and a long tail\r\n"s
+                         "2 8 -3\n"s
+                         "black dog\n"s
+                         "0\n"s
+                         "cat dog\n"s
+                         "1 5\n"s
+                         "2\n"s
+                         "cat\n"s
+                         "dog -black"s;
+    const string path = "/tmp/search-server-test-"s + to_string(getpid()) + ".input"s;
+    {
+        ofstream output(path, ios::binary | ios::trunc);
+        output << input;
+    }
+
+    const auto check = [](InputReader& reader) {
+        SearchServer server("and"s);
+        const IngestionStatistics statistics = LoadDocuments(reader, server, 10);
+        ASSERT_EQUAL(statistics.document_count, 3u);
+        ASSERT_EQUAL(server.GetDocumentCount(), 3u);
+        const vector<string> queries = ReadQueries(reader);
+        ASSERT_EQUAL(queries, vector<string>({"cat"s, "dog -black"s}));
+        ASSERT(!reader.ReadLine());
+
+        const vector<Document> cats = server.FindTopDocuments(queries[0]);
+        ASSERT_EQUAL(cats.size(), 2u);
+        ASSERT_EQUAL(cats[0].id, 12);
+        ASSERT_EQUAL(cats[0].rating, 5);
+        ASSERT_EQUAL(cats[1].id, 10);
+        ASSERT_EQUAL(cats[1].rating, 2);
+        const vector<Document> dogs = server.FindTopDocuments(queries[1]);
+        ASSERT_EQUAL(dogs.size(), 1u);
+        ASSERT_EQUAL(dogs[0].id, 12);
+    };
+
+    // файл, отображенный в память
+    {
+        InputReader reader(path);
+        check(reader);
+    }
+
+    // поток через буфер меньше строки: буфер дочитывается и растет
+    {
+        int pipe_ends[2];
+        ASSERT(pipe(pipe_ends) == 0);
+        ASSERT_EQUAL(write(pipe_ends[1], input.data(), input.size()), static_cast<ssize_t>(input.size()));
+        close(pipe_ends[1]);
+        InputReader reader(pipe_ends[0], 4);
+        check(reader);
+        close(pipe_ends[0]);
+    }
+
+    {
+        ofstream output(path, ios::binary | ios::trunc);
+        output << "\t+2 1\n\n -3\t\n2 1 2 3\n2 4 5 \n12x\n+\n+-1\n\n\t7\n3 1\n2"s;
+    }
+    InputReader reader(path);
+    vector<int> numbers = {7};
+    // пробельные символы, '+' и переводы строк - как у operator>>
+    reader.ReadNumbers(numbers);
+    ASSERT_EQUAL(numbers, vector<int>({1, -3}));
+    try {
+        reader.ReadNumbers(numbers);
+        ASSERT_HINT(false, "Extra number must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    reader.ReadNumbers(numbers);
+    ASSERT_EQUAL(numbers, vector<int>({4, 5}));
+    for (const char* hint : {"12x", "+", "+-1"}) {
+        try {
+            reader.ReadNumber();
+            ASSERT_HINT(false, "Invalid number must be rejected: "s + hint);
+        } catch (const invalid_argument&) {
+        }
+    }
+    ASSERT_EQUAL(reader.ReadNumber(), 7);
+    try {
+        reader.ReadNumbers(numbers);
+        ASSERT_HINT(false, "Missing number must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    try {
+        reader.ReadNumber();
+        ASSERT_HINT(false, "End of input must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    unlink(path.c_str());
+
+    {
+        ofstream output(path, ios::binary | ios::trunc);
+    }
+    InputReader empty_reader(path);
+    ASSERT(!empty_reader.ReadLine());
+    unlink(path.c_str());
+}
+
+void TestTokenizer() {
+    const auto split_reference = [](string_view text) {
+        vector<string_view> words;
+        while (!text.empty()) {
+            const size_t begin = text.find_first_not_of(' ');
+            if (begin == string_view::npos) {
+                break;
+            }
+            text.remove_prefix(begin);
+            const size_t end = min(text.size(), text.find(' '));
+            words.push_back(text.substr(0, end));
+            text.remove_prefix(end);
+        }
+        return words;
+    };
+
+    // слова на границах блоков по 16 и 32 байта
+    mt19937 generator(17);
+    vector<string_view> words;
+    for (int i = 0; i < 500; ++i) {
+        string text;
+        const int length = uniform_int_distribution(0, 100)(generator);
+        for (int j = 0; j < length; ++j) {
+            const int kind = uniform_int_distribution(0, 3)(generator);
+            text.push_back(kind == 0 ? ' ' : kind == 1 ? '\xD0' : static_cast<char>('a' + j % 26));
+        }
+        ASSERT(SplitIntoWords(text, words));
+        ASSERT_EQUAL_HINT(words, split_reference(text), text);
+        ASSERT_EQUAL(SplitIntoWords(text), split_reference(text));
+        ASSERT(!ContainsControlChars(text));
+
+        if (!text.empty()) {
+            const size_t position = uniform_int_distribution<size_t>(0, text.size() - 1)(generator);
+            text[position] = static_cast<char>(uniform_int_distribution(0, 31)(generator));
+            ASSERT_HINT(!SplitIntoWords(text, words), to_string(position));
+            ASSERT_HINT(ContainsControlChars(text), to_string(position));
+        }
+    }
+
+    ASSERT(SplitIntoWords(""s, words));
+    ASSERT(words.empty());
+    ASSERT(SplitIntoWords(string(70, ' '), words));
+    ASSERT(words.empty());
+    const string long_word(70, 'x');
+    const string text = "  "s + long_word + " y"s;
+    ASSERT(SplitIntoWords(text, words));
+    ASSERT_EQUAL(words, vector<string_view>({long_word, "y"sv}));
+
+    SearchServer server("and"s);
+    try {
+        server.AddDocument(1, "a long document with a tab\tafter thirty two bytes"s, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(false, "Control characters must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), 0u);
+
+    // стоп-слова в строке проверяются так же, как в контейнере
+    for (const string& stop_words : {"in\x01 the"s, "and the of in on at to by for with from about\x1F"s}) {
+        try {
+            SearchServer invalid_server(stop_words);
+            ASSERT_HINT(false, "Stop words with control characters must be rejected"s);
+        } catch (const invalid_argument&) {
+        }
+        try {
+            SearchServer invalid_server(string_view{stop_words});
+            ASSERT_HINT(false, "Stop words with control characters must be rejected"s);
+        } catch (const invalid_argument&) {
+        }
+    }
+}
+
+void TestStopWordSet() {
+    mt19937 generator(21);
+    for (const int word_count : {0, 1, 2, 7, 100, 1000}) {
+        set<string> words;
+        while (static_cast<int>(words.size()) < word_count) {
+            string word;
+            const int length = uniform_int_distribution(1, 8)(generator);
+            for (int i = 0; i < length; ++i) {
+                word.push_back(uniform_int_distribution('a', 'z')(generator));
+            }
+            words.insert(word);
+        }
+        // пустые и повторяющиеся слова пропускаются
+        vector<string> word_list(words.rbegin(), words.rend());
+        word_list.push_back(""s);
+        if (!words.empty()) {
+            word_list.push_back(*words.begin());
+        }
+        const StopWordSet stop_words(word_list);
+        ASSERT_EQUAL(stop_words.Size(), words.size());
+        ASSERT(vector<string>(stop_words.begin(), stop_words.end()) == vector<string>(words.begin(), words.end()));
+        for (const string& word : words) {
+            ASSERT_HINT(stop_words.Contains(word), word);
+        }
+        for (int i = 0; i < 1000; ++i) {
+            string word;
+            const int length = uniform_int_distribution(0, 9)(generator);
+            for (int j = 0; j < length; ++j) {
+                word.push_back(uniform_int_distribution('a', 'z')(generator));
+            }
+            ASSERT_EQUAL_HINT(stop_words.Contains(word), words.count(word) != 0, word);
+        }
+    }
+
+    // таблица стоп-слов, построенная при компиляции
+    constexpr StaticStopWordSet static_stop_words(array{"a"sv, "and"sv, "in"sv, "the"sv, "with"sv});
+    static_assert(static_stop_words.Contains("and"sv));
+    static_assert(static_stop_words.Contains("with"sv));
+    static_assert(!static_stop_words.Contains("cat"sv));
+    static_assert(!static_stop_words.Contains(""sv));
+
+    SearchServer server(static_stop_words);
+    server.AddDocument(1, "the cat in the city"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(server.FindTopDocuments("the"s).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 1u);
+    ASSERT_EQUAL(server.GetWordFrequencies(1).size(), 2u);
+    ASSERT(get<0>(server.MatchDocument("the city"s, 1)) == vector<string_view>({"city"sv}));
+
+    try {
+        StaticStopWordSet duplicates(array{"a"sv, "a"sv});
+        ASSERT_HINT(false, "Duplicate static stop words must be rejected"s);
+    } catch (const invalid_argument& e) {
+        ASSERT_EQUAL(e.what(), "Stop words are not unique"s);
+    }
+
+    // увеличенная таблица
+    constexpr StaticStopWordSet<3, 4> scaled_stop_words(array{"a"sv, "an"sv, "the"sv});
+    static_assert(decltype(scaled_stop_words)::SLOT_COUNT == 4 * GetStopWordSlotCount(3));
+    static_assert(scaled_stop_words.Contains("an"sv));
+    static_assert(!scaled_stop_words.Contains("and"sv));
+    SearchServer scaled_server(scaled_stop_words);
+    scaled_server.AddDocument(1, "a cat"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(scaled_server.FindTopDocuments("a"s).empty());
+
+    // большой набор строится за конечное число попыток
+    vector<string> many_words;
+    for (int i = 0; i < 5000; ++i) {
+        many_words.push_back("w"s + to_string(i));
+    }
+    const StopWordSet many_stop_words(many_words);
+    ASSERT(many_stop_words.Contains("w4999"sv));
+    ASSERT(!many_stop_words.Contains("w5000"sv));
+}
+
+void TestQueryCache() {
+    SearchServer server("and in"s);
+    server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, {8});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7});
+    server.AddDocument(3, "well-groomed dog expressive eyes"s, DocumentStatus::BANNED, {5});
+    server.SetQueryCacheCapacity(100);
+
+    const auto ids = [](const vector<Document>& documents) {
+        vector<int> result;
+        for (const Document& document : documents) {
+            result.push_back(document.id);
+        }
+        return result;
+    };
+
+    // порядок, повтор и стоп-слова не меняют ключ
+    const vector<Document> first = server.FindTopDocuments("fluffy cat -dog"s);
+    const vector<Document> second = server.FindTopDocuments("cat and -dog cat fluffy"s);
+    ASSERT(ids(first) == ids(second));
+    ASSERT_EQUAL(first[0].relevance, second[0].relevance);
+    QueryCacheStatistics statistics = server.GetQueryCacheStatistics();
+    ASSERT_EQUAL(statistics.hit_count, 1u);
+    ASSERT_EQUAL(statistics.miss_count, 1u);
+    ASSERT_EQUAL(statistics.entry_count, 1u);
+    ASSERT(statistics.memory_bytes > 0);
+
+    // статус и страница входят в ключ
+    ASSERT(ids(server.FindTopDocuments("fluffy cat dog"s, DocumentStatus::BANNED)) == vector<int>({3}));
+    ASSERT_EQUAL(server.FindTopDocuments("fluffy cat -dog"s, DocumentStatus::ACTUAL, {1, 1}).size(), 1u);
+    ASSERT_EQUAL(server.GetQueryCacheStatistics().entry_count, 3u);
+
+    // добавление и удаление документа делают записи устаревшими
+    const uint64_t version = server.GetIndexVersion();
+    server.AddDocument(4, "cat"s, DocumentStatus::ACTUAL, {1});
+    ASSERT(server.GetIndexVersion() > version);
+    ASSERT(ids(server.FindTopDocuments("fluffy cat -dog"s)) == vector<int>({2, 4, 1}));
+    server.RemoveDocument(2);
+    ASSERT(ids(server.FindTopDocuments("fluffy cat -dog"s)) == vector<int>({4, 1}));
+    statistics = server.GetQueryCacheStatistics();
+    ASSERT_EQUAL(statistics.invalidation_count, 2u);
+    ASSERT_EQUAL(statistics.hit_count, 1u);
+
+    // результаты индекса вкладов не смешиваются с результатами перебора
+    server.SetRetrievalEngine(RetrievalEngine::IMPACT);
+    const vector<int> exhaustive = ids(server.FindTopDocuments("fluffy cat -dog"s));
+    server.BuildImpactIndex();
+    ASSERT(ids(server.FindTopDocuments("fluffy cat -dog"s)) == exhaustive);
+    ASSERT_EQUAL(server.GetQueryCacheStatistics().hit_count, 2u);
+
+    // вытесняются давно не использованные запросы
+    QueryResultCache cache(QUERY_CACHE_SHARD_COUNT);
+    for (int i = 0; i < 100; ++i) {
+        cache.Insert(to_string(i), 0, {{i, 0.0, 0}});
+    }
+    statistics = cache.GetStatistics();
+    ASSERT(statistics.entry_count <= QUERY_CACHE_SHARD_COUNT);
+    ASSERT_EQUAL(statistics.entry_count + statistics.eviction_count, 100u);
+    ASSERT(cache.Find("99"s, 0).has_value());
+    ASSERT(!cache.Find("99"s, 1).has_value());
+    ASSERT(!cache.Find("99"s, 0).has_value());
+
+    // поиск из нескольких потоков делит кэш
+    const vector<string> queries = {"cat"s, "fluffy"s, "collar cat"s, "dog -cat"s, "white fluffy"s};
+    vector<vector<int>> expected;
+    for (const string& query : queries) {
+        expected.push_back(ids(server.FindTopDocuments(query)));
+    }
+    vector<future<bool>> searches;
+    for (int thread = 0; thread < 4; ++thread) {
+        searches.push_back(async(launch::async, [&server, &queries, &expected, &ids, thread] {
+            bool same = true;
+            for (int i = 0; i < 200; ++i) {
+                const size_t query = (i + thread) % queries.size();
+                same = same && ids(server.FindTopDocuments(queries[query])) == expected[query];
+            }
+            return same;
+        }));
+    }
+    for (future<bool>& search : searches) {
+        ASSERT(search.get());
+    }
+
+    server.SetQueryCacheCapacity(0);
+    ASSERT(ids(server.FindTopDocuments("fluffy cat -dog"s)) == exhaustive);
+    ASSERT_EQUAL(server.GetQueryCacheStatistics().miss_count, 0u);
+}
+
+void TestPreparedQuery() {
+    SearchServer server("and in with"s);
+    server.AddDocument(1, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, {8, -3});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    server.AddDocument(3, "well-groomed dog expressive eyes"s, DocumentStatus::ACTUAL, {5, -12, 2, 1});
+    server.AddDocument(4, "well-groomed starling eugene"s, DocumentStatus::BANNED, {9});
+    server.AddDocument(5, "cat with collar and dog"s, DocumentStatus::ACTUAL, {1});
+
+    const vector<string> queries = {"fluffy well-groomed cat"s, "cat -collar"s, "dog dog and eyes -fluffy"s, "starling"s, "missing -cat"s, "in with"s};
+    const auto is_even = [](int id, DocumentStatus, int) { return id % 2 == 0; };
+    const auto same = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            if (lhs[i].id != rhs[i].id || abs(lhs[i].relevance - rhs[i].relevance) > RELEVANCE_EPSILON || lhs[i].rating != rhs[i].rating) {
+                return false;
+            }
+        }
+        return true;
+    };
+    const auto check = [&](const vector<SearchServer::PreparedQuery>& prepared_queries) {
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const SearchServer::PreparedQuery& prepared = prepared_queries[i];
+            ASSERT_HINT(same(server.FindTopDocuments(prepared), server.FindTopDocuments(queries[i])), queries[i]);
+            ASSERT_HINT(same(server.FindTopDocuments(execution::par, prepared, DocumentStatus::BANNED), server.FindTopDocuments(queries[i], DocumentStatus::BANNED)), queries[i]);
+            ASSERT_HINT(same(server.FindTopDocuments(prepared, is_even), server.FindTopDocuments(queries[i], is_even)), queries[i]);
+            ASSERT_HINT(same(server.FindTopDocuments(execution::par, prepared, is_even, {1, 1}), server.FindTopDocuments(execution::par, queries[i], is_even, {1, 1})), queries[i]);
+            for (const int document_id : server) {
+                ASSERT_HINT(server.MatchDocument(prepared, document_id) == server.MatchDocument(queries[i], document_id), queries[i]);
+                ASSERT_HINT(server.MatchDocument(execution::par, prepared, document_id) == server.MatchDocument(queries[i], document_id), queries[i]);
+            }
+        }
+    };
+
+    vector<SearchServer::PreparedQuery> prepared_queries;
+    for (const string& query : queries) {
+        prepared_queries.push_back(server.PrepareQuery(query));
+    }
+    for (const RetrievalEngine engine : {RetrievalEngine::EXHAUSTIVE, RetrievalEngine::WAND, RetrievalEngine::IMPACT}) {
+        server.SetRetrievalEngine(engine);
+        server.BuildImpactIndex();
+        check(prepared_queries);
+    }
+    server.SetRetrievalEngine(RetrievalEngine::EXHAUSTIVE);
+
+    // после изменения набора документов подготовленный запрос устаревает,
+    // но результаты остаются верными
+    const uint64_t version = prepared_queries[0].GetIndexVersion();
+    ASSERT_EQUAL(version, server.GetIndexVersion());
+    server.AddDocument(6, "fluffy dog"s, DocumentStatus::ACTUAL, {3});
+    server.RemoveDocument(2);
+    ASSERT(server.GetIndexVersion() != version);
+    check(prepared_queries);
+    server.Compact();
+    check(prepared_queries);
+
+    // запрос другого сервера не используется с его терминами
+    SearchServer other_server(""s);
+    other_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+    const SearchServer::PreparedQuery other_query = other_server.PrepareQuery("cat"s);
+    ASSERT(same(server.FindTopDocuments(other_query), server.FindTopDocuments("cat"s)));
+
+    try {
+        server.PrepareQuery("cat --dog"s);
+        ASSERT_HINT(false, "Invalid query must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestQueryBatch() {
+    // частые слова входят во многие документы и запросы
+    mt19937 generator(24);
+    const auto random_word = [&generator] {
+        const double value = uniform_real_distribution(0.0, 1.0)(generator);
+        return "w"s + to_string(static_cast<int>(value * value * 60));
+    };
+    SearchServer server("w0"s);
+    for (int id = 0; id < 9000; ++id) {
+        string text;
+        for (int i = 0; i < 6; ++i) {
+            text += random_word() + " "s;
+        }
+        server.AddDocument(id, text, id % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 11 - 5});
+    }
+    server.RemoveDocument(3);
+    server.RemoveDocument(4000);
+
+    vector<string> queries = {""s, "w0"s, "missing"s, "-w1"s};
+    for (int i = 0; i < 200; ++i) {
+        string query;
+        for (int j = 0; j < 4; ++j) {
+            query += (j > 0 && i % 3 == 0 ? "-"s : ""s) + random_word() + " "s;
+        }
+        queries.push_back(query);
+    }
+
+    const auto same = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            if (lhs[i].id != rhs[i].id || lhs[i].relevance != rhs[i].relevance || lhs[i].rating != rhs[i].rating) {
+                return false;
+            }
+        }
+        return true;
+    };
+    const auto is_odd = [](int id, DocumentStatus, int) { return id % 2 == 1; };
+    const vector<vector<Document>> seq_results = server.FindTopDocumentsBatch(execution::seq, queries);
+    const vector<vector<Document>> par_results = server.FindTopDocumentsBatch(execution::par, queries);
+    const vector<vector<Document>> banned_results = server.FindTopDocumentsBatch(execution::par, queries, DocumentStatus::BANNED, {2, 10});
+    const vector<vector<Document>> odd_results = server.FindTopDocumentsBatch(execution::seq, queries, is_odd);
+    const vector<SearchResult> process_results = ProcessQueriesBatch(server, queries);
+    ASSERT_EQUAL(seq_results.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const vector<Document> expected = server.FindTopDocuments(queries[i]);
+        ASSERT_HINT(same(seq_results[i], expected), queries[i]);
+        ASSERT_HINT(same(par_results[i], expected), queries[i]);
+        ASSERT_HINT(same(process_results[i], expected), queries[i]);
+        ASSERT_HINT(same(banned_results[i], server.FindTopDocuments(queries[i], DocumentStatus::BANNED, {2, 10})), queries[i]);
+        ASSERT_HINT(same(odd_results[i], server.FindTopDocuments(queries[i], is_odd)), queries[i]);
+    }
+
+    ASSERT(server.FindTopDocumentsBatch(execution::seq, vector<string>()).empty());
+    try {
+        server.FindTopDocumentsBatch(execution::par, vector<string>{"w1"s, "w2 --w3"s});
+        ASSERT_HINT(false, "Invalid query must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestQueryExecutor() {
+    // счетчик видит выделения текущего потока; сборка с санитайзерами
+    // подсчет не включает
+    if (ALLOCATION_COUNTING_ENABLED) {
+        const size_t allocation_count = GetThreadAllocationCount();
+        auto allocated = make_unique<int>(1);
+        const size_t new_allocation_count = GetThreadAllocationCount();
+        ASSERT_EQUAL(new_allocation_count, allocation_count + 1);
+    }
+
+    mt19937 generator(25);
+    const auto random_word = [&generator] {
+        return "w"s + to_string(uniform_int_distribution(0, 40)(generator));
+    };
+    SearchServer server("w0"s, IndexLayout::COMPRESSED);
+    for (int id = 0; id < 3000; ++id) {
+        string text;
+        for (int i = 0; i < 8; ++i) {
+            text += random_word() + " "s;
+        }
+        server.AddDocument(id, text, id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 9});
+    }
+    server.RemoveDocument(7);
+    vector<string> queries = {""s, "w0"s, "missing"s};
+    for (int i = 0; i < 300; ++i) {
+        queries.push_back(random_word() + " "s + random_word() + " -"s + random_word() + " "s + random_word());
+    }
+
+    for (const bool pin_threads : {false, true}) {
+        QueryExecutor executor(3, pin_threads);
+        ASSERT_EQUAL(executor.GetThreadCount(), 3u);
+        vector<vector<Document>> results;
+        executor.Process(server, queries, results);
+        ASSERT_EQUAL(results.size(), queries.size());
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const vector<Document> expected = server.FindTopDocuments(queries[i]);
+            ASSERT_EQUAL_HINT(results[i].size(), expected.size(), queries[i]);
+            for (size_t j = 0; j < expected.size(); ++j) {
+                ASSERT_EQUAL_HINT(results[i][j].id, expected[j].id, queries[i]);
+                ASSERT_EQUAL_HINT(results[i][j].relevance, expected[j].relevance, queries[i]);
+            }
+        }
+
+        // буферы потоков и результаты выросли, повторный пакет не выделяет память
+        const QueryExecutorStatistics warm = executor.GetStatistics();
+        ASSERT_EQUAL(warm.query_count, queries.size());
+        executor.Process(server, queries, results);
+        const QueryExecutorStatistics statistics = executor.GetStatistics();
+        ASSERT_EQUAL(statistics.query_count, 2 * queries.size());
+        ASSERT_EQUAL(statistics.allocation_count, warm.allocation_count);
+    }
+
+    QueryExecutor executor(2);
+    const vector<SearchResult> executor_results = ProcessQueries(server, queries, executor);
+    const vector<SearchResult> expected_results = ProcessQueries(server, queries);
+    ASSERT_EQUAL(executor_results.size(), expected_results.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        ASSERT_EQUAL_HINT(executor_results[i].size(), expected_results[i].size(), queries[i]);
+        for (size_t j = 0; j < expected_results[i].size(); ++j) {
+            ASSERT_EQUAL_HINT(executor_results[i][j].id, expected_results[i][j].id, queries[i]);
+        }
+    }
+    try {
+        vector<vector<Document>> results;
+        executor.Process(server, {"w1"s, "w2 --w3"s, "w4"s}, results);
+        ASSERT_HINT(false, "Invalid query must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+void TestConcurrentSearchServer() {
+    ConcurrentSearchServer server("and"s);
+    const int document_count = 300;
+    atomic<bool> done = false;
+
+    // каждое поколение содержит документы 0..n-1, и поиск по снимку
+    // находит их все, даже пока добавляются новые
+    const auto read = [&]() {
+        int checks = 0;
+        while (!done || checks == 0) {
+            const ConcurrentSearchServer::Snapshot snapshot = server.GetSnapshot();
+            const size_t count = snapshot->GetDocumentCount();
+            const vector<Document> result =
+                snapshot->FindTopDocuments("cat"s, DocumentStatus::ACTUAL, {0, document_count});
+            ASSERT_EQUAL(result.size(), count);
+            ++checks;
+        }
+    };
+    vector<thread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back(read);
+    }
+    for (int id = 0; id < document_count; ++id) {
+        server.AddDocument(id, "cat and dog "s + to_string(id), DocumentStatus::ACTUAL, {1});
+    }
+    server.RemoveDocuments({1, 2, 3});
+    server.Compact();
+    done = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+
+    ASSERT_EQUAL(server.GetGeneration(), static_cast<uint64_t>(document_count + 2));
+    ASSERT_EQUAL(server.GetDocumentCount(), static_cast<size_t>(document_count - 3));
+    try {
+        server.AddDocument(0, "cat"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_HINT(false, "duplicate id was accepted"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(server.GetGeneration(), static_cast<uint64_t>(document_count + 2));
+
+    // оба экземпляра получили одни и те же изменения
+    server.AddDocument(1000, "bird"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, ResultPage{0, 1000}).size(),
+                 static_cast<size_t>(document_count - 3));
+    server.AddDocument(1001, "bird"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, ResultPage{0, 1000}).size(),
+                 static_cast<size_t>(document_count - 3));
+    ASSERT_EQUAL(server.FindTopDocuments("bird"s).size(), 2u);
+
+    // изменение из потока, удерживающего снимок, ждало бы само себя
+    {
+        ConcurrentSearchServer::Snapshot snapshot = server.GetSnapshot();
+        ConcurrentSearchServer::Snapshot other = server.GetSnapshot();
+        other = move(snapshot);
+        snapshot.Reset();
+        try {
+            server.AddDocument(1002, "bird"s, DocumentStatus::ACTUAL, {1});
+            ASSERT_HINT(false, "Modification while holding a snapshot must be rejected"s);
+        } catch (const logic_error&) {
+        }
+        // другой поток может менять сервер, пока снимок удерживается, и
+        // изменение ждет его освобождения
+        auto modification = async(launch::async, [&server]() {
+            server.AddDocument(1003, "bird"s, DocumentStatus::ACTUAL, {1});
+        });
+        ASSERT_EQUAL(other->FindTopDocuments("bird"s).size(), 2u);
+        other.Reset();
+        modification.get();
+    }
+    ASSERT_EQUAL(server.FindTopDocuments("bird"s).size(), 3u);
+    server.AddDocument(1002, "bird"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(server.FindTopDocuments("bird"s).size(), 4u);
+}
+
 void TestSearchServer() {
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
     RUN_TEST(TestExcludeDocumentsWithMinusWords);
@@ -247,6 +2147,34 @@ void TestSearchServer() {
     RUN_TEST(TestStatusFilter);
     RUN_TEST(TestRelevanceCalculation);
     RUN_TEST(TestRating);
+    RUN_TEST(TestTermDictionaryAfterRemoval);
+    RUN_TEST(TestCompressedPostingList);
+    RUN_TEST(TestCompressedLayout);
+    RUN_TEST(TestResultPages);
+    RUN_TEST(TestWandMatchesExhaustive);
+    RUN_TEST(TestParallelMatchesSequential);
+    RUN_TEST(TestImpactEngine);
+    RUN_TEST(TestInverseDocumentFreqAfterRemoval);
+    RUN_TEST(TestAddDocuments);
+    RUN_TEST(TestStringArena);
+    RUN_TEST(TestCompaction);
+    RUN_TEST(TestRemoveDocuments);
+    RUN_TEST(TestConcurrentSearchServer);
+    RUN_TEST(TestSegmentedIndex);
+    RUN_TEST(TestCompletedMergeInstalledOnWrite);
+    RUN_TEST(TestShardedSearchServer);
+    RUN_TEST(TestShardServerConnections);
+    RUN_TEST(TestShardCoordinator);
+    RUN_TEST(TestSnapshot);
+    RUN_TEST(TestWriteAheadLog);
+    RUN_TEST(TestDirectoryIndexer);
+    RUN_TEST(TestInputReader);
+    RUN_TEST(TestTokenizer);
+    RUN_TEST(TestStopWordSet);
+    RUN_TEST(TestQueryCache);
+    RUN_TEST(TestPreparedQuery);
+    RUN_TEST(TestQueryBatch);
+    RUN_TEST(TestQueryExecutor);
 }
 
 int main() {
@@ -0,0 +1,284 @@
+#include "write_ahead_log.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <system_error>
+
+using namespace std;
+
+namespace {
+
+const size_t RECORD_HEADER_SIZE = 8;
+
+// Наибольшая длина тела записи; длина больше считается повреждением
+const uint32_t MAX_RECORD_SIZE = 256 * 1024 * 1024;
+
+void EncodeUint32(uint32_t value, string& output) {
+    for (size_t i = 0; i < 4; ++i) {
+        output.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+uint32_t DecodeUint32(const char* bytes) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i]))
+                 << (8 * i);
+    }
+    return value;
+}
+
+array<uint32_t, 256> MakeCrc32Table() {
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            value = (value & 1) != 0 ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(const string& path, WalSync sync)
+    : sync_(sync) {
+    using namespace std::string_literals;
+    file_ = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (file_ < 0) {
+        throw system_error(errno, generic_category(), "Cannot open "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(file_, &file_stat) != 0) {
+        const int error = errno;
+        close(file_);
+        throw system_error(error, generic_category(), "Cannot open "s + path);
+    }
+    durable_size_ = static_cast<size_t>(file_stat.st_size);
+}
+
+WriteAheadLog::~WriteAheadLog() { close(file_); }
+
+bool WriteAheadLog::IsTailTruncated() const { return tail_truncated_; }
+
+uint64_t WriteAheadLog::Append(const WalRecord& record) {
+    string body;
+    body.push_back(static_cast<char>(record.operation));
+    EncodeUint32(static_cast<uint32_t>(record.document_id), body);
+    if (record.operation == WalOperation::ADD_DOCUMENT) {
+        EncodeUint32(static_cast<uint32_t>(record.status), body);
+        EncodeUint32(static_cast<uint32_t>(record.ratings.size()), body);
+        for (const int rating : record.ratings) {
+            EncodeUint32(static_cast<uint32_t>(rating), body);
+        }
+        EncodeUint32(static_cast<uint32_t>(record.text.size()), body);
+        body.append(record.text);
+    }
+
+    lock_guard lock(mutex_);
+    EncodeUint32(static_cast<uint32_t>(body.size()), pending_);
+    EncodeUint32(ComputeCrc32(body), pending_);
+    pending_.append(body);
+    return ++appended_sequence_;
+}
+
+void WriteAheadLog::WaitDurable(uint64_t sequence) {
+    using namespace std::string_literals;
+    unique_lock lock(mutex_);
+    while (true) {
+        // записи после неудачного пакета тоже не фиксируются: в журнале
+        // они оказались бы после пропуска
+        if (write_error_ != 0) {
+            throw system_error(write_error_, generic_category(),
+                               "Cannot write the log"s);
+        }
+        if (durable_sequence_ >= sequence) {
+            return;
+        }
+        if (flushing_) {
+            flushed_.wait(lock);
+            continue;
+        }
+
+        // поток становится ведущим и фиксирует все накопленные записи
+        flushing_ = true;
+        const string batch = move(pending_);
+        pending_.clear();
+        const uint64_t batch_sequence = appended_sequence_;
+        lock.unlock();
+
+        int error = 0;
+        for (size_t written = 0; written < batch.size() && error == 0;) {
+            const ssize_t result = write(file_, batch.data() + written,
+                                         batch.size() - written);
+            if (result >= 0) {
+                written += static_cast<size_t>(result);
+            } else if (errno != EINTR) {
+                error = errno;
+            }
+        }
+        if (error == 0 && sync_ == WalSync::FDATASYNC &&
+            fdatasync(file_) != 0) {
+            error = errno;
+        }
+
+        if (error != 0) {
+            // убирает оборванную запись; если и это не удалось, ее
+            // отбросит проверка контрольной суммы при Replay
+            [[maybe_unused]] const int result =
+                ftruncate(file_, static_cast<off_t>(durable_size_));
+        }
+
+        lock.lock();
+        flushing_ = false;
+        flushed_.notify_all();
+        if (error != 0) {
+            write_error_ = error;
+            continue;
+        }
+        durable_sequence_ = batch_sequence;
+        durable_size_ += batch.size();
+        ++sync_count_;
+    }
+}
+
+void WriteAheadLog::CheckHealthy() const {
+    using namespace std::string_literals;
+    lock_guard lock(mutex_);
+    if (write_error_ != 0) {
+        throw system_error(write_error_, generic_category(),
+                           "Cannot write the log"s);
+    }
+}
+
+void WriteAheadLog::Clear() {
+    unique_lock lock(mutex_);
+    flushed_.wait(lock, [this] { return !flushing_; });
+    pending_.clear();
+    Truncate(0);
+    durable_size_ = 0;
+    durable_sequence_ = appended_sequence_;
+    flushed_.notify_all();
+}
+
+uint64_t WriteAheadLog::GetRecordCount() const {
+    lock_guard lock(mutex_);
+    return appended_sequence_;
+}
+
+uint64_t WriteAheadLog::GetSyncCount() const {
+    lock_guard lock(mutex_);
+    return sync_count_;
+}
+
+uint32_t WriteAheadLog::ComputeCrc32(const string_view data) {
+    static const array<uint32_t, 256> table = MakeCrc32Table();
+    uint32_t crc = 0xFFFFFFFF;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<unsigned char>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+string WriteAheadLog::ReadAll() const {
+    using namespace std::string_literals;
+    struct stat file_stat;
+    if (fstat(file_, &file_stat) != 0) {
+        throw system_error(errno, generic_category(), "Cannot read the log"s);
+    }
+
+    string log(static_cast<size_t>(file_stat.st_size), '\0');
+    for (size_t read_size = 0; read_size < log.size();) {
+        const ssize_t result = pread(file_, log.data() + read_size,
+                                     log.size() - read_size, read_size);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            throw system_error(errno, generic_category(),
+                               "Cannot read the log"s);
+        }
+        if (result == 0) {
+            log.resize(read_size);
+            break;
+        }
+        read_size += static_cast<size_t>(result);
+    }
+    return log;
+}
+
+void WriteAheadLog::Truncate(size_t size) {
+    using namespace std::string_literals;
+    if (ftruncate(file_, static_cast<off_t>(size)) != 0 ||
+        (sync_ == WalSync::FDATASYNC && fdatasync(file_) != 0)) {
+        throw system_error(errno, generic_category(),
+                           "Cannot truncate the log"s);
+    }
+}
+
+optional<WalRecord> WriteAheadLog::DecodeRecord(const string& log,
+                                                size_t& offset) {
+    if (log.size() - offset < RECORD_HEADER_SIZE) {
+        return nullopt;
+    }
+    const uint32_t size = DecodeUint32(log.data() + offset);
+    const uint32_t crc = DecodeUint32(log.data() + offset + 4);
+    if (size > MAX_RECORD_SIZE ||
+        log.size() - offset - RECORD_HEADER_SIZE < size) {
+        return nullopt;
+    }
+    string_view body(log.data() + offset + RECORD_HEADER_SIZE, size);
+    if (ComputeCrc32(body) != crc) {
+        return nullopt;
+    }
+
+    // тело с верной контрольной суммой разбирается с проверкой длины,
+    // чтобы запись другого формата не привела к выходу за его границы
+    bool valid = true;
+    const auto read_uint32 = [&body, &valid]() -> uint32_t {
+        if (body.size() < 4) {
+            valid = false;
+            return 0;
+        }
+        const uint32_t value = DecodeUint32(body.data());
+        body.remove_prefix(4);
+        return value;
+    };
+
+    WalRecord record;
+    if (body.empty()) {
+        return nullopt;
+    }
+    record.operation = static_cast<WalOperation>(body[0]);
+    body.remove_prefix(1);
+    record.document_id = static_cast<int>(read_uint32());
+    if (record.operation == WalOperation::ADD_DOCUMENT) {
+        record.status = static_cast<DocumentStatus>(read_uint32());
+        const uint32_t rating_count = read_uint32();
+        if (rating_count > body.size() / 4) {
+            return nullopt;
+        }
+        for (uint32_t i = 0; i < rating_count; ++i) {
+            record.ratings.push_back(static_cast<int>(read_uint32()));
+        }
+        const uint32_t text_size = read_uint32();
+        if (!valid || text_size != body.size()) {
+            return nullopt;
+        }
+        record.text = body;
+    } else if (record.operation != WalOperation::REMOVE_DOCUMENT ||
+               !body.empty()) {
+        return nullopt;
+    }
+    if (!valid) {
+        return nullopt;
+    }
+
+    offset += RECORD_HEADER_SIZE + size;
+    return record;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// Режим фиксации журнала. NONE передает записи системе без fdatasync:
+// они переживают аварийное завершение процесса, но не сбой питания.
+enum class WalSync {
+    FDATASYNC,
+    NONE,
+};
+
+enum class WalOperation : uint8_t {
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+};
+
+// Операция журнала. Для REMOVE_DOCUMENT используется только document_id.
+// Строка text прочитанной записи ссылается на данные журнала.
+struct WalRecord {
+    WalOperation operation = WalOperation::ADD_DOCUMENT;
+    int document_id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+// Журнал упреждающей записи операций SearchServer. Append помещает запись
+// в буфер, WaitDurable фиксирует буфер одним пакетом для всех ожидающих
+// потоков. После ошибки записи журнал обрезается до последнего
+// зафиксированного пакета, и все следующие WaitDurable выбрасывают ее.
+class WriteAheadLog {
+   public:
+    explicit WriteAheadLog(const std::string& path,
+                           WalSync sync = WalSync::FDATASYNC);
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog();
+
+    // Вызывает function(const WalRecord&) для записей по порядку и возвращает
+    // их число. Журнал обрезается перед первой поврежденной записью.
+    template <typename Function>
+    size_t Replay(Function function);
+
+    // Была ли при последнем Replay отброшена поврежденная часть журнала
+    bool IsTailTruncated() const;
+
+    // Номер записи, который передается в WaitDurable
+    uint64_t Append(const WalRecord& record);
+
+    void WaitDurable(uint64_t sequence);
+
+    // Выбрасывает ошибку, после которой журнал неисправен
+    void CheckHealthy() const;
+
+    // Вызывается, когда все добавленные записи уже сохранены в снимке
+    void Clear();
+
+    // Число записей, добавленных с открытия журнала
+    uint64_t GetRecordCount() const;
+
+    // Число фиксаций буфера
+    uint64_t GetSyncCount() const;
+
+    static uint32_t ComputeCrc32(const std::string_view data);
+
+   private:
+    int file_;
+    WalSync sync_;
+    bool tail_truncated_ = false;
+    mutable std::mutex mutex_;
+    std::condition_variable flushed_;
+    std::string pending_;
+    bool flushing_ = false;
+    uint64_t appended_sequence_ = 0;
+    uint64_t durable_sequence_ = 0;
+    uint64_t sync_count_ = 0;
+    // размер журнала после последней успешной фиксации
+    size_t durable_size_ = 0;
+    // ошибка, после которой журнал неисправен; 0, если ее не было
+    int write_error_ = 0;
+
+    std::string ReadAll() const;
+
+    void Truncate(size_t size);
+
+    // Разбирает запись, начинающуюся в log[offset], и сдвигает offset
+    // за нее; nullopt, если запись оборвана или повреждена
+    static std::optional<WalRecord> DecodeRecord(const std::string& log,
+                                                 size_t& offset);
+};
+
+template <typename Function>
+size_t WriteAheadLog::Replay(Function function) {
+    const std::string log = ReadAll();
+    size_t offset = 0;
+    size_t record_count = 0;
+    while (const std::optional<WalRecord> record = DecodeRecord(log, offset)) {
+        function(*record);
+        ++record_count;
+    }
+
+    tail_truncated_ = offset < log.size();
+    if (tail_truncated_) {
+        Truncate(offset);
+    }
+    durable_size_ = offset;
+    return record_count;
+}